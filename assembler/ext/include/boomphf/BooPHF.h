@@ -135,7 +135,7 @@ class bitVector {
   public:
 
     bitVector()
-            : _size(0) {
+            : _size(0), _nchar(0) {
         _bitArray = nullptr;
     }
 
@@ -325,8 +325,11 @@ class bitVector {
     void load(std::istream& is) {
         is.read(reinterpret_cast<char*>(&_size), sizeof(_size));
         is.read(reinterpret_cast<char*>(&_nchar), sizeof(_nchar));
-        this->resize(_size);
-        is.read(reinterpret_cast<char *>(_bitArray), (std::streamsize)(sizeof(uint64_t) * _nchar));
+        // Levels of empty mphf are never allocated
+        if (_nchar) {
+            this->resize(_size);
+            is.read(reinterpret_cast<char *>(_bitArray), (std::streamsize)(sizeof(uint64_t) * _nchar));
+        }
 
         size_t sizer;
         is.read(reinterpret_cast<char *>(&sizer),  sizeof(size_t));
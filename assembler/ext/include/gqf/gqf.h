@@ -148,6 +148,23 @@ extern "C" {
 	/* merge multiple QFs into the final QF one. */
 	void qf_multi_merge(QF *qf_arr[], int nqf, QF *qfr);
 
+	/* Copy the counters of the runs [*run, to_run) of src into dst, which
+		 must have the same key bits, at least as many slots and no counters in
+		 the slots these runs go to. The keys come in the sorted order, so the
+		 counters are just appended one after another without any shifting, and
+		 the disjoint ranges of runs could be copied in parallel. Stops at the
+		 first counter which does not fit below the slot limit. On return *run
+		 and *index (the slot in src) point to the first counter not copied,
+		 *run == to_run if all of them were. Pass *index = 0 to start from the
+		 beginning of the run. */
+	void qf_append_runs(const QF *src, QF *dst, uint64_t *run, uint64_t *index,
+											uint64_t to_run, uint64_t limit);
+
+	/* Insert the counters from the position returned by qf_append_runs up to
+		 to_run into dst by the regular insertion. */
+	void qf_insert_runs(const QF *src, QF *dst, uint64_t run, uint64_t index,
+											uint64_t to_run);
+
 	/* find cosine similarity between two QFs. */
 	uint64_t qf_inner_product(QF *qfa, QF *qfb);
 
@@ -1216,6 +1216,8 @@ static inline bool insert1(QF *qf, uint64_t hash, bool lock, bool spin)
 																																	%
 																																	SLOTS_PER_BLOCK)
 																																 % 64);
+					/* The first remainder of the bucket */
+					modify_metadata(qf, &qf->metadata->ndistinct_elts, 1);
 					break;
 				case 1:
 					METADATA_WORD(qf, runends, insert_index-1) &= ~(1ULL <<
@@ -1760,7 +1762,7 @@ int qfi_next(QFi *qfi)
 #ifdef LOG_CLUSTER_LENGTH
 			qfi->cur_length++;
 #endif
-			if (qfi->current > qfi->qf->metadata->nslots)
+			if (qfi->current >= qfi->qf->metadata->xnslots)
 				return 1;
 			return 0;
 		}
@@ -1818,6 +1820,122 @@ inline int qfi_end(QFi *qfi)
 		return 0;
 }
 
+/* The first occupied quotient in [from, to), or to if there is none */
+static inline uint64_t next_occupied(const QF *qf, uint64_t from, uint64_t to)
+{
+	if (from >= to)
+		return to;
+
+	uint64_t block_index = from / SLOTS_PER_BLOCK;
+	uint64_t word = get_block(qf, block_index)->occupieds[0] &
+		~BITMASK(from % SLOTS_PER_BLOCK);
+	while (!word) {
+		block_index++;
+		if (block_index * SLOTS_PER_BLOCK >= to)
+			return to;
+		word = get_block(qf, block_index)->occupieds[0];
+	}
+
+	uint64_t res = block_index * SLOTS_PER_BLOCK + __builtin_ctzll(word);
+	return res < to ? res : to;
+}
+
+/* Marks the end of the appended run and sets the offsets of the blocks it
+ * spills into */
+static inline void close_run(QF *qf, uint64_t run, uint64_t last)
+{
+	uint64_t i;
+	METADATA_WORD(qf, runends, last) |= 1ULL << ((last % SLOTS_PER_BLOCK) % 64);
+	for (i = run / SLOTS_PER_BLOCK + 1; i <= last / SLOTS_PER_BLOCK; i++) {
+		uint64_t offset = last + 1 - i * SLOTS_PER_BLOCK;
+		get_block(qf, i)->offset = offset < BITMASK(8*sizeof(qf->blocks[0].offset)) ?
+			offset : BITMASK(8*sizeof(qf->blocks[0].offset));
+	}
+}
+
+/* Walks the counters of src in the order of the keys and either appends them
+ * to dst or inserts them there */
+static void copy_runs(const QF *src, QF *dst, uint64_t *run, uint64_t *index,
+											uint64_t to_run, uint64_t limit, bool append)
+{
+	uint64_t src_bits = src->metadata->bits_per_slot;
+	uint64_t dst_bits = dst->metadata->bits_per_slot;
+	uint64_t new_values[67];
+	uint64_t nelts = 0, ndistinct_elts = 0, noccupied_slots = 0;
+	uint64_t current = 0, dst_run = UINT64_MAX;
+	uint64_t src_index = 0, i;
+
+	uint64_t q = next_occupied(src, *run, to_run);
+	if (q == *run && *index)
+		src_index = *index;
+	else if (q < to_run) {
+		src_index = q == 0 ? 0 : run_end(src, q - 1) + 1;
+		if (src_index < q)
+			src_index = q;
+	}
+
+	while (q < to_run) {
+		uint64_t remainder, count;
+		uint64_t end = decode_counter(src, src_index, &remainder, &count);
+		uint64_t key = (q << src_bits) | remainder;
+
+		if (append) {
+			uint64_t bucket = key >> dst_bits;
+			uint64_t *p = encode_counter(dst, key & BITMASK(dst_bits), count, &new_values[67]);
+			uint64_t length = &new_values[67] - p;
+			uint64_t start = bucket == dst_run || current > bucket ? current : bucket;
+			if (start + length > limit)
+				break;
+
+			if (bucket != dst_run) {
+				if (dst_run != UINT64_MAX)
+					close_run(dst, dst_run, current - 1);
+				dst_run = bucket;
+				METADATA_WORD(dst, occupieds, bucket) |= 1ULL << ((bucket % SLOTS_PER_BLOCK) % 64);
+			}
+			for (i = 0; i < length; i++)
+				set_slot(dst, start + i, p[i]);
+			current = start + length;
+
+			nelts += count;
+			ndistinct_elts += 1;
+			noccupied_slots += length;
+		} else
+			qf_insert(dst, key, 0, count, false, false);
+
+		if (is_runend(src, end)) {
+			q = next_occupied(src, q + 1, to_run);
+			src_index = end + 1 > q ? end + 1 : q;
+		} else
+			src_index = end + 1;
+	}
+
+	if (append) {
+		if (dst_run != UINT64_MAX)
+			close_run(dst, dst_run, current - 1);
+		__sync_fetch_and_add(&dst->metadata->nelts, nelts);
+		__sync_fetch_and_add(&dst->metadata->ndistinct_elts, ndistinct_elts);
+		__sync_fetch_and_add(&dst->metadata->noccupied_slots, noccupied_slots);
+	}
+
+	*run = q;
+	*index = q < to_run ? src_index : 0;
+}
+
+void qf_append_runs(const QF *src, QF *dst, uint64_t *run, uint64_t *index,
+										uint64_t to_run, uint64_t limit)
+{
+	assert(src->metadata->key_bits == dst->metadata->key_bits);
+	assert(src->metadata->nslots <= dst->metadata->nslots);
+	copy_runs(src, dst, run, index, to_run, limit, true);
+}
+
+void qf_insert_runs(const QF *src, QF *dst, uint64_t run, uint64_t index,
+										uint64_t to_run)
+{
+	copy_runs(src, dst, &run, &index, to_run, 0, false);
+}
+
 /*
  * Merge qfa and qfb into qfc 
  */
@@ -0,0 +1,49 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "generators.hpp"
+
+#include "adt/bf.hpp"
+
+#define XXH_INLINE_ALL
+#include "xxh/xxhash.h"
+
+#include <benchmark/benchmark.h>
+#include <random>
+
+namespace bench {
+
+struct FilterHasher {
+    uint64_t operator()(uint64_t x, uint64_t seed) const {
+        return XXH3_64bits_withSeed(&x, sizeof(x), seed);
+    }
+};
+
+// Adds and looks up the random keys, the filter is much larger than the cache
+// as the DEFilter one. Args: cells
+template<class Filter>
+static void BM_CountingBloomFilter(benchmark::State &state) {
+    Filter filter(FilterHasher(), size_t(state.range(0)), 3);
+    std::mt19937_64 rng(DEFAULT_SEED);
+    std::vector<uint64_t> keys(1 << 20);
+    for (auto &key : keys)
+        key = rng();
+
+    size_t found = 0;
+    for (auto _ : state) {
+        for (uint64_t key : keys)
+            filter.add(key);
+        for (uint64_t key : keys)
+            found += filter.lookup(key ^ 1) > 0;
+    }
+    benchmark::DoNotOptimize(found);
+    state.SetItemsProcessed(int64_t(state.iterations() * 2 * keys.size()));
+}
+BENCHMARK_TEMPLATE(BM_CountingBloomFilter, bf::counting_bloom_filter<uint64_t, 2>)->Arg(1 << 28);
+BENCHMARK_TEMPLATE(BM_CountingBloomFilter, bf::counting_bloom_filter<uint64_t, 2, FilterHasher>)->Arg(1 << 28);
+BENCHMARK_TEMPLATE(BM_CountingBloomFilter, bf::blocked_counting_bloom_filter<uint64_t, 2, FilterHasher>)->Arg(1 << 28);
+
+}
@@ -0,0 +1,43 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "generators.hpp"
+
+#include "assembly_graph/dijkstra/dijkstra_helper.hpp"
+
+#include <benchmark/benchmark.h>
+#include <random>
+
+namespace bench {
+
+using debruijn_graph::Graph;
+using debruijn_graph::VertexId;
+
+// Runs the bounded Dijkstra from the random vertices. Args: genome size, length bound
+static void BM_BoundedDijkstra(benchmark::State &state) {
+    // Small k gives the tangled graph with many short edges
+    const Graph &g = SyntheticGraph::Get(size_t(state.range(0)), 21).graph();
+    size_t bound = size_t(state.range(1));
+
+    std::vector<VertexId> vertices(g.begin(), g.end());
+    std::mt19937_64 rng(DEFAULT_SEED);
+    std::shuffle(vertices.begin(), vertices.end(), rng);
+    vertices.resize(std::min(vertices.size(), size_t(100)));
+
+    size_t reached = 0;
+    for (auto _ : state) {
+        for (VertexId v : vertices) {
+            auto dijkstra = omnigraph::DijkstraHelper<Graph>::CreateBoundedDijkstra(g, bound);
+            dijkstra.Run(v);
+            reached += dijkstra.ReachedVertices().size();
+        }
+    }
+    state.counters["reached"] = benchmark::Counter(double(reached), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(int64_t(state.iterations() * vertices.size()));
+}
+BENCHMARK(BM_BoundedDijkstra)->Args({1 << 20, 1000})->Args({1 << 20, 10000});
+
+}
@@ -0,0 +1,90 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "generators.hpp"
+
+#include "modules/alignment/pacbio/gap_dijkstra.hpp"
+#include "modules/alignment/sequence_mapper.hpp"
+
+#include <benchmark/benchmark.h>
+#include <random>
+
+namespace bench {
+
+using debruijn_graph::EdgeId;
+using debruijn_graph::VertexId;
+
+struct Gap {
+    std::string seq;
+    EdgeId start_e, end_e;
+    int start_p, end_p;
+};
+
+// Nanopore-like errors: substitutions, insertions and deletions in equal parts
+static std::string AddErrors(const std::string &s, double error_rate, std::mt19937_64 &rng) {
+    static const char NUCLS[] = "ACGT";
+    std::uniform_real_distribution<double> error(0, 1);
+    std::string res;
+    for (char c : s) {
+        double r = error(rng);
+        if (r < error_rate / 3)
+            res += NUCLS[rng() & 3];
+        else if (r < 2 * error_rate / 3)
+            res += std::string(1, c) + NUCLS[rng() & 3];
+        else if (r >= error_rate)
+            res += c;
+    }
+    return res;
+}
+
+// Gaps between the ends of the genome fragments mapped to several edges
+static std::vector<Gap> SimulateGaps(const SyntheticGraph &graph, size_t count, size_t length, double error_rate) {
+    auto mapper = debruijn_graph::MapperInstance(graph.gp());
+    const std::string &genome = graph.genome();
+    std::mt19937_64 rng(DEFAULT_SEED);
+    std::uniform_int_distribution<size_t> pos(0, genome.size() - length);
+
+    std::vector<Gap> gaps;
+    while (gaps.size() < count) {
+        std::string fragment = genome.substr(pos(rng), length);
+        auto path = mapper->MapSequence(Sequence(fragment));
+        if (path.size() < 2)
+            continue;
+
+        const auto &first = path.mapping_at(0), &last = path.mapping_at(path.size() - 1);
+        size_t from = first.initial_range.start_pos, to = last.initial_range.end_pos;
+        gaps.push_back({ AddErrors(fragment.substr(from, to - from), error_rate, rng),
+                         path.edge_at(0), path.edge_at(path.size() - 1),
+                         int(first.mapped_range.start_pos), int(last.mapped_range.end_pos) });
+    }
+    return gaps;
+}
+
+// Closes the gaps of the simulated reads. Args: gap length, error rate (per cent)
+static void BM_GapDijkstra(benchmark::State &state) {
+    const auto &graph = SyntheticGraph::Get(1 << 18, 55);
+    auto gaps = SimulateGaps(graph, 20, size_t(state.range(0)), double(state.range(1)) / 100);
+
+    sensitive_aligner::GapClosingConfig cfg;
+    std::unordered_map<VertexId, size_t> reachable;
+    size_t closed = 0;
+    for (auto _ : state) {
+        for (const auto &gap : gaps) {
+            // The limit of the edit distance as in GapFiller
+            int ed_limit = std::min(std::max(cfg.ed_lower_bound, int(gap.seq.size()) / cfg.max_ed_proportion),
+                                    cfg.ed_upper_bound);
+            sensitive_aligner::DijkstraGapFiller filler(graph.graph(), cfg, gap.seq, gap.start_e, gap.end_e,
+                                                        gap.start_p, gap.end_p, ed_limit, reachable);
+            filler.CloseGap();
+            closed += filler.edit_distance() != std::numeric_limits<int>::max();
+        }
+    }
+    state.counters["closed"] = benchmark::Counter(double(closed), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(int64_t(state.iterations() * gaps.size()));
+}
+BENCHMARK(BM_GapDijkstra)->Args({500, 10})->Args({1000, 10})->Unit(benchmark::kMillisecond);
+
+}
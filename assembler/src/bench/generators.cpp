@@ -0,0 +1,98 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "generators.hpp"
+
+#include "modules/alignment/edge_index.hpp"
+#include "modules/graph_construction.hpp"
+#include "io/reads/rc_reader_wrapper.hpp"
+#include "io/reads/read_stream_vector.hpp"
+#include "io/reads/vector_reader.hpp"
+#include "sequence/nucl.hpp"
+#include "sequence/sequence_tools.hpp"
+
+#include <map>
+#include <random>
+
+namespace bench {
+
+std::string RandomGenome(size_t size, size_t repeat_size, size_t repeat_count, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> nucl_dist(0, 3);
+
+    std::string genome(size, 'A');
+    for (char &c : genome)
+        c = nucl(char(nucl_dist(rng)));
+
+    if (!repeat_size || !repeat_count || repeat_size >= size)
+        return genome;
+
+    std::string repeat(genome, 0, repeat_size);
+    std::uniform_int_distribution<size_t> pos(0, size - repeat_size);
+    for (size_t i = 0; i < repeat_count; ++i)
+        genome.replace(pos(rng), repeat_size, repeat);
+
+    return genome;
+}
+
+std::vector<io::SingleRead> SimulateReads(const std::string &genome, size_t count, size_t length,
+                                          double error_rate, uint64_t seed) {
+    VERIFY(length <= genome.size());
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<size_t> pos(0, genome.size() - length);
+    std::uniform_int_distribution<int> shift(1, 3);
+    std::bernoulli_distribution error(error_rate), strand(0.5);
+
+    std::vector<io::SingleRead> reads;
+    reads.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string read = genome.substr(pos(rng), length);
+        if (error_rate > 0) {
+            for (char &c : read)
+                if (error(rng))
+                    c = nucl(char((dignucl(c) + shift(rng)) % 4));
+        }
+        if (strand(rng))
+            read = ReverseComplement(read);
+
+        reads.emplace_back("read_" + std::to_string(i), read);
+    }
+
+    return reads;
+}
+
+SyntheticGraph::SyntheticGraph(const std::string &genome, size_t k)
+        : genome_(genome),
+          workdir_(fs::tmp::make_temp_dir(".", "bench")),
+          gp_(new debruijn_graph::GraphPack(k, workdir_->dir(), 0)) {
+    using namespace debruijn_graph;
+
+    // Overlapping error-free fragments covering every k-mer of the genome
+    const size_t fragment = 1000;
+    std::vector<io::SingleRead> reads;
+    for (size_t pos = 0; pos + k < genome.size(); pos += fragment - k)
+        reads.emplace_back("fragment", genome.substr(pos, fragment));
+
+    io::ReadStreamList<io::SingleRead> streams(io::RCWrap<io::SingleRead>(io::VectorReadStream<io::SingleRead>(reads)));
+    ConstructGraphWithIndex(config::debruijn_config::construction(),
+                            fs::tmp::make_temp_dir(workdir_->dir(), "construction"), streams,
+                            gp_->get_mutable<Graph>(), gp_->get_mutable<EdgeIndex<Graph>>());
+}
+
+const debruijn_graph::Graph &SyntheticGraph::graph() const {
+    return gp_->get<debruijn_graph::Graph>();
+}
+
+const SyntheticGraph &SyntheticGraph::Get(size_t genome_size, size_t k) {
+    static std::map<std::pair<size_t, size_t>, std::unique_ptr<SyntheticGraph>> cache;
+    auto &entry = cache[{ genome_size, k }];
+    if (!entry)
+        entry.reset(new SyntheticGraph(RandomGenome(genome_size, /* repeat_size */ 2 * k,
+                                                    /* repeat_count */ genome_size / 5000), k));
+    return *entry;
+}
+
+}
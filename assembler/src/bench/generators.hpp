@@ -0,0 +1,58 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "assembly_graph/core/graph.hpp"
+#include "io/reads/single_read.hpp"
+#include "pipeline/graph_pack.hpp"
+#include "utils/filesystem/temporary.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// All the data is generated from the fixed seeds, so the runs are comparable
+const uint64_t DEFAULT_SEED = 42;
+
+/*
+ * Random genome. The repeat of the given length is inserted several times
+ * to get the branching de Bruijn graph.
+ */
+std::string RandomGenome(size_t size, size_t repeat_size = 0, size_t repeat_count = 0,
+                         uint64_t seed = DEFAULT_SEED);
+
+/*
+ * Reads sampled uniformly from both strands of the genome with the
+ * substitution errors.
+ */
+std::vector<io::SingleRead> SimulateReads(const std::string &genome, size_t count, size_t length,
+                                          double error_rate = 0, uint64_t seed = DEFAULT_SEED);
+
+/*
+ * De Bruijn graph of the genome together with its k-mer index. Built with
+ * the default construction settings.
+ */
+class SyntheticGraph {
+public:
+    SyntheticGraph(const std::string &genome, size_t k);
+
+    const std::string &genome() const { return genome_; }
+    const debruijn_graph::Graph &graph() const;
+    const debruijn_graph::GraphPack &gp() const { return *gp_; }
+
+    // Cached instance per the set of parameters, graphs are expensive to build
+    static const SyntheticGraph &Get(size_t genome_size, size_t k);
+
+private:
+    std::string genome_;
+    fs::TmpDir workdir_;
+    std::unique_ptr<debruijn_graph::GraphPack> gp_;
+};
+
+}
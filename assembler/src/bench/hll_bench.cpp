@@ -0,0 +1,60 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "generators.hpp"
+
+#include "adt/hll.hpp"
+
+#include <benchmark/benchmark.h>
+#include <random>
+
+namespace bench {
+
+// The registers of the precision 24 sketch
+static std::vector<uint8_t> Registers(size_t seed) {
+    std::mt19937_64 rng(DEFAULT_SEED + seed);
+    std::vector<uint8_t> res(1 << 24);
+    for (auto &r : res)
+        r = uint8_t(__builtin_ctzll(rng() | (1ull << 40)) + 1);
+    return res;
+}
+
+// Args: 1 for AVX2
+static void BM_HLLHarmonicSum(benchmark::State &state) {
+    if (state.range(0) && !hll::impl::HasAVX2()) {
+        state.SkipWithError("AVX2 is not supported");
+        return;
+    }
+    auto regs = Registers(0);
+    size_t zeros;
+    for (auto _ : state) {
+        double sum = state.range(0) ?
+                     hll::impl::HarmonicSum(regs.data(), regs.size(), zeros) :
+                     hll::impl::HarmonicSumScalar(regs.data(), regs.size(), zeros);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations() * regs.size()));
+}
+BENCHMARK(BM_HLLHarmonicSum)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+static void BM_HLLMerge(benchmark::State &state) {
+    if (state.range(0) && !hll::impl::HasAVX2()) {
+        state.SkipWithError("AVX2 is not supported");
+        return;
+    }
+    auto dst = Registers(0), src = Registers(1);
+    for (auto _ : state) {
+        if (state.range(0))
+            hll::impl::Merge(dst.data(), src.data(), dst.size());
+        else
+            hll::impl::MergeScalar(dst.data(), src.data(), dst.size());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(int64_t(state.iterations() * dst.size()));
+}
+BENCHMARK(BM_HLLMerge)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+}
@@ -0,0 +1,181 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "generators.hpp"
+
+#include "io/reads/read_stream_vector.hpp"
+#include "io/reads/vector_reader.hpp"
+#include "utils/extension_index/kmer_extension_index.hpp"
+#include "adt/cqf.hpp"
+#include "utils/kmer_mph/kmer_index_builder.hpp"
+#include "utils/kmer_mph/kmer_splitters.hpp"
+#include "utils/ph_map/coverage_hash_map_builder.hpp"
+#include "utils/ph_map/perfect_hash_map_builder.hpp"
+#include "utils/ph_map/storing_traits.hpp"
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <map>
+#include <random>
+
+namespace bench {
+
+using StoringType = utils::DefaultStoring;
+using Splitter = utils::DeBruijnReadKMerSplitter<io::SingleRead, utils::StoringTypeFilter<StoringType>>;
+using KMerMap = utils::PerfectHashMap<RtSeq, uint32_t, utils::slim_kmer_index_traits<RtSeq>, StoringType>;
+using CoverageMap = utils::PerfectHashMap<RtSeq, uint32_t, utils::slim_kmer_index_traits<RtSeq>, utils::DefaultStoring>;
+
+const unsigned K = 31;
+const size_t READ_LENGTH = 150;
+
+static io::ReadStreamList<io::SingleRead> ReadStreams(const std::vector<io::SingleRead> &reads, unsigned nstreams) {
+    io::ReadStreamList<io::SingleRead> streams;
+    for (unsigned i = 0; i < nstreams; ++i) {
+        std::vector<io::SingleRead> part(reads.begin() + i * reads.size() / nstreams,
+                                         reads.begin() + (i + 1) * reads.size() / nstreams);
+        streams.push_back(io::VectorReadStream<io::SingleRead>(part));
+    }
+    return streams;
+}
+
+static const std::vector<io::SingleRead> &Reads(size_t count, double error_rate = 0.01) {
+    static std::map<std::pair<size_t, double>, std::vector<io::SingleRead>> cache;
+    auto &reads = cache[{ count, error_rate }];
+    if (reads.empty())
+        reads = SimulateReads(RandomGenome(1 << 20), count, READ_LENGTH, error_rate);
+    return reads;
+}
+
+// Counts the distinct k-mers of the simulated reads. Args: the number of reads, threads
+static void BM_KMerDiskCounter(benchmark::State &state) {
+    const auto &reads = Reads(size_t(state.range(0)));
+    unsigned nthreads = unsigned(state.range(1));
+    auto workdir = fs::tmp::make_temp_dir(".", "bench_kmers");
+
+    size_t kmers = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto streams = ReadStreams(reads, nthreads);
+        state.ResumeTiming();
+
+        kmers::KMerDiskCounter<RtSeq> counter(workdir, Splitter(workdir, K, streams));
+        auto storage = counter.Count(16 * nthreads, nthreads);
+        kmers = storage.total_kmers();
+    }
+    state.counters["kmers"] = double(kmers);
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(reads.size() * (READ_LENGTH - K + 1)));
+}
+BENCHMARK(BM_KMerDiskCounter)->Args({100000, 1})->Args({100000, 4})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static const kmers::KMerDiskStorage<RtSeq> &Storage() {
+    static auto workdir = fs::tmp::make_temp_dir(".", "bench_phm");
+    static std::unique_ptr<kmers::KMerDiskStorage<RtSeq>> storage;
+    if (!storage) {
+        auto streams = ReadStreams(Reads(100000, /* error_rate */ 0), 1);
+        kmers::KMerDiskCounter<RtSeq> counter(workdir, Splitter(workdir, K, streams));
+        storage.reset(new kmers::KMerDiskStorage<RtSeq>(counter.Count(16, 1)));
+    }
+    return *storage;
+}
+
+// Builds the perfect hash over the counted k-mers. Arg: threads
+static void BM_PerfectHashMapBuild(benchmark::State &state) {
+    const auto &storage = Storage();
+    for (auto _ : state) {
+        KMerMap map(K);
+        utils::BuildIndex(map, storage, size_t(state.range(0)));
+        benchmark::DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(storage.total_kmers()));
+}
+BENCHMARK(BM_PerfectHashMapBuild)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Looks up all the k-mers of the indexed reads, so all of them are present
+static void BM_PerfectHashMapLookup(benchmark::State &state) {
+    KMerMap map(K);
+    utils::BuildIndex(map, Storage(), 1);
+    const auto &indexed = Reads(100000, /* error_rate */ 0);
+    std::vector<io::SingleRead> reads(indexed.begin(), indexed.begin() + 1000);
+
+    size_t lookups = 0;
+    for (auto _ : state) {
+        for (const auto &read : reads) {
+            Sequence seq = read.sequence();
+            RtSeq kmer = seq.start<RtSeq>(K) >> 'A';
+            for (size_t j = K - 1; j < seq.size(); ++j) {
+                kmer <<= seq[j];
+                auto kwh = map.ConstructKWH(kmer);
+                benchmark::DoNotOptimize(map.get_value(kwh, utils::InvertableStoring::trivial_inverter()));
+                lookups += 1;
+            }
+        }
+    }
+    state.SetItemsProcessed(int64_t(lookups));
+}
+BENCHMARK(BM_PerfectHashMapLookup);
+
+// Half of the reads come from a short sequence (as adapters or rRNA), the rest cover the genome uniformly
+static const std::vector<io::SingleRead> &SkewedReads() {
+    static std::vector<io::SingleRead> reads;
+    if (reads.empty()) {
+        reads = SimulateReads(RandomGenome(1 << 20), 50000, READ_LENGTH);
+        auto hot = SimulateReads(RandomGenome(2000, 0, 0, DEFAULT_SEED + 1), 50000, READ_LENGTH);
+        reads.insert(reads.end(), hot.begin(), hot.end());
+        std::shuffle(reads.begin(), reads.end(), std::mt19937_64(DEFAULT_SEED));
+    }
+    return reads;
+}
+
+// Fills the coverage of the k-mers of the skewed reads. Args: threads, cache size, replicas
+static void BM_CoverageFill(benchmark::State &state) {
+    static auto workdir = fs::tmp::make_temp_dir(".", "bench_coverage");
+    static std::unique_ptr<kmers::KMerDiskStorage<RtSeq>> storage;
+    const auto &reads = SkewedReads();
+    if (!storage) {
+        auto streams = ReadStreams(reads, 1);
+        kmers::KMerDiskCounter<RtSeq> counter(workdir, Splitter(workdir, K, streams));
+        storage.reset(new kmers::KMerDiskStorage<RtSeq>(counter.Count(16, 1)));
+    }
+
+    unsigned nthreads = unsigned(state.range(0));
+    utils::CoverageHashMapBuilder builder(size_t(state.range(1)), unsigned(state.range(2)));
+    CoverageMap map(K);
+    builder.utils::PerfectHashMapBuilder::BuildIndex(map, *storage, nthreads);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto streams = ReadStreams(reads, nthreads);
+        state.ResumeTiming();
+
+        builder.FillCoverage(map, streams);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(reads.size() * (READ_LENGTH - K + 1)));
+}
+BENCHMARK(BM_CoverageFill)
+        ->Args({1, 0, 1})->Args({4, 0, 1})->Args({4, 1 << 10, 1})->Args({4, 1 << 10, 2})
+        ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Doubles the full filter of 2^20 slots. Args: threads, 0 for the reinsertion of all the counters
+static void BM_CQFExpand(benchmark::State &state) {
+    std::mt19937_64 rng(DEFAULT_SEED);
+    for (auto _ : state) {
+        state.PauseTiming();
+        qf::cqf cqf(1 << 19);
+        while (!cqf.full())
+            cqf.add(rng(), rng() % 4 + 1);
+        state.ResumeTiming();
+
+        if (state.range(0)) {
+            cqf.expand(unsigned(state.range(0)));
+        } else {
+            qf::cqf larger(2 * cqf.slots(), cqf.hash_bits());
+            larger.merge(cqf);
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(1 << 20));
+}
+BENCHMARK(BM_CQFExpand)->Arg(0)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
@@ -0,0 +1,39 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "generators.hpp"
+
+#include "modules/alignment/sequence_mapper.hpp"
+
+#include <benchmark/benchmark.h>
+
+namespace bench {
+
+// Maps the simulated reads to the graph of their genome. Args: genome size, error rate (per mille)
+static void BM_MapSequence(benchmark::State &state) {
+    const size_t genome_size = size_t(state.range(0)), k = 55;
+    const auto &graph = SyntheticGraph::Get(genome_size, k);
+    auto mapper = debruijn_graph::MapperInstance(graph.gp());
+
+    auto reads = SimulateReads(graph.genome(), 1000, 150, double(state.range(1)) / 1000);
+    std::vector<Sequence> seqs;
+    for (const auto &read : reads)
+        seqs.push_back(read.sequence());
+
+    size_t nucls = 0;
+    for (auto _ : state) {
+        for (const auto &seq : seqs) {
+            auto path = mapper->MapSequence(seq);
+            benchmark::DoNotOptimize(path);
+            nucls += seq.size();
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations() * seqs.size()));
+    state.SetBytesProcessed(int64_t(nucls));
+}
+BENCHMARK(BM_MapSequence)->Args({1 << 20, 0})->Args({1 << 20, 10});
+
+}
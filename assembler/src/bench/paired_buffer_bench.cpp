@@ -0,0 +1,90 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "generators.hpp"
+
+#include "paired_info/concurrent_pair_info_buffer.hpp"
+#include "paired_info/sharded_pair_info_buffer.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+
+#include <benchmark/benchmark.h>
+#include <random>
+
+namespace bench {
+
+using debruijn_graph::Graph;
+using debruijn_graph::EdgeId;
+using omnigraph::de::RawPoint;
+
+struct PairedPoint {
+    EdgeId e1, e2;
+    RawPoint p;
+};
+
+// Pairs of the random edges with the close distances. Most of the pairs are repeated several times
+static std::vector<PairedPoint> RandomPoints(const Graph &g, size_t count) {
+    std::vector<EdgeId> edges;
+    for (EdgeId e : g.edges())
+        edges.push_back(e);
+    std::mt19937_64 rng(DEFAULT_SEED);
+    std::uniform_int_distribution<size_t> edge(0, edges.size() - 1), pair(0, count / 8);
+    std::uniform_int_distribution<int> dist(-300, 300);
+
+    std::vector<PairedPoint> pairs;
+    for (size_t i = 0; i <= count / 8; ++i)
+        pairs.push_back({ edges[edge(rng)], edges[edge(rng)], RawPoint() });
+
+    std::vector<PairedPoint> points;
+    points.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        PairedPoint point = pairs[pair(rng)];
+        point.p = RawPoint(float(dist(rng)), 1.f);
+        points.push_back(point);
+    }
+    return points;
+}
+
+static const std::vector<PairedPoint> &Points() {
+    static std::vector<PairedPoint> points = RandomPoints(SyntheticGraph::Get(1 << 20, 55).graph(), 1 << 20);
+    return points;
+}
+
+// Inserts the points into the concurrent buffer. Arg: threads
+static void BM_ConcurrentPairedBufferInsert(benchmark::State &state) {
+    const Graph &g = SyntheticGraph::Get(1 << 20, 55).graph();
+    const auto &points = Points();
+    unsigned nthreads = unsigned(state.range(0));
+
+    for (auto _ : state) {
+        omnigraph::de::ConcurrentPairedInfoBuffer<Graph> buffer(g);
+#       pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (size_t i = 0; i < points.size(); ++i)
+            buffer.Add(points[i].e1, points[i].e2, points[i].p);
+        benchmark::DoNotOptimize(buffer.size());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(points.size()));
+}
+BENCHMARK(BM_ConcurrentPairedBufferInsert)->Arg(1)->Arg(2)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Inserts the points into the sharded buffer and reduces it. Arg: threads
+static void BM_ShardedPairedBufferInsert(benchmark::State &state) {
+    const Graph &g = SyntheticGraph::Get(1 << 20, 55).graph();
+    const auto &points = Points();
+    unsigned nthreads = unsigned(state.range(0));
+
+    for (auto _ : state) {
+        omnigraph::de::ShardedPairedInfoBuffer<Graph> buffer(g, nthreads);
+#       pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (size_t i = 0; i < points.size(); ++i)
+            buffer.Add(omp_get_thread_num(), points[i].e1, points[i].e2, points[i].p);
+        buffer.Reduce();
+        benchmark::DoNotOptimize(buffer.size());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(points.size()));
+}
+BENCHMARK(BM_ShardedPairedBufferInsert)->Arg(1)->Arg(2)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
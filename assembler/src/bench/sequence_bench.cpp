@@ -0,0 +1,52 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "generators.hpp"
+
+#include "sequence/sequence.hpp"
+#include "sequence/rtseq.hpp"
+
+#include <benchmark/benchmark.h>
+
+namespace bench {
+
+static void BM_SequenceFromString(benchmark::State &state) {
+    std::string genome = RandomGenome(size_t(state.range(0)));
+    for (auto _ : state) {
+        Sequence seq(genome);
+        benchmark::DoNotOptimize(seq);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(genome.size()));
+}
+BENCHMARK(BM_SequenceFromString)->Arg(100)->Arg(10000)->Arg(1 << 20);
+
+static void BM_SequenceToString(benchmark::State &state) {
+    Sequence seq(RandomGenome(size_t(state.range(0))));
+    // Unaligned reverse-complement subsequence is the slowest case
+    Sequence sub = !seq.Subseq(1, seq.size() - 1);
+    for (auto _ : state) {
+        std::string str = sub.str();
+        benchmark::DoNotOptimize(str);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(sub.size()));
+}
+BENCHMARK(BM_SequenceToString)->Arg(100)->Arg(10000);
+
+static void BM_SequenceKMers(benchmark::State &state) {
+    const unsigned k = unsigned(state.range(0));
+    Sequence seq(RandomGenome(1 << 16));
+    for (auto _ : state) {
+        RtSeq kmer = seq.start<RtSeq>(k);
+        for (size_t i = k; i < seq.size(); ++i) {
+            kmer <<= seq[i];
+            benchmark::DoNotOptimize(kmer);
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(seq.size() - k + 1));
+}
+BENCHMARK(BM_SequenceKMers)->Arg(21)->Arg(55)->Arg(127);
+
+}
@@ -1,15 +1,22 @@
 #pragma once
 
+#include "adt/lemiere_mod_reduce.hpp"
+#include "utils/verify.hpp"
+
 #include <functional>
 #include <vector>
 #include <atomic>
 
 #include <cassert>
+#include <cstdint>
 
 namespace bf {
 
 /// The counting Bloom filter.
-template<class T, unsigned width_ = 4>
+/// The hasher is a template parameter, so the filter with a functor type
+/// inlines the hash calls instead of going through std::function.
+template<class T, unsigned width_ = 4,
+         class Hasher = std::function<size_t(const T &, uint64_t seed)>>
 class counting_bloom_filter {
     counting_bloom_filter(const counting_bloom_filter &) = delete;
     counting_bloom_filter &operator=(const counting_bloom_filter &) = delete;
@@ -19,11 +26,11 @@ protected:
     static constexpr size_t cells_per_entry_ = 8 * sizeof(uint64_t) / width_;
 
 public:
-    /// The hash digest type.F
+    /// The hash digest type.
     typedef size_t digest;
 
     /// The hash function type.
-    typedef std::function<digest(const T &, uint64_t seed)> hasher;
+    typedef Hasher hasher;
 
     // FIXME disable default constructor
     counting_bloom_filter() = default;
@@ -51,30 +58,8 @@ public:
     /// @tparam T The type of the element to insert.
     /// @param x An instance of type `T`.
     void add(const T &o) {
-        for (size_t i = 0; i < num_hashes_; ++i) {
-            digest d = hasher_(o, i);
-            size_t cell_id = d - cells_ * (d / cells_); // Use division here in order to test stuff like libidivide
-            size_t pos = cell_id / cells_per_entry_;
-            size_t epos = cell_id - pos * cells_per_entry_;
-            auto &entry = data_[pos];
-            uint64_t mask = cell_mask_ << (width_ * epos);
-
-            // Add counter
-            while (true) {
-                uint64_t val = entry.load();
-
-                // Overflow, do nothing
-                if ((val & mask) == mask)
-                    break;
-
-                uint64_t newval = val + (1ull << (width_ * epos));
-                if (!entry.compare_exchange_strong(val, newval))
-                    continue;
-
-                break;
-            }
-
-        }
+        for (size_t i = 0; i < num_hashes_; ++i)
+            increment(cell(o, i));
     }
 
     /// Retrieves the count of an element.
@@ -84,11 +69,7 @@ public:
     size_t lookup(const T &o) const {
         size_t val = (1ull << width_) - 1;
         for (size_t i = 0; i < num_hashes_; ++i) {
-            digest d = hasher_(o, i);
-            size_t cell_id = d - cells_ * (d / cells_); // Use division here in order to test stuff like libidivide
-            size_t pos = cell_id / cells_per_entry_;
-            size_t epos = cell_id - pos * cells_per_entry_;
-            size_t cval = (data_[pos] >> (width_ * epos)) & cell_mask_;
+            size_t cval = count(cell(o, i));
             if (val > cval)
                 val = cval;
         }
@@ -101,10 +82,10 @@ public:
         std::fill(data_.begin(), data_.end(), 0);
     }
 
-    void merge(const counting_bloom_filter<T, width_> &other) {
+    void merge(const counting_bloom_filter &other) {
         VERIFY(data_.size() == other.data_.size());
         VERIFY(num_hashes_ == other.num_hashes_);
-        VERIFY(cells_ = other.cells_);
+        VERIFY(cells_ == other.cells_);
 
         for (size_t cell_id = 0; cell_id < cells_; ++cell_id) {
             size_t pos = cell_id / cells_per_entry_;
@@ -141,31 +122,174 @@ public:
     }
 
 protected:
+    /// The cell of the i-th hash: Lemire's multiply-shift maps the digest
+    /// onto [0, cells) without the division.
+    size_t cell(const T &o, size_t i) const {
+        return mod_reduce::multiply_high_u64(hasher_(o, i), cells_);
+    }
+
+    void increment(size_t cell_id) {
+        size_t pos = cell_id / cells_per_entry_;
+        size_t epos = cell_id - pos * cells_per_entry_;
+        auto &entry = data_[pos];
+        uint64_t mask = cell_mask_ << (width_ * epos);
+
+        // Add counter
+        while (true) {
+            uint64_t val = entry.load();
+
+            // Overflow, do nothing
+            if ((val & mask) == mask)
+                break;
+
+            uint64_t newval = val + (1ull << (width_ * epos));
+            if (!entry.compare_exchange_strong(val, newval))
+                continue;
+
+            break;
+        }
+    }
+
+    size_t count(size_t cell_id) const {
+        size_t pos = cell_id / cells_per_entry_;
+        size_t epos = cell_id - pos * cells_per_entry_;
+        return (data_[pos] >> (width_ * epos)) & cell_mask_;
+    }
+
     hasher hasher_;
     size_t num_hashes_;
     size_t cells_;
     std::vector<std::atomic<uint64_t>> data_;
 };
 
+/// The blocked counting Bloom filter: the first hash selects a 64-byte block
+/// (a cache line), all the counters of an element are in this block, so an
+/// update or a lookup costs a single cache miss. The positions inside the block
+/// are cut from the digest of the second hash, so a single hasher call gives
+/// up to 64 / log2(cells per block) of them instead of one. The price is a
+/// somewhat higher false positive rate due to the uneven load of the blocks.
+template<class T, unsigned width_ = 4,
+         class Hasher = std::function<size_t(const T &, uint64_t seed)>>
+class blocked_counting_bloom_filter {
+    blocked_counting_bloom_filter(const blocked_counting_bloom_filter &) = delete;
+    blocked_counting_bloom_filter &operator=(const blocked_counting_bloom_filter &) = delete;
+
+    static constexpr uint64_t cell_mask_ = (1ull << width_) - 1;
+    static constexpr size_t cells_per_entry_ = 8 * sizeof(uint64_t) / width_;
+    static constexpr size_t entries_per_block_ = 64 / sizeof(uint64_t);
+    static constexpr size_t cells_per_block_ = entries_per_block_ * cells_per_entry_;
+    static constexpr unsigned cell_bits_ = __builtin_ctzll(cells_per_block_);
+
+public:
+    /// The hash digest type.
+    typedef size_t digest;
+
+    /// The hash function type.
+    typedef Hasher hasher;
+
+    /// Constructs a blocked counting Bloom filter.
+    /// @param h The hasher.
+    /// @param cells The number of cells, rounded up to the whole blocks.
+    /// @param num_hashes The number of counters per element
+    blocked_counting_bloom_filter(hasher h,
+                                  size_t cells, size_t num_hashes = 3)
+            : hasher_(std::move(h)),
+              num_hashes_(num_hashes),
+              blocks_((cells + cells_per_block_ - 1) / cells_per_block_),
+              // Extra entries to align the blocks to the cache lines
+              data_(blocks_ * entries_per_block_ + entries_per_block_ - 1) {
+        static_assert((width_ & (width_ - 1)) == 0, "Width must be power of two");
+        VERIFY(blocks_ > 0);
+        size_t misalignment = reinterpret_cast<uintptr_t>(data_.data()) % 64 / sizeof(uint64_t);
+        offset_ = misalignment ? entries_per_block_ - misalignment : 0;
+    }
+
+    blocked_counting_bloom_filter(blocked_counting_bloom_filter &&) = default;
+
+    /// Adds an element to the Bloom filter.
+    void add(const T &o) {
+        std::atomic<uint64_t> *block = this->block(o);
+        digest d = hasher_(o, 1);
+        for (size_t i = 0, left = 64; i < num_hashes_; ++i, left -= cell_bits_) {
+            if (left < cell_bits_)
+                d = hasher_(o, 1 + i), left = 64;
+            increment(block, d >> (64 - left) & (cells_per_block_ - 1));
+        }
+    }
+
+    /// Retrieves the count of an element.
+    /// @return A frequency estimate for *o*.
+    size_t lookup(const T &o) const {
+        const std::atomic<uint64_t> *block = this->block(o);
+        size_t val = (1ull << width_) - 1;
+        digest d = hasher_(o, 1);
+        for (size_t i = 0, left = 64; i < num_hashes_; ++i, left -= cell_bits_) {
+            if (left < cell_bits_)
+                d = hasher_(o, 1 + i), left = 64;
+            size_t cell_id = d >> (64 - left) & (cells_per_block_ - 1);
+            size_t cval = (block[cell_id / cells_per_entry_] >> (width_ * (cell_id % cells_per_entry_))) & cell_mask_;
+            if (val > cval)
+                val = cval;
+        }
+
+        return val;
+    }
+
+    /// Removes all items from the Bloom filter.
+    void clear() {
+        std::fill(data_.begin(), data_.end(), 0);
+    }
+
+    /// The number of cells, i.e. the cells requested rounded up to the blocks
+    size_t cells() const {
+        return blocks_ * cells_per_block_;
+    }
+
+private:
+    std::atomic<uint64_t> *block(const T &o) {
+        return data_.data() + offset_ + mod_reduce::multiply_high_u64(hasher_(o, 0), blocks_) * entries_per_block_;
+    }
+
+    const std::atomic<uint64_t> *block(const T &o) const {
+        return data_.data() + offset_ + mod_reduce::multiply_high_u64(hasher_(o, 0), blocks_) * entries_per_block_;
+    }
+
+    static void increment(std::atomic<uint64_t> *block, size_t cell_id) {
+        size_t epos = cell_id % cells_per_entry_;
+        auto &entry = block[cell_id / cells_per_entry_];
+        uint64_t mask = cell_mask_ << (width_ * epos);
+
+        uint64_t val = entry.load();
+        // Stop at overflow
+        while ((val & mask) != mask &&
+               !entry.compare_exchange_weak(val, val + (1ull << (width_ * epos))));
+    }
+
+    hasher hasher_;
+    size_t num_hashes_;
+    size_t blocks_;
+    size_t offset_;
+    std::vector<std::atomic<uint64_t>> data_;
+};
+
 /// The counting Bloom filter.
-template<class T, unsigned width_ = 4>
-class bitcounting_bloom_filter : public counting_bloom_filter<T, width_> {
-    using typename counting_bloom_filter<T, width_>::digest;
-    using typename counting_bloom_filter<T, width_>::hasher;
+template<class T, unsigned width_ = 4,
+         class Hasher = std::function<size_t(const T &, uint64_t seed)>>
+class bitcounting_bloom_filter : public counting_bloom_filter<T, width_, Hasher> {
+    using base = counting_bloom_filter<T, width_, Hasher>;
+    using typename base::hasher;
 
 public:
     bitcounting_bloom_filter(hasher h,
                              size_t cells, size_t num_hashes = 3)
-            : counting_bloom_filter<T, width_>(h, cells, num_hashes) { }
+            : base(std::move(h), cells, num_hashes) { }
 
     /// Adds an element to the Bloom filter.
     /// @tparam T The type of the element to insert.
     /// @param x An instance of type `T`.
     void add(const T &o) {
         for (size_t i = 0; i < this->num_hashes_; ++i) {
-            digest d = this->hasher_(o, i);
-            size_t cell_id = d - this->cells_ *
-                                 (d / this->cells_); // Use division here in order to test stuff like libidivide
+            size_t cell_id = this->cell(o, i);
             size_t pos = cell_id / this->cells_per_entry_;
             size_t epos = cell_id - pos * this->cells_per_entry_;
             auto &entry = this->data_[pos];
@@ -197,9 +321,7 @@ public:
     size_t lookup(const T &o) const {
         size_t val = (1ull << width_) - 1;
         for (size_t i = 0; i < this->num_hashes_; ++i) {
-            digest d = this->hasher_(o, i);
-            size_t cell_id = d - this->cells_ *
-                                 (d / this->cells_); // Use division here in order to test stuff like libidivide
+            size_t cell_id = this->cell(o, i);
             size_t pos = cell_id / this->cells_per_entry_;
             size_t epos = cell_id - pos * this->cells_per_entry_;
             uint64_t entry = (this->data_[pos] >> (width_ * epos)) & this->cell_mask_;
@@ -0,0 +1,126 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include <parallel_hashmap/phmap.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace adt {
+
+/*
+ * Bounded memoization cache for the concurrent use. The keys are spread over
+ * the shards by hash, each shard is a flat hash map under its own lock. When
+ * a shard is full, the entries not used since the previous eviction are
+ * dropped (the CLOCK approximation of LRU).
+ */
+template<class Key, class Value, class Hash = phmap::Hash<Key>>
+class concurrent_cache {
+    struct Entry {
+        Value value;
+        bool used;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        phmap::flat_hash_map<Key, Entry, Hash> entries;
+    };
+
+  public:
+    /**
+     * @param capacity maximal number of entries
+     * @param shards number of the independently locked parts, rounded up to a power of 2
+     */
+    explicit concurrent_cache(size_t capacity, size_t shards = 64)
+            : hash_(), mask_(RoundUp(shards) - 1),
+              shard_capacity_(std::max<size_t>(1, capacity / (mask_ + 1))),
+              shards_(mask_ + 1) {}
+
+    /**
+     * @return true and sets the value if the key is cached
+     */
+    bool find(const Key &key, Value &value) const {
+        Shard &shard = this->shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it == shard.entries.end())
+            return false;
+
+        it->second.used = true;
+        value = it->second.value;
+        return true;
+    }
+
+    void insert(const Key &key, const Value &value) {
+        Shard &shard = this->shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.entries.size() >= shard_capacity_)
+            Evict(shard);
+        shard.entries[key] = Entry{ value, false };
+    }
+
+    size_t size() const {
+        size_t res = 0;
+        for (auto &shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            res += shard.entries.size();
+        }
+        return res;
+    }
+
+    void clear() {
+        for (auto &shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.entries.clear();
+        }
+    }
+
+  private:
+    static size_t RoundUp(size_t n) {
+        size_t res = 1;
+        while (res < n)
+            res <<= 1;
+        return res;
+    }
+
+    Shard &shard(const Key &key) const {
+        size_t hash = hash_(key);
+        return shards_[(hash ^ (hash >> 32)) & mask_];
+    }
+
+    void Evict(Shard &shard) {
+        auto &entries = shard.entries;
+        for (auto it = entries.begin(); it != entries.end(); ) {
+            if (it->second.used) {
+                it->second.used = false;
+                ++it;
+            } else {
+                entries.erase(it++);
+            }
+        }
+
+        // Everything was used since the previous eviction, drop the half
+        if (entries.size() >= shard_capacity_) {
+            size_t i = 0;
+            for (auto it = entries.begin(); it != entries.end(); ++i) {
+                if (i % 2)
+                    entries.erase(it++);
+                else
+                    ++it;
+            }
+        }
+    }
+
+    Hash hash_;
+    size_t mask_;
+    size_t shard_capacity_;
+    mutable std::vector<Shard> shards_;
+};
+
+}
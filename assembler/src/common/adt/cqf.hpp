@@ -1,11 +1,16 @@
 #pragma once
 
 #include "gqf/gqf.h"
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/verify.hpp"
+
+#include <algorithm>
 #include <mutex>
 #include <cmath>
 #include <cstring>
 #include <functional>
 #include <cassert>
+#include <vector>
 
 namespace qf {
 
@@ -39,27 +44,72 @@ class cqf {
 
     cqf(cqf&&) noexcept = default;
 
+    /// Returns false if the lock was not taken without spinning or if the filter is
+    /// full (qf_insert does not check the capacity, so a full filter would overrun)
     bool add(digest d, uint64_t count = 1,
              bool lock = true, bool spin = true) {
+        if (full())
+            return false;
         bool res = qf_insert(&qf_, d & range_mask_, 0, count, lock, spin);
         if (res)
             insertions_ += 1;
         return res;
     }
 
-    void expand() {
+    /*
+     * Doubles the slots keeping the hash bits. The keys of the runs come in
+     * the sorted order, so the counters are appended to the larger filter
+     * without shifting: the disjoint ranges of the runs are copied in
+     * parallel, the even ones and then the odd ones, so the neighbours never
+     * write to the same block. The tails of the clusters crossing the range
+     * boundaries do not fit into their range and are inserted afterwards.
+     */
+    void expand(unsigned nthreads = 1) {
         // Create new QF having the same hash bits, but double the slots
         QF nqf;
         qf_init(&nqf, 2 * num_slots_, num_hash_bits_, 0, 239);
 
-        merge(&nqf, &qf_);
+        // The ranges of the runs are aligned to the blocks of 64 slots
+        size_t ranges = std::max<size_t>(1, std::min<size_t>(num_slots_ / 64, 4 * nthreads));
+        auto range_start = [&](size_t i) { return num_slots_ / 64 * i / ranges * 64; };
+        std::vector<uint64_t> runs(ranges), indices(ranges, 0);
+        for (size_t parity = 0; parity < 2; ++parity) {
+#           pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+            for (size_t i = parity; i < ranges; i += 2) {
+                runs[i] = range_start(i);
+                uint64_t limit = i + 1 < ranges ? 2 * range_start(i + 1) : nqf.metadata->xnslots;
+                qf_append_runs(&qf_, &nqf, &runs[i], &indices[i], range_start(i + 1), limit);
+            }
+        }
+
+        for (size_t i = 0; i < ranges; ++i)
+            qf_insert_runs(&qf_, &nqf, runs[i], indices[i], range_start(i + 1));
 
         qf_destroy(&qf_);
         memcpy(&qf_, &nqf, sizeof(qf_));
         num_slots_ = 2 * num_slots_;
     }
 
-    void merge(cqf &other) {
+    /// Expands the filter when it is almost full, so the next batch of the insertions
+    /// fits. Must not run concurrently with the insertions
+    bool expand_if_full(unsigned nthreads = 1) {
+        if (!almost_full())
+            return false;
+        expand(nthreads);
+        return true;
+    }
+
+    /// Whether the counters of the other filter surely fit: a key takes at most as many
+    /// slots as it takes in both filters
+    bool fits(const cqf &other) const {
+        return occupied_slots() + other.occupied_slots() < capacity();
+    }
+
+    /// Moves the counters of the other filter here. The filter is expanded unless they
+    /// fit, so the merges which might not fit must not run concurrently with the insertions
+    void merge(cqf &other, unsigned nthreads = 1) {
+        while (!fits(other))
+            expand(nthreads);
         merge(&qf_, &other.qf_);
         other.clear();
     }
@@ -69,8 +119,13 @@ class cqf {
         insertions_ = 0;
     }
 
+    /// The insertions are refused since then
     bool full() const {
-        return occupied_slots() >= uint64_t(0.95 * double(slots()));
+        return occupied_slots() >= capacity();
+    }
+
+    bool almost_full() const {
+        return occupied_slots() >= uint64_t(0.9 * double(slots()));
     }
 
     size_t insertions() const { return insertions_; }
@@ -84,7 +139,38 @@ class cqf {
         return qf_count_key_value(&qf_, d & range_mask_, 0, lock);
     }
 
+    template<class Writer>
+    void serialize(Writer &os) const {
+        os.write((char*)&num_hash_bits_, sizeof(num_hash_bits_));
+        os.write((char*)&num_slots_, sizeof(num_slots_));
+        os.write((char*)&insertions_, sizeof(insertions_));
+        os.write((char*)qf_.metadata, sizeof(*qf_.metadata));
+        os.write((char*)qf_.blocks, qf_.metadata->size);
+    }
+
+    template<class Reader>
+    void deserialize(Reader &is) {
+        is.read((char*)&num_hash_bits_, sizeof(num_hash_bits_));
+        is.read((char*)&num_slots_, sizeof(num_slots_));
+        is.read((char*)&insertions_, sizeof(insertions_));
+
+        // Same geometry as the serialized filter, so the metadata and
+        // blocks could be read over the fresh one
+        qf_destroy(&qf_);
+        qf_init(&qf_, num_slots_, num_hash_bits_, 0, 239);
+        uint64_t size = qf_.metadata->size;
+        is.read((char*)qf_.metadata, sizeof(*qf_.metadata));
+        VERIFY_MSG(size == qf_.metadata->size, "The saved CQF is corrupted: " <<
+                   qf_.metadata->size << " bytes of blocks, expected " << size);
+        is.read((char*)qf_.blocks, size);
+        range_mask_ = qf_.metadata->range - 1;
+    }
+
 private:
+    uint64_t capacity() const {
+        return uint64_t(0.95 * double(slots()));
+    }
+
     void merge(QF *qf, QF *other) {
         QFi other_cfi;
 
@@ -104,7 +190,7 @@ private:
     uint64_t range_mask_;
 };
 
-template<class T>
+template<class T, class Hasher = std::function<cqf::digest(const T&)>>
 class cqf_with_hasher : public cqf {
   public:
     using cqf::digest;
@@ -112,13 +198,13 @@ class cqf_with_hasher : public cqf {
     using cqf::lookup;
 
     /// The hash function type.
-    typedef std::function<digest(const T&)> hasher;
+    typedef Hasher hasher;
 
-    cqf_with_hasher(uint64_t maxn, hasher h = nullptr)
+    cqf_with_hasher(uint64_t maxn, hasher h = hasher())
             : cqf(maxn), hasher_(std::move(h)) {}
 
-    cqf_with_hasher(uint64_t num_slots, unsigned hash_bits, hasher h = nullptr)
-            : hasher_(std::move(h)), cqf(num_slots, hash_bits) {}
+    cqf_with_hasher(uint64_t num_slots, unsigned hash_bits, hasher h = hasher())
+            : cqf(num_slots, hash_bits), hasher_(std::move(h)) {}
 
     void replace_hasher(hasher h) {
         hasher_ = std::move(h);
@@ -1,16 +1,149 @@
 #pragma once
 
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/verify.hpp"
+
+#include <algorithm>
 #include <vector>
 #include <functional>
 #include <numeric>
 #include <cmath>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define HLL_X86 1
+#include <immintrin.h>
+#endif
 
 namespace hll {
 
+namespace impl {
+
+// The register values are at most 64
+struct InversePowers {
+    double v[65];
+
+    InversePowers() {
+        for (unsigned r = 0; r < 65; ++r)
+            v[r] = std::ldexp(1.0, -int(r));
+    }
+};
+
+// 2^-r
+inline const double *inverse_powers() {
+    static const InversePowers table;
+    return table.v;
+}
+
+// The registers are summed in 16 lanes, the lanes are added in a fixed order,
+// so all the variants give exactly the same sum. n must be a multiple of 16
+inline double ReduceLanes(const double *lanes) {
+    double res = 0;
+    for (size_t i = 0; i < 16; ++i)
+        res += lanes[i];
+    return res;
+}
+
+inline void MergeScalar(uint8_t *dst, const uint8_t *src, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = std::max(dst[i], src[i]);
+}
+
+// The sum of 2^-r over the registers and the number of the zero ones
+inline double HarmonicSumScalar(const uint8_t *regs, size_t n, size_t &zeros) {
+    const double *table = inverse_powers();
+    double lanes[16] = {};
+    zeros = 0;
+    for (size_t i = 0; i < n; i += 16) {
+        for (size_t j = 0; j < 16; ++j) {
+            lanes[j] += table[regs[i + j]];
+            zeros += regs[i + j] == 0;
+        }
+    }
+    return ReduceLanes(lanes);
+}
+
+#ifdef HLL_X86
+
+__attribute__((target("avx2")))
+inline void MergeAVX2(uint8_t *dst, const uint8_t *src, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_max_epu8(a, b));
+    }
+    MergeScalar(dst + i, src + i, n - i);
+}
+
+// The powers are gathered from the table, four registers per 256-bit lane
+__attribute__((target("avx2")))
+inline double HarmonicSumAVX2(const uint8_t *regs, size_t n, size_t &zeros) {
+    const double *table = inverse_powers();
+    __m256d acc[4] = { _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd() };
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    zeros = 0;
+    for (size_t i = 0; i < n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(regs + i));
+        zeros += __builtin_popcount(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()))));
+        for (int j = 0; j < 4; ++j) {
+            __m128i idx = _mm_cvtepu8_epi32(v);
+            acc[j] = _mm256_add_pd(acc[j], _mm256_mask_i32gather_pd(_mm256_setzero_pd(), table, idx, all, 8));
+            v = _mm_srli_si128(v, 4);
+        }
+    }
+
+    double lanes[16];
+    for (int j = 0; j < 4; ++j)
+        _mm256_storeu_pd(lanes + 4 * j, acc[j]);
+    return ReduceLanes(lanes);
+}
+
+#endif
+
+inline bool HasAVX2() {
+#ifdef HLL_X86
+    static const bool res = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return res;
+#else
+    return false;
+#endif
+}
+
+inline void Merge(uint8_t *dst, const uint8_t *src, size_t n) {
+#ifdef HLL_X86
+    if (HasAVX2())
+        return MergeAVX2(dst, src, n);
+#endif
+    MergeScalar(dst, src, n);
+}
+
+inline double HarmonicSum(const uint8_t *regs, size_t n, size_t &zeros) {
+#ifdef HLL_X86
+    if (HasAVX2())
+        return HarmonicSumAVX2(regs, n, zeros);
+#endif
+    return HarmonicSumScalar(regs, n, zeros);
+}
+
+}
+
+/*
+ * HyperLogLog with 2^precision registers. The sketch starts sparse: the
+ * (register, value) pairs are kept in a vector, which is compacted once in a
+ * while, and is upgraded to the dense registers when the pairs take a quarter
+ * of their memory. So the per-thread sketches of the small inputs cost next to
+ * nothing. The estimate does not depend on the representation.
+ */
 template<unsigned precision = 24>
 class hll {
+    static_assert(precision >= 4 && precision <= 24, "Precision must be within [4, 24]");
+
     static constexpr uint64_t m_ = 1ull << precision;
     static constexpr uint64_t mask_ = (m_ - 1) << (64 - precision);
+    // The sparse pairs are packed as register << 8 | value
+    static constexpr size_t sparse_max_ = m_ / 16;
+    static constexpr size_t sparse_min_buffer_ = 1024;
 
     constexpr double alpha(unsigned p) const {
       // constexpr switches are C++14 only :(
@@ -24,30 +157,57 @@ public:
     typedef uint64_t digest;
 
     hll()
-      : data_(1ull << precision, 0) { }
+      : sorted_(0) { }
 
     void add(digest d) {
       // Split digest into parts
-      size_t id = (d & mask_) >> (64 - precision);
+      uint32_t id = uint32_t((d & mask_) >> (64 - precision));
       uint8_t rho = uint8_t(((d & ~mask_) == 0 ? 64 : __builtin_clzll(d & ~mask_)) - precision + 1);
-      if (data_[id] < rho)
-        data_[id] = rho;
+      if (dense()) {
+        if (data_[id] < rho)
+          data_[id] = rho;
+        return;
+      }
+
+      sparse_.push_back(id << 8 | rho);
+      if (sparse_.size() >= std::max(size_t(sparse_min_buffer_), 2 * sorted_))
+        compact();
     }
 
     void merge(const hll &other) {
-      VERIFY(data_.size() == other.data_.size());
-      for (size_t i = 0; i < data_.size(); ++i)
-        data_[i] = std::max(data_[i], other.data_[i]);
+      if (other.dense()) {
+        make_dense();
+        impl::Merge(data_.data(), other.data_.data(), data_.size());
+        return;
+      }
+
+      if (dense()) {
+        for (uint32_t pair : other.sparse_)
+          data_[pair >> 8] = std::max(data_[pair >> 8], uint8_t(pair));
+        return;
+      }
+
+      sparse_.insert(sparse_.end(), other.sparse_.begin(), other.sparse_.end());
+      compact();
     }
 
     double cardinality() const {
-      // FIXME: Precision loss?
+      double E;
+      size_t zeros_bucket_cnt;
+      if (dense()) {
+        E = impl::HarmonicSum(data_.data(), data_.size(), zeros_bucket_cnt);
+      } else {
+        std::vector<uint32_t> pairs(sparse_);
+        Compact(pairs);
+        const double *table = impl::inverse_powers();
+        zeros_bucket_cnt = m_ - pairs.size();
+        E = double(zeros_bucket_cnt);
+        for (uint32_t pair : pairs)
+          E += table[uint8_t(pair)];
+      }
+
       // FIXME: Bias correction!
       double res = alpha(precision) * m_ * m_;
-      double E = std::accumulate(data_.begin(), data_.end(),
-                                 0.0, [](double a, uint8_t b) { return a + exp2(-(double) b); });
-      uint64_t zeros_bucket_cnt = std::accumulate(data_.begin(), data_.end(), 0,
-          [](uint64_t a, uint8_t b) {return a + (b == 0);});
       res /= E;
       if (res <= 5.0 * m_/2 && zeros_bucket_cnt > 0) {
           return m_ * (std::log((double)m_) - std::log((double)zeros_bucket_cnt));
@@ -60,19 +220,75 @@ public:
         return 1.1 * cardinality();
     }
 
+    /// Returns to the empty sparse sketch and frees the registers.
     void clear() {
-      std::fill(data_.begin(), data_.end(), 0);
+      std::vector<uint8_t>().swap(data_);
+      std::vector<uint32_t>().swap(sparse_);
+      sorted_ = 0;
+    }
+
+    bool dense() const {
+      return !data_.empty();
     }
 
     template <typename Archive>
     void BinArchive(Archive &ar) {
+        make_dense();
         ar(data_);
     }
 
 private:
+    // Sorts the pairs and keeps the largest value of every register
+    static void Compact(std::vector<uint32_t> &pairs) {
+      std::sort(pairs.begin(), pairs.end());
+      auto last = pairs.begin();
+      for (auto it = pairs.begin(); it != pairs.end(); ++it) {
+        if (last != pairs.begin() && (*(last - 1) >> 8) == (*it >> 8))
+          *(last - 1) = *it;
+        else
+          *last++ = *it;
+      }
+      pairs.erase(last, pairs.end());
+    }
+
+    void compact() {
+      Compact(sparse_);
+      sorted_ = sparse_.size();
+      if (sorted_ > sparse_max_)
+        make_dense();
+    }
+
+    void make_dense() {
+      if (dense())
+        return;
+
+      data_.assign(m_, 0);
+      for (uint32_t pair : sparse_)
+        data_[pair >> 8] = std::max(data_[pair >> 8], uint8_t(pair));
+      std::vector<uint32_t>().swap(sparse_);
+      sorted_ = 0;
+    }
+
     std::vector<uint8_t> data_;
+    std::vector<uint32_t> sparse_;
+    size_t sorted_;
 };
 
+/// Merges all the sketches into the first one by the parallel pairwise
+/// rounds, the others are cleared.
+template<class HLL>
+void tree_merge(std::vector<HLL> &hlls, unsigned nthreads) {
+    size_t count = hlls.size();
+    for (size_t step = 1; step < count; step *= 2) {
+        size_t end = count - step;
+        #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+        for (size_t i = 0; i < end; i += 2 * step) {
+            hlls[i].merge(hlls[i + step]);
+            hlls[i + step].clear();
+        }
+    }
+}
+
 template<class T, unsigned precision = 24>
 class hll_with_hasher : public hll<precision> {
 public:
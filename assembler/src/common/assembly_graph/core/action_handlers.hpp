@@ -10,6 +10,7 @@
 
 #include "utils/verify.hpp"
 #include "utils/logger/logger.hpp"
+#include "adt/iterator_range.hpp"
 
 #include <boost/noncopyable.hpp>
 #include <string>
@@ -17,6 +18,9 @@
 
 namespace omnigraph {
 
+template<typename VertexId, typename EdgeId>
+class ActionLog;
+
 /**
 * ActionHandler is base listening class for graph events. All structures and information storages
 * which are meant to synchronize with graph should use this structure. In order to make handler listen
@@ -119,6 +123,24 @@ public:
     virtual void HandleSplit(EdgeId /*old_edge*/, EdgeId /*new_edge_1*/,
                              EdgeId /*new_edge_2*/) { }
 
+    /**
+     * Handlers which are not queried while the graph is edited inside a batch (see ObservableGraph::BatchScope)
+     * should override this method. They receive the events of the batch together when it is committed.
+     */
+    virtual bool IsDeferrable() const {
+        return false;
+    }
+
+    /**
+     * Event which is triggered for deferrable handlers when the batch of graph edits is committed. The vertices
+     * and edges removed within the batch are still accessible at this moment. By default the events of the
+     * batch are replayed one by one in the order they happened.
+     * @param log events of the batch
+     */
+    virtual void HandleBatch(const ActionLog<VertexId, EdgeId> &log) {
+        log.Replay(*this);
+    }
+
     /**
      * Every thread safe descendant should override this method for correct concurrent graph processing.
      */
@@ -141,6 +163,118 @@ public:
     }
 };
 
+/**
+* ActionLog records the events of the batch of graph edits for the deferrable handlers. It is filled by the
+* graph through its HandlerApplier, so the events for the conjugate vertices and edges are listed as well.
+*/
+template<typename VertexId, typename EdgeId>
+class ActionLog : public ActionHandler<VertexId, EdgeId> {
+    typedef ActionHandler<VertexId, EdgeId> Handler;
+
+public:
+    enum class Kind : uint8_t { AddVertex, AddEdge, DeleteVertex, DeleteEdge, Merge, Glue, Split };
+
+    struct Event {
+        Kind kind;
+        // Range of the old edges of the merge in paths_
+        uint32_t path_begin, path_end;
+        VertexId vertex;
+        // The edge which is added or deleted, the new edge of the merge and the glue, the old edge of the split
+        EdgeId edge;
+        // The glued edges, the new edges of the split
+        EdgeId edge1, edge2;
+    };
+
+    typedef typename std::vector<Event>::const_iterator const_iterator;
+
+    ActionLog()
+            : Handler("ActionLog") {}
+
+    void HandleAdd(VertexId v) override {
+        events_.push_back({ Kind::AddVertex, 0, 0, v, EdgeId(), EdgeId(), EdgeId() });
+    }
+
+    void HandleAdd(EdgeId e) override {
+        events_.push_back({ Kind::AddEdge, 0, 0, VertexId(), e, EdgeId(), EdgeId() });
+    }
+
+    void HandleDelete(VertexId v) override {
+        events_.push_back({ Kind::DeleteVertex, 0, 0, v, EdgeId(), EdgeId(), EdgeId() });
+    }
+
+    void HandleDelete(EdgeId e) override {
+        events_.push_back({ Kind::DeleteEdge, 0, 0, VertexId(), e, EdgeId(), EdgeId() });
+    }
+
+    void HandleMerge(const std::vector<EdgeId> &old_edges, EdgeId new_edge) override {
+        uint32_t begin = (uint32_t) paths_.size();
+        paths_.insert(paths_.end(), old_edges.begin(), old_edges.end());
+        events_.push_back({ Kind::Merge, begin, (uint32_t) paths_.size(), VertexId(), new_edge, EdgeId(), EdgeId() });
+    }
+
+    void HandleGlue(EdgeId new_edge, EdgeId edge1, EdgeId edge2) override {
+        events_.push_back({ Kind::Glue, 0, 0, VertexId(), new_edge, edge1, edge2 });
+    }
+
+    void HandleSplit(EdgeId old_edge, EdgeId new_edge_1, EdgeId new_edge_2) override {
+        events_.push_back({ Kind::Split, 0, 0, VertexId(), old_edge, new_edge_1, new_edge_2 });
+    }
+
+    /**
+     * Old edges of the merge event
+     */
+    adt::iterator_range<typename std::vector<EdgeId>::const_iterator> path(const Event &event) const {
+        return adt::make_range(paths_.begin() + event.path_begin, paths_.begin() + event.path_end);
+    }
+
+    /**
+     * Triggers the events in the handler one by one
+     */
+    void Replay(Handler &handler) const {
+        std::vector<EdgeId> old_edges;
+        for (const Event &event : events_) {
+            switch (event.kind) {
+                case Kind::AddVertex:
+                    handler.HandleAdd(event.vertex);
+                    break;
+                case Kind::AddEdge:
+                    handler.HandleAdd(event.edge);
+                    break;
+                case Kind::DeleteVertex:
+                    handler.HandleDelete(event.vertex);
+                    break;
+                case Kind::DeleteEdge:
+                    handler.HandleDelete(event.edge);
+                    break;
+                case Kind::Merge:
+                    old_edges.assign(paths_.begin() + event.path_begin, paths_.begin() + event.path_end);
+                    handler.HandleMerge(old_edges, event.edge);
+                    break;
+                case Kind::Glue:
+                    handler.HandleGlue(event.edge, event.edge1, event.edge2);
+                    break;
+                case Kind::Split:
+                    handler.HandleSplit(event.edge, event.edge1, event.edge2);
+                    break;
+            }
+        }
+    }
+
+    const_iterator begin() const { return events_.begin(); }
+    const_iterator end() const { return events_.end(); }
+    size_t size() const { return events_.size(); }
+    bool empty() const { return events_.empty(); }
+
+    void clear() {
+        events_.clear();
+        paths_.clear();
+    }
+
+private:
+    std::vector<Event> events_;
+    std::vector<EdgeId> paths_;
+};
+
 template<class Graph>
 class GraphActionHandler : public ActionHandler<typename Graph::VertexId,
         typename Graph::EdgeId> {
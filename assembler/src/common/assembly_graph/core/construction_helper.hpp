@@ -80,6 +80,21 @@ public:
         return graph_.AddEdge(data, id, cid);
     }
 
+    // Same as AddEdge, but the handlers are not notified. The edge is self-conjugate iff
+    // id == cid: a palindromic edge between the non-conjugate vertices has the separate conjugate
+    EdgeId CreateEdge(const EdgeData &data, EdgeId id, EdgeId cid) {
+        EdgeId e = graph_.AddSingleEdge(VertexId(), VertexId(), data, id);
+        if (id == cid) {
+            graph_.edge(e).set_conjugate(e);
+            return e;
+        }
+
+        EdgeId rc = graph_.AddSingleEdge(VertexId(), VertexId(), graph_.master().conjugate(data), cid);
+        graph_.edge(e).set_conjugate(rc);
+        graph_.edge(rc).set_conjugate(e);
+        return e;
+    }
+
     void LinkIncomingEdge(VertexId v, EdgeId e) {
         VERIFY(graph_.EdgeEnd(e) == VertexId());
         graph_.cvertex(v).AddOutgoingEdge(graph_.conjugate(e));
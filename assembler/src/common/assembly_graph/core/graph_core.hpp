@@ -647,14 +647,23 @@ protected:
         return result;
     }
 
-    void HiddenDeleteEdge(EdgeId e) {
-        TRACE("Hidden delete edge " << e.int_id());
+    // Unlinks the edge and its conjugate from their start vertices, the data are kept till HiddenDestroyEdge
+    void HiddenDetachEdge(EdgeId e) {
         EdgeId rcEdge = conjugate(e);
         VertexId rcStart = conjugate(edge(e).end());
         VertexId start = conjugate(edge(rcEdge).end());
         vertex(start).RemoveOutgoingEdge(e);
         vertex(rcStart).RemoveOutgoingEdge(rcEdge);
-        DestroyEdge(e, rcEdge);
+    }
+
+    void HiddenDestroyEdge(EdgeId e) {
+        DestroyEdge(e, conjugate(e));
+    }
+
+    void HiddenDeleteEdge(EdgeId e) {
+        TRACE("Hidden delete edge " << e.int_id());
+        HiddenDetachEdge(e);
+        HiddenDestroyEdge(e);
     }
 
     void HiddenDeletePath(const std::vector<EdgeId>& edgesToDelete,
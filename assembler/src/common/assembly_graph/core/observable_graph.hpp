@@ -34,12 +34,54 @@ public:
     typedef SmartEdgeIterator<ObservableGraph> SmartEdgeIt;
     typedef ConstEdgeIterator<ObservableGraph> ConstEdgeIt;
     typedef ActionHandler<VertexId, EdgeId> Handler;
+    typedef ActionLog<VertexId, EdgeId> Log;
+
+    /**
+     * Edits made while the scope is alive form a batch. Deferrable handlers receive its events at once when
+     * the outermost scope is destroyed, the other handlers are notified immediately. The removed vertices and
+     * edges are unlinked from the graph, but stay in the storage till the commit, so the iteration over all the
+     * graph elements still visits them. Use smart iterators inside the batch.
+     */
+    class BatchScope {
+    public:
+        BatchScope(ObservableGraph &g)
+                : g_(g) {
+            g_.BeginBatch();
+        }
+
+        BatchScope(const BatchScope&) = delete;
+        BatchScope& operator=(const BatchScope&) = delete;
+
+        ~BatchScope() {
+            g_.CommitBatch();
+        }
+
+    private:
+        ObservableGraph &g_;
+    };
 
 private:
    //todo switch to smart iterators
    mutable std::vector<Handler*> action_handler_list_;
    std::unique_ptr<const HandlerApplier<VertexId, EdgeId>> applier_;
 
+   size_t batch_depth_;
+   mutable Log log_;
+   std::vector<EdgeId> removed_edges_;
+   std::vector<VertexId> removed_vertices_;
+
+   bool Deferred(const Handler *handler) const {
+       return batch_depth_ && handler->IsDeferrable();
+   }
+
+   void BeginBatch();
+
+   void CommitBatch();
+
+   void RemoveEdge(EdgeId e);
+
+   void RemoveVertex(VertexId v);
+
 public:
 //todo move to graph core
     typedef ConstructionHelper<DataMaster> HelperT;
@@ -82,6 +124,10 @@ public:
 
     bool VerifyAllDetached();
 
+    bool InBatch() const {
+        return batch_depth_;
+    }
+
     //smart iterators
     template<typename Priority>
     SmartVertexIterator<ObservableGraph, Priority> SmartVertexBegin(
@@ -110,7 +156,7 @@ public:
     void FireDeletePath(const std::vector<EdgeId>& edges_to_delete, const std::vector<VertexId>& vertices_to_delete) const;
 
     ObservableGraph(const DataMaster& master) :
-            base(master), applier_(new PairedHandlerApplier<ObservableGraph>(*this)) {
+            base(master), applier_(new PairedHandlerApplier<ObservableGraph>(*this)), batch_depth_(0) {
     }
 
     virtual ~ObservableGraph();
@@ -171,7 +217,7 @@ void ObservableGraph<DataMaster>::DeleteVertex(VertexId v) {
     VERIFY(base::IsDeadEnd(v) && base::IsDeadStart(v));
     VERIFY(v != VertexId());
     FireDeleteVertex(v);
-    base::HiddenDeleteVertex(v);
+    RemoveVertex(v);
 }
 
 template<class DataMaster>
@@ -201,7 +247,7 @@ ObservableGraph<DataMaster>::AddEdge(const EdgeData& data, EdgeId id1, EdgeId id
 template<class DataMaster>
 void ObservableGraph<DataMaster>::DeleteEdge(EdgeId e) {
     FireDeleteEdge(e);
-    base::HiddenDeleteEdge(e);
+    RemoveEdge(e);
 }
 
 template<class DataMaster>
@@ -321,69 +367,166 @@ void ObservableGraph<DataMaster>::FireGameOver() const {
     }
 }
 
+// The events for the deferrable handlers are recorded once per batch edit, see BatchScope
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireAddVertex(VertexId v) const {
+    bool record = false;
     for (Handler* handler_ptr : action_handler_list_) {
         if (handler_ptr->IsAttached()) {
+            if (Deferred(handler_ptr)) {
+                record = true;
+                continue;
+            }
             TRACE("FireAddVertex to handler " << handler_ptr->name());
             applier_->ApplyAdd(*handler_ptr, v);
         }
     }
+    if (record)
+        applier_->ApplyAdd(log_, v);
 }
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireAddEdge(EdgeId e) const {
+    bool record = false;
     for (Handler* handler_ptr : action_handler_list_) {
         if (handler_ptr->IsAttached()) {
+            if (Deferred(handler_ptr)) {
+                record = true;
+                continue;
+            }
             TRACE("FireAddEdge to handler " << handler_ptr->name());
             applier_->ApplyAdd(*handler_ptr, e);
         }
     }
+    if (record)
+        applier_->ApplyAdd(log_, e);
 }
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireDeleteVertex(VertexId v) const {
+    bool record = false;
     for (auto it = action_handler_list_.rbegin(); it != action_handler_list_.rend(); ++it) {
         if ((*it)->IsAttached()) {
+            if (Deferred(*it)) {
+                record = true;
+                continue;
+            }
             applier_->ApplyDelete(**it, v);
         }
     }
+    if (record)
+        applier_->ApplyDelete(log_, v);
 }
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireDeleteEdge(EdgeId e) const {
+    bool record = false;
     for (auto it = action_handler_list_.rbegin(); it != action_handler_list_.rend(); ++it) {
         if ((*it)->IsAttached()) {
+            if (Deferred(*it)) {
+                record = true;
+                continue;
+            }
             applier_->ApplyDelete(**it, e);
         }
-    };
+    }
+    if (record)
+        applier_->ApplyDelete(log_, e);
 }
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireMerge(const std::vector<EdgeId> &old_edges, EdgeId new_edge) const {
+    bool record = false;
     for (Handler* handler_ptr : action_handler_list_) {
         if (handler_ptr->IsAttached()) {
+            if (Deferred(handler_ptr)) {
+                record = true;
+                continue;
+            }
             applier_->ApplyMerge(*handler_ptr, old_edges, new_edge);
         }
     }
+    if (record)
+        applier_->ApplyMerge(log_, old_edges, new_edge);
 }
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireGlue(EdgeId new_edge, EdgeId edge1, EdgeId edge2) const {
+    bool record = false;
     for (Handler* handler_ptr : action_handler_list_) {
         if (handler_ptr->IsAttached()) {
+            if (Deferred(handler_ptr)) {
+                record = true;
+                continue;
+            }
             applier_->ApplyGlue(*handler_ptr, new_edge, edge1, edge2);
         }
-    };
+    }
+    if (record)
+        applier_->ApplyGlue(log_, new_edge, edge1, edge2);
 }
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireSplit(EdgeId edge, EdgeId new_edge1, EdgeId new_edge2) const {
+    bool record = false;
     for (Handler* handler_ptr : action_handler_list_) {
         if (handler_ptr->IsAttached()) {
+            if (Deferred(handler_ptr)) {
+                record = true;
+                continue;
+            }
             applier_->ApplySplit(*handler_ptr, edge, new_edge1, new_edge2);
         }
     }
+    if (record)
+        applier_->ApplySplit(log_, edge, new_edge1, new_edge2);
+}
+
+template<class DataMaster>
+void ObservableGraph<DataMaster>::BeginBatch() {
+    batch_depth_ += 1;
+}
+
+template<class DataMaster>
+void ObservableGraph<DataMaster>::CommitBatch() {
+    VERIFY(batch_depth_ > 0);
+    if (--batch_depth_)
+        return;
+
+    if (!log_.empty()) {
+        TRACE("Committing batch of " << log_.size() << " events");
+        for (Handler* handler_ptr : action_handler_list_) {
+            if (handler_ptr->IsAttached() && handler_ptr->IsDeferrable())
+                handler_ptr->HandleBatch(log_);
+        }
+        log_.clear();
+    }
+
+    for (EdgeId e : removed_edges_)
+        base::HiddenDestroyEdge(e);
+    for (VertexId v : removed_vertices_)
+        base::HiddenDeleteVertex(v);
+    removed_edges_.clear();
+    removed_vertices_.clear();
+}
+
+template<class DataMaster>
+void ObservableGraph<DataMaster>::RemoveEdge(EdgeId e) {
+    if (!batch_depth_) {
+        base::HiddenDeleteEdge(e);
+        return;
+    }
+    base::HiddenDetachEdge(e);
+    removed_edges_.push_back(e);
+}
+
+template<class DataMaster>
+void ObservableGraph<DataMaster>::RemoveVertex(VertexId v) {
+    if (!batch_depth_) {
+        base::HiddenDeleteVertex(v);
+        return;
+    }
+    removed_vertices_.push_back(v);
 }
 
 template<class DataMaster>
@@ -407,6 +550,7 @@ void ObservableGraph<DataMaster>::FireDeletePath(const std::vector<EdgeId> &edge
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::clear() {
+    VERIFY(!batch_depth_);
     for (VertexId v : base::vertices())
         ForceDeleteVertex(v);
 }
@@ -467,7 +611,10 @@ typename ObservableGraph<DataMaster>::EdgeId
     auto vertices_to_delete = VerticesToDelete(corrected_path);
     FireDeletePath(edges_to_delete, vertices_to_delete);
     FireAddEdge(new_edge);
-    base::HiddenDeletePath(edges_to_delete, vertices_to_delete);
+    for (EdgeId e : edges_to_delete)
+        RemoveEdge(e);
+    for (VertexId v : vertices_to_delete)
+        RemoveVertex(v);
     return new_edge;
 }
 
@@ -487,7 +634,7 @@ std::pair<typename ObservableGraph<DataMaster>::EdgeId, typename ObservableGraph
     FireAddVertex(splitVertex);
     FireAddEdge(new_edge1);
     FireAddEdge(new_edge2);
-    base::HiddenDeleteEdge(edge);
+    RemoveEdge(edge);
     return {new_edge1, new_edge2};
 }
 
@@ -500,8 +647,8 @@ typename ObservableGraph<DataMaster>::EdgeId ObservableGraph<DataMaster>::GlueEd
     FireAddEdge(new_edge);
     VertexId start = base::EdgeStart(edge1);
     VertexId end = base::EdgeEnd(edge1);
-    base::HiddenDeleteEdge(edge1);
-    base::HiddenDeleteEdge(edge2);
+    RemoveEdge(edge1);
+    RemoveEdge(edge2);
 
     if (base::IsDeadStart(start) && base::IsDeadEnd(start)) {
         DeleteVertex(start);
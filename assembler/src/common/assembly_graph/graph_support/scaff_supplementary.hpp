@@ -49,6 +49,10 @@ public:
         return unique_edges_.erase(iter);
     }
 
+    void insert(EdgeId e) {
+        unique_edges_.insert(e);
+    }
+
     size_t size() const noexcept {
         return unique_edges_.size();
     }
@@ -113,10 +117,16 @@ public:
 };
 
 class UsedUniqueStorage {
+public:
+    typedef std::unordered_map<size_t, std::unordered_set<EdgeId>> PathEdges;
+
+private:
     std::unordered_set<EdgeId> used_;
-    std::unordered_map<size_t, std::unordered_set<EdgeId>> used_by_paths_; // for fast check 'whether the path contains the edge'
+    PathEdges used_by_paths_; // for fast check 'whether the path contains the edge'
     const ScaffoldingUniqueEdgeStorage& unique_;
     const debruijn_graph::ConjugateDeBruijnGraph &g_;
+    // Read-only storage the current one is laid over, see Overlay()
+    const UsedUniqueStorage *base_;
 
 public:
     UsedUniqueStorage(const UsedUniqueStorage&) = delete;
@@ -128,8 +138,18 @@ public:
                                const debruijn_graph::ConjugateDeBruijnGraph &g)
         : unique_(unique)
         , g_(g) 
+        , base_(nullptr)
     {}
 
+    // Creates an empty storage laid over the base one: edges used in base
+    // storage are reported as used, while the new marks are kept only here.
+    // Base storage must not be changed while the overlay is in use.
+    static UsedUniqueStorage Overlay(const UsedUniqueStorage &base) {
+        UsedUniqueStorage res(base.unique_, base.g_);
+        res.base_ = &base;
+        return res;
+    }
+
     void insert(EdgeId e, size_t path_id) {
         if (!unique_.IsUnique(e))
             return;
@@ -140,12 +160,41 @@ public:
         used_by_paths_[path_id].insert(g_.conjugate(e));
     }
 
+    // Takes away all the marks made in this storage
+    PathEdges TakeMarks() {
+        PathEdges res;
+        std::swap(res, used_by_paths_);
+        used_.clear();
+        return res;
+    }
+
+    // Adds the marks taken from another storage, path ids are translated
+    // with the provided function
+    template<class IdMapping>
+    void AddMarks(const PathEdges &marks, const IdMapping &path_id) {
+        for (const auto &entry : marks) {
+            auto &path_used = used_by_paths_[path_id(entry.first)];
+            for (EdgeId e : entry.second) {
+                used_.insert(e);
+                path_used.insert(e);
+            }
+        }
+    }
+
     bool IsUsed(EdgeId e, size_t path_id) const {
+        SpeculationLog::Read(e);
+        if (base_ && base_->IsUsed(e, path_id))
+            return true;
+
         auto it = used_by_paths_.find(path_id);
         return it != used_by_paths_.end() && it->second.find(e) != it->second.end();
     }
 
     bool IsUsed(EdgeId e) const {
+        SpeculationLog::Read(e);
+        if (base_ && base_->IsUsed(e))
+            return true;
+
         return used_.find(e) != used_.end();
     }
 
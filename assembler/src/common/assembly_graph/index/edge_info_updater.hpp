@@ -14,6 +14,9 @@
 
 #include "utils/parallel/openmp_wrapper.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace debruijn_graph {
 
 template<typename Graph>
@@ -91,6 +94,26 @@ class EdgeInfoUpdater {
         }
     }
 
+    template<class Index>
+    void Delete(const Graph &g, Index &index, const std::vector<EdgeId> &edges) {
+        // The k-mers of an edge and of its conjugate share the index entries, so
+        // only one edge of a conjugate pair is processed, it clears both strands
+        std::vector<EdgeId> sorted(edges);
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+        std::vector<EdgeId> to_delete;
+        for (EdgeId e : sorted) {
+            EdgeId conj = g.conjugate(e);
+            if (e <= conj || !std::binary_search(sorted.begin(), sorted.end(), conj))
+                to_delete.push_back(e);
+        }
+
+#pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < to_delete.size(); ++i) {
+            DeleteKmers(g, to_delete[i], index);
+        }
+    }
+
  private:
     DECL_LOGGER("EdgeInfoUpdater")
 };
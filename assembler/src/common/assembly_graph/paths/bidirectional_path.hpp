@@ -378,8 +378,11 @@ class BidirectionalPath : public PathListener, public SimpleBidirectionalPath {
 
     const debruijn_graph::Graph& g_;
     BidirectionalPath* conj_path_;
-    // Length from beginning of i-th edge to path end: L(e_i + gap_(i+1) + e_(i+1) + ... + gap_N + e_N)
-    std::deque<size_t> cumulative_len_;
+    // Start positions of the edges and the end position of the last one, counted from an
+    // arbitrary origin (modulo 2^64), so that the edges are added and removed at both ends
+    // in O(1). Length from beginning of i-th edge to path end is end_pos_ - start_pos_[i]
+    std::deque<size_t> start_pos_;
+    size_t end_pos_;
     adt::SmallPODVector<PathListener*,
                         adt::impl::HybridAllocatedStorage<PathListener*, 2>> listeners_;
     const uint64_t id_;  //Unique ID
@@ -389,6 +392,7 @@ class BidirectionalPath : public PathListener, public SimpleBidirectionalPath {
     BidirectionalPath(const debruijn_graph::Graph& g)
             : g_(g),
               conj_path_(nullptr),
+              end_pos_(0),
               id_(path_id_++),
               weight_(1.0),
               cycle_overlapping_(-1) {}
@@ -401,13 +405,8 @@ class BidirectionalPath : public PathListener, public SimpleBidirectionalPath {
     BidirectionalPath(const debruijn_graph::Graph& g, SimpleBidirectionalPath path)
             : BidirectionalPath(g)  {
         SimpleBidirectionalPath::PushBack(std::move(path));
-        cumulative_len_.resize(Size(), 0);
-
         for (size_t i = 0; i < Size(); ++i)
-            cumulative_len_.front() += g_.length(edges_[i]) + gaps_[i].gap;
-
-        for (size_t i = 1; i < Size(); ++i)
-            cumulative_len_[i] = cumulative_len_[i - 1] - g_.length(edges_[i - 1]) - gaps_[i].gap;
+            IncreaseLengths(g_.length(edges_[i]), gaps_[i].gap);
     }
 
     BidirectionalPath(const debruijn_graph::Graph& g, std::vector<EdgeId> path)
@@ -417,7 +416,8 @@ class BidirectionalPath : public PathListener, public SimpleBidirectionalPath {
             : SimpleBidirectionalPath(path),
               g_(path.g_),
               conj_path_(nullptr),
-              cumulative_len_(path.cumulative_len_),
+              start_pos_(path.start_pos_),
+              end_pos_(path.end_pos_),
               listeners_(),
               id_(path_id_++),
               weight_(path.weight_),
@@ -556,7 +556,7 @@ public:
             return 0;
         }
         VERIFY(gaps_[0].gap == 0);
-        return cumulative_len_[0];
+        return LengthAt(0);
     }
 
     int ShiftLength(size_t index) const {
@@ -565,7 +565,7 @@ public:
 
     // Length from beginning of i-th edge to path end for forward directed path: L(e1 + e2 + ... + eN)
     size_t LengthAt(size_t index) const noexcept {
-        return cumulative_len_[index];
+        return end_pos_ - start_pos_[index];
     }
 
     size_t GetId() const noexcept {
@@ -681,19 +681,13 @@ private:
     std::vector<std::string> PrintLines() const;
 
     void IncreaseLengths(size_t length, int gap) {
-        for (auto iter = cumulative_len_.begin(); iter != cumulative_len_.end(); ++iter) {
-            *iter += length + gap;
-        }
-        cumulative_len_.push_back(length);
+        start_pos_.push_back(end_pos_ + (size_t) gap);
+        end_pos_ = start_pos_.back() + length;
     }
 
     void DecreaseLengths() {
-        size_t length = g_.length(edges_.back()) + gaps_.back().gap;
-
-        for (auto iter = cumulative_len_.begin(); iter != cumulative_len_.end(); ++iter) {
-            *iter -= length;
-        }
-        cumulative_len_.pop_back();
+        end_pos_ = start_pos_.back() - (size_t) gaps_.back().gap;
+        start_pos_.pop_back();
     }
 
     void NotifyFrontEdgeAdded(EdgeId e, const Gap& gap) {
@@ -728,18 +722,18 @@ private:
 
         SimpleBidirectionalPath::PushFront(e, gap);
 
-        int length = (int) g_.length(e);
-        if (cumulative_len_.empty()) {
-            cumulative_len_.push_front(length);
+        size_t length = g_.length(e);
+        if (start_pos_.empty()) {
+            start_pos_.push_front(end_pos_ - length);
         } else {
-            cumulative_len_.push_front(cumulative_len_.front() + length + gap.gap);
+            start_pos_.push_front(start_pos_.front() - length - (size_t) gap.gap);
         }
         NotifyFrontEdgeAdded(e, gap);
     }
 
     void PopFront() {
         EdgeId e = edges_.front();
-        cumulative_len_.pop_front();
+        start_pos_.pop_front();
         SimpleBidirectionalPath::PopFront();
 
         NotifyFrontEdgeRemoved(e);
@@ -571,6 +571,10 @@ public:
         return !str_;
     }
 
+    std::ostream &stream() {
+        return str_;
+    }
+
 private:
     std::ostream &str_;
 };
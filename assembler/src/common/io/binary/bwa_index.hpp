@@ -0,0 +1,39 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "io_base.hpp"
+#include "modules/alignment/bwa_index.hpp"
+
+namespace io {
+
+namespace binary {
+
+class BWAIndexIO : public IOSingle<alignment::BWAIndexHolder> {
+public:
+    typedef alignment::BWAIndexHolder Type;
+    BWAIndexIO()
+            : IOSingle<Type>("bwa index", ".bwa") {
+    }
+
+    void SaveImpl(BinOStream &str, const Type &value) override {
+        str << value;
+    }
+
+    void LoadImpl(BinIStream &str, Type &value) override {
+        str >> value;
+    }
+};
+
+template<>
+struct IOTraits<alignment::BWAIndexHolder> {
+    typedef BWAIndexIO Type;
+};
+
+} // namespace binary
+
+} // namespace io
@@ -9,82 +9,282 @@
 #include "io_base.hpp"
 
 #include "assembly_graph/core/graph.hpp"
+#include "assembly_graph/core/construction_helper.hpp"
 #include "common/sequence/sequence.hpp"
+#include "io/kmers/mmapped_reader.hpp"
+#include "io/kmers/mmapped_writer.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/parallel/parallel_wrapper.hpp"
+
+#include <algorithm>
+#include <vector>
 
 namespace io {
 
 namespace binary {
 
+/**
+ * @brief  The graph is stored as a flat image of 64-bit words:
+ *         header, table of canonical vertices, table of canonical edges
+ *         and a blob of the packed edge sequences (each one starting at the word boundary).
+ *         All the records have fixed size, so the image is filled and consumed in parallel.
+ *         The file is written and read via the memory mapping, the streams get the same image.
+ */
 template<typename Graph>
 class GraphIO : public IOSingle<Graph> {
+    typedef typename Graph::VertexId VertexId;
+    typedef typename Graph::EdgeId EdgeId;
+    typedef seq_element_type Word;
+    static_assert(sizeof(Word) == sizeof(uint64_t), "Sequence must be packed into 64-bit words");
+
+    struct Header {
+        uint64_t vreserved, ereserved;
+        uint64_t vertex_cnt, edge_cnt;
+        uint64_t nucl_words;
+    };
+
+    struct VertexRecord {
+        uint64_t id, conjugate;
+    };
+
+    struct EdgeRecord {
+        uint64_t id, conjugate;
+        uint64_t start, end;
+        uint64_t seq_offset, seq_size;
+    };
+
+    // Canonical vertices and edges in the order of the image
+    struct Layout {
+        Header header;
+        std::vector<VertexId> vertices;
+        std::vector<EdgeId> edges;
+        std::vector<uint64_t> seq_offsets;
+
+        size_t words() const {
+            return (sizeof(Header) + header.vertex_cnt * sizeof(VertexRecord) +
+                    header.edge_cnt * sizeof(EdgeRecord)) / sizeof(Word) + header.nucl_words;
+        }
+    };
+
+    // Linking of the edge to the vertex, see Build()
+    struct LinkRecord {
+        uint64_t vertex;
+        uint64_t edge;
+        bool outgoing;
+
+        bool operator<(const LinkRecord &other) const {
+            return vertex < other.vertex;
+        }
+    };
+
+    // Records per chunk in the stream mode
+    static const size_t CHUNK_SIZE = 1 << 16;
+
 public:
     GraphIO()
             : IOSingle<Graph>("debruijn graph", ".grseq") {
     }
 
+    void Save(const std::string &basename, const Graph &graph) override {
+        std::string filename = basename + ".grseq";
+        DEBUG("Saving debruijn graph into " << filename);
+        Layout layout = CollectLayout(graph);
+
+        MMappedRecordWriter<Word> writer(filename);
+        writer.resize(layout.words());
+        Word *image = writer.data();
+
+        *reinterpret_cast<Header*>(image) = layout.header;
+        auto vrecs = reinterpret_cast<VertexRecord*>(image + sizeof(Header) / sizeof(Word));
+        FillVertices(graph, layout, vrecs, 0, layout.vertices.size());
+        auto erecs = reinterpret_cast<EdgeRecord*>(vrecs + layout.vertices.size());
+        FillEdges(graph, layout, erecs, 0, layout.edges.size());
+        FillNucls(graph, layout, reinterpret_cast<Word*>(erecs + layout.edges.size()), 0, layout.edges.size());
+    }
+
+    /**
+     * @return false if the file is empty, fails if it is missing.
+     */
+    bool Load(const std::string &basename, Graph &graph) override {
+        std::string filename = basename + ".grseq";
+        CHECK_FATAL_ERROR(fs::check_existence(filename), "File " << filename << " doesn't exist or can't be read");
+        MMappedRecordReader<Word> reader(filename, /* unlink */ false, /* blocksize */ -1ULL);
+        if (!reader.size())
+            return false;
+        DEBUG("Loading debruijn graph from " << filename);
+
+        VERIFY_MSG(reader.size() >= sizeof(Header) / sizeof(Word), "Truncated graph file " << filename);
+        const Word *image = reader.data();
+        const Header &header = *reinterpret_cast<const Header*>(image);
+        auto vrecs = reinterpret_cast<const VertexRecord*>(image + sizeof(Header) / sizeof(Word));
+        auto erecs = reinterpret_cast<const EdgeRecord*>(vrecs + header.vertex_cnt);
+        auto nucls = reinterpret_cast<const Word*>(erecs + header.edge_cnt);
+        VERIFY_MSG(size_t(nucls - image) + header.nucl_words == reader.size(), "Truncated graph file " << filename);
+
+        Build(graph, header, vrecs, erecs, nucls);
+        return true;
+    }
+
 private:
     void SaveImpl(BinOStream &str, const Graph &graph) override {
-        str << graph.vreserved() << graph.ereserved();
-
-        size_t vertex_cnt = graph.size();
-        str << vertex_cnt;
-
-        for (auto v1 : graph) {
-            str << v1.int_id() << graph.conjugate(v1).int_id();
-            for (auto e1 : graph.OutgoingEdges(v1)) {
-                auto e2 = graph.conjugate(e1);
-                if (e2 < e1)
-                    continue;
-                str << e1.int_id() << e2.int_id()
-                    << graph.EdgeEnd(e1).int_id() << graph.EdgeStart(e2).int_id()
-                    << graph.EdgeNucls(e1);
-            }
-            str << (size_t)0; //null-term
+        Layout layout = CollectLayout(graph);
+        std::ostream &os = str.stream();
+
+        os.write(reinterpret_cast<const char*>(&layout.header), sizeof(Header));
+        WriteChunked<VertexRecord>(os, layout.vertices.size(), [&](VertexRecord *dst, size_t from, size_t to) {
+            FillVertices(graph, layout, dst, from, to);
+        });
+        WriteChunked<EdgeRecord>(os, layout.edges.size(), [&](EdgeRecord *dst, size_t from, size_t to) {
+            FillEdges(graph, layout, dst, from, to);
+        });
+        std::vector<Word> nucls;
+        for (size_t from = 0; from < layout.edges.size(); from += CHUNK_SIZE) {
+            size_t to = std::min(layout.edges.size(), from + size_t(CHUNK_SIZE));
+            nucls.resize(layout.seq_offsets[to] - layout.seq_offsets[from]);
+            FillNucls(graph, layout, nucls.data(), from, to);
+            os.write(reinterpret_cast<const char*>(nucls.data()), nucls.size() * sizeof(Word));
         }
     }
 
     void LoadImpl(BinIStream &str, Graph &graph) override {
-        graph.clear();
+        std::istream &is = str.stream();
+
+        Header header;
+        is.read(reinterpret_cast<char*>(&header), sizeof(Header));
+        std::vector<VertexRecord> vrecs(header.vertex_cnt);
+        is.read(reinterpret_cast<char*>(vrecs.data()), vrecs.size() * sizeof(VertexRecord));
+        std::vector<EdgeRecord> erecs(header.edge_cnt);
+        is.read(reinterpret_cast<char*>(erecs.data()), erecs.size() * sizeof(EdgeRecord));
+        std::vector<Word> nucls(header.nucl_words);
+        is.read(reinterpret_cast<char*>(nucls.data()), nucls.size() * sizeof(Word));
+        VERIFY_MSG(is, "Failed to read debruijn graph");
 
-        uint64_t max_vid, max_eid;
-        str >> max_vid >> max_eid;
-        graph.reserve(max_vid, max_eid);
+        Build(graph, header, vrecs.data(), erecs.data(), nucls.data());
+    }
 
-        size_t vertex_cnt;
-        str >> vertex_cnt;
+    static Layout CollectLayout(const Graph &graph) {
+        Layout layout;
+        for (VertexId v : graph.canonical_vertices())
+            layout.vertices.push_back(v);
+        for (EdgeId e : graph.canonical_edges())
+            layout.edges.push_back(e);
 
-        auto TryAddVertex = [&](uint64_t ids[2]) {
-            if (graph.contains(typename Graph::VertexId(ids[0])))
-                return;
-            TRACE("Vertex " << ids[0] << " ~ " << ids[1] << " .");
-            auto new_id = graph.AddVertex(typename Graph::VertexData(), ids[0], ids[1]);
-            VERIFY(new_id == ids[0]);
-            VERIFY(graph.conjugate(new_id) == ids[1]);
-        };
+        layout.seq_offsets.resize(layout.edges.size() + 1);
+        layout.seq_offsets[0] = 0;
+        for (size_t i = 0; i < layout.edges.size(); ++i)
+            layout.seq_offsets[i + 1] = layout.seq_offsets[i] + Sequence::DataSize(graph.EdgeNucls(layout.edges[i]).size());
 
+        layout.header = { graph.vreserved(), graph.ereserved(),
+                          layout.vertices.size(), layout.edges.size(),
+                          layout.seq_offsets.back() };
+        return layout;
+    }
+
+    static void FillVertices(const Graph &graph, const Layout &layout,
+                             VertexRecord *dst, size_t from, size_t to) {
+#       pragma omp parallel for schedule(static)
+        for (size_t i = from; i < to; ++i) {
+            VertexId v = layout.vertices[i];
+            dst[i - from] = { v.int_id(), graph.conjugate(v).int_id() };
+        }
+    }
+
+    static void FillEdges(const Graph &graph, const Layout &layout,
+                          EdgeRecord *dst, size_t from, size_t to) {
+#       pragma omp parallel for schedule(static)
+        for (size_t i = from; i < to; ++i) {
+            EdgeId e = layout.edges[i];
+            dst[i - from] = { e.int_id(), graph.conjugate(e).int_id(),
+                              graph.EdgeStart(e).int_id(), graph.EdgeEnd(e).int_id(),
+                              layout.seq_offsets[i], graph.EdgeNucls(e).size() };
+        }
+    }
+
+    // Packs the sequences of edges [from, to) into dst, which corresponds to the offset of the first one
+    static void FillNucls(const Graph &graph, const Layout &layout,
+                          Word *dst, size_t from, size_t to) {
+#       pragma omp parallel for schedule(guided)
+        for (size_t i = from; i < to; ++i)
+            graph.EdgeNucls(layout.edges[i]).copy_data(dst + layout.seq_offsets[i] - layout.seq_offsets[from]);
+    }
+
+    // Writes count records chunk by chunk, fill(dst, from, to) is expected to fill the records [from, to)
+    template<typename T, typename F>
+    static void WriteChunked(std::ostream &os, size_t count, F fill) {
+        std::vector<T> chunk(std::min(count, size_t(CHUNK_SIZE)));
+        for (size_t from = 0; from < count; from += CHUNK_SIZE) {
+            size_t to = std::min(count, from + size_t(CHUNK_SIZE));
+            fill(chunk.data(), from, to);
+            os.write(reinterpret_cast<const char*>(chunk.data()), (to - from) * sizeof(T));
+        }
+    }
+
+    static void Build(Graph &graph, const Header &header,
+                      const VertexRecord *vrecs, const EdgeRecord *erecs, const Word *nucls) {
+        graph.clear();
+        graph.reserve(header.vreserved, header.ereserved);
+        auto helper = graph.GetConstructionHelper();
+
+        size_t vertex_cnt = header.vertex_cnt, edge_cnt = header.edge_cnt;
+        TRACE("Creating " << vertex_cnt << " vertex pairs");
+#       pragma omp parallel for schedule(static)
         for (size_t i = 0; i < vertex_cnt; ++i) {
-            uint64_t start_ids[2];
-            str >> start_ids;
-            TryAddVertex(start_ids);
-            while (true) {
-                uint64_t edge_ids[2];
-                str >> edge_ids[0];
-                if (!edge_ids[0]) //null-term
-                    break;
-                str >> edge_ids[1];
-                uint64_t end_ids[2];
-                Sequence seq;
-                str >> end_ids >> seq;
-                TRACE("Edge " << edge_ids[0] << " : " << start_ids[0] << " -> "
-                              << end_ids[0] << " l = " << seq.size() << " ~ " << edge_ids[1]);
-                TryAddVertex(end_ids);
-
-                auto new_id = graph.AddEdge(start_ids[0], end_ids[0],
-                        typename Graph::EdgeData(seq), edge_ids[0], edge_ids[1]);
-                VERIFY(new_id == edge_ids[0]);
-                VERIFY(graph.conjugate(new_id) == edge_ids[1]);
+            const VertexRecord &rec = vrecs[i];
+            VertexId v = helper.CreateVertex(typename Graph::VertexData(), rec.id, rec.conjugate);
+            VERIFY_MSG(v == rec.id && graph.conjugate(v) == rec.conjugate, "Inconsistent vertex " << rec.id);
+        }
+
+        TRACE("Creating " << edge_cnt << " edge pairs");
+#       pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < edge_cnt; ++i) {
+            const EdgeRecord &rec = erecs[i];
+            VERIFY_MSG(rec.seq_offset + Sequence::DataSize(rec.seq_size) <= header.nucl_words,
+                       "Sequence of edge " << rec.id << " is out of bounds");
+            Sequence seq(size_t(rec.seq_size), nucls + rec.seq_offset);
+            EdgeId e = helper.CreateEdge(typename Graph::EdgeData(seq), rec.id, rec.conjugate);
+            VERIFY_MSG(e == rec.id && graph.conjugate(e) == rec.conjugate, "Inconsistent edge " << rec.id);
+        }
+
+        // Links modify the outgoing edges of the vertex, so they are grouped
+        // by the vertex and then every group is processed by a single thread.
+        // Self-conjugate edge is linked to its end by the outgoing link.
+        std::vector<LinkRecord> links(2 * edge_cnt);
+#       pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < edge_cnt; ++i) {
+            const EdgeRecord &rec = erecs[i];
+            links[2 * i] = { rec.start, rec.id, true };
+            if (rec.id != rec.conjugate)
+                links[2 * i + 1] = { graph.conjugate(VertexId(rec.end)).int_id(), rec.id, false };
+            else
+                links[2 * i + 1] = { 0, 0, false };
+        }
+        parallel::sort(links.begin(), links.end());
+
+        std::vector<size_t> group_pos;
+        for (size_t i = 0; i < links.size(); ++i) {
+            if (links[i].vertex && (i == 0 || links[i].vertex != links[i - 1].vertex))
+                group_pos.push_back(i);
+        }
+        group_pos.push_back(links.size());
+
+        size_t group_cnt = group_pos.size() - 1;
+        TRACE("Linking " << group_cnt << " vertices");
+#       pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < group_cnt; ++i) {
+            for (size_t j = group_pos[i]; j < group_pos[i + 1]; ++j) {
+                const LinkRecord &link = links[j];
+                if (link.outgoing)
+                    helper.LinkOutgoingEdge(link.vertex, link.edge);
+                else
+                    helper.LinkIncomingEdge(graph.conjugate(VertexId(link.vertex)), link.edge);
             }
         }
+
+        // Handlers are not thread-safe in general, so they are notified afterwards
+        for (size_t i = 0; i < vertex_cnt; ++i)
+            graph.FireAddVertex(vrecs[i].id);
+        for (size_t i = 0; i < edge_cnt; ++i)
+            graph.FireAddEdge(erecs[i].id);
     }
 
     DECL_LOGGER("GraphIO");
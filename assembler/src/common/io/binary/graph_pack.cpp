@@ -7,6 +7,7 @@
 #include "graph_pack.hpp"
 
 #include "basic.hpp"
+#include "bwa_index.hpp"
 #include "coverage.hpp"
 #include "edge_index.hpp"
 #include "genomic_info.hpp"
@@ -194,6 +195,9 @@ void BasePackIO::Save(const std::string &basename, const Type &gp) {
 
     //5. Save flanking coverage
     saver.Save<FlankingCoverage<Graph>>();
+
+    //6. Save BWA index
+    saver.Save<alignment::BWAIndexHolder>();
 }
 
 bool BasePackIO::Load(const std::string &basename, Type &gp) {
@@ -218,6 +222,9 @@ bool BasePackIO::Load(const std::string &basename, Type &gp) {
     //5. Load flanking coverage
     loader.Load<FlankingCoverage<Graph>>();
 
+    //6. Load BWA index
+    loader.Load<alignment::BWAIndexHolder>();
+
     return true;
 }
 
@@ -241,6 +248,9 @@ void BasePackIO::BinWrite(std::ostream &os, const Type &gp)  {
 
     //5. Write flanking coverage
     writer.Write<FlankingCoverage<Graph>>();
+
+    //6. Write BWA index
+    writer.Write<alignment::BWAIndexHolder>();
 }
 
 bool BasePackIO::BinRead(std::istream &is, Type &gp) {
@@ -264,6 +274,9 @@ bool BasePackIO::BinRead(std::istream &is, Type &gp) {
     //5. Read flanking coverage
     reader.Read<FlankingCoverage<Graph>>();
 
+    //6. Read BWA index
+    reader.Read<alignment::BWAIndexHolder>();
+
     return true;
 }
 
@@ -12,6 +12,7 @@
 #include "io/reads/multifile_reader.hpp"
 #include "io/reads/converting_reader_wrapper.hpp"
 #include "io/reads/edge_sequences_reader.hpp"
+#include "io/reads/parallel_fasta_fastq_gz_parser.hpp"
 
 #include "utils/filesystem/file_opener.hpp"
 #include "utils/logger/logger.hpp"
@@ -62,7 +63,8 @@ bool ReadConverter::LoadLibIfExists(SequencingLibraryT& lib) {
 }
 
 void ReadConverter::ConvertToBinary(SequencingLibraryT& lib,
-                                    ThreadPool::ThreadPool *pool) {
+                                    ThreadPool::ThreadPool *pool,
+                                    unsigned parser_threads) {
     auto& data = lib.data();
     std::ofstream info;
     info.open(data.binary_reads_info.bin_reads_info_file, std::ios_base::out);
@@ -74,6 +76,10 @@ void ReadConverter::ConvertToBinary(SequencingLibraryT& lib,
     BinaryWriter paired_converter(data.binary_reads_info.paired_read_prefix);
 
     FileReadFlags flags{ PhredOffset, /* use name */ false, /* use quality */ false, /* validate */ false };
+    // Paired reads are parsed from two files simultaneously, so each of them takes a half
+    ThreadBudget budget(parser_threads);
+    flags.threads = static_cast<unsigned char>(std::min(std::max(1u, parser_threads / 2), 255u));
+    flags.budget = &budget;
     PairedStream paired_reader = paired_easy_reader(lib, false, 0, false, flags, pool);
     ReadStreamStat read_stat = paired_converter.ToBinary(paired_reader, lib.orientation(), pool);
     read_stat.read_count *= 2;
@@ -140,7 +146,7 @@ void ConvertIfNeeded(DataSet<LibraryData> &data, unsigned nthreads) {
 
     for (auto &lib : data) {
         if (!ReadConverter::LoadLibIfExists(lib))
-            ReadConverter::ConvertToBinary(lib, pool.get());
+            ReadConverter::ConvertToBinary(lib, pool.get(), nthreads);
     }
 }
 
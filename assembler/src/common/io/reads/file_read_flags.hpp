@@ -8,6 +8,8 @@
 
 namespace io {
 
+class ThreadBudget;
+
 /*
 * This enumerate contains offset type.
 * UnknownOffset is equal to "offset = 0".
@@ -26,15 +28,19 @@ struct FileReadFlags {
     bool use_name     : 1;
     bool use_quality  : 1;
     bool validate     : 1;
+    // Number of threads used to decompress and parse the file
+    unsigned threads  : 8;
+    // If set, the threads are taken from there, shared by the files read at once
+    ThreadBudget *budget;
 
     FileReadFlags()
-            : offset(PhredOffset), use_name(true), use_quality(true), validate(true) {}
+            : offset(PhredOffset), use_name(true), use_quality(true), validate(true), threads(1), budget(nullptr) {}
     FileReadFlags(OffsetType o)
-            : offset(o), use_name(true), use_quality(true) {}
+            : offset(o), use_name(true), use_quality(true), threads(1), budget(nullptr) {}
     FileReadFlags(OffsetType o, bool n, bool q)
-            : offset(o), use_name(n), use_quality(q) {}
+            : offset(o), use_name(n), use_quality(q), threads(1), budget(nullptr) {}
     FileReadFlags(OffsetType o, bool n, bool q, bool v)
-            : offset(o), use_name(n), use_quality(q), validate(v) {}
+            : offset(o), use_name(n), use_quality(q), validate(v), threads(1), budget(nullptr) {}
 
 };
 
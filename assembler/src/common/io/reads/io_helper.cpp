@@ -20,7 +20,8 @@ SingleStream EasyStream(const std::string& filename, bool followed_by_rc,
                         bool handle_Ns,
                         FileReadFlags flags,
                         ThreadPool::ThreadPool *pool) {
-    SingleStream reader  = (pool ?
+    // The parser using several threads reads ahead by itself
+    SingleStream reader  = (pool && flags.threads <= 1 ?
                             make_async_stream<FileReadStream>(*pool, filename, flags) :
                             FileReadStream(filename, flags));
     if (handle_Ns)
@@ -22,7 +22,8 @@ SeparatePairedReadStream::SeparatePairedReadStream(const std::string& filename1,
         : insert_size_(insert_size),
           filename1_(filename1),
           filename2_(filename2) {
-    if (pool) {
+    // The parser using several threads reads ahead by itself
+    if (pool && flags.threads <= 1) {
         first_ = make_async_stream<FileReadStream>(*pool, filename1, flags);
         second_ = make_async_stream<FileReadStream>(*pool, filename2, flags);
     } else {
@@ -55,7 +56,8 @@ InterleavingPairedReadStream::InterleavingPairedReadStream(const std::string& fi
                                                            FileReadFlags flags,
                                                            ThreadPool::ThreadPool *pool)
         : filename_(filename), insert_size_(insert_size) {
-    if (pool) {
+    // The parser using several threads reads ahead by itself
+    if (pool && flags.threads <= 1) {
         single_ = make_async_stream<FileReadStream>(*pool, filename_, flags);
     } else {
         single_ = FileReadStream(filename_, flags);
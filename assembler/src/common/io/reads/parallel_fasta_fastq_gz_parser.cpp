@@ -0,0 +1,496 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "parallel_fasta_fastq_gz_parser.hpp"
+
+#include "utils/logger/logger.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/verify.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+namespace io {
+
+namespace {
+
+enum class ScanResult {
+    Complete,
+    Incomplete,
+    Malformed
+};
+
+struct Record {
+    const char *name;
+    size_t name_size;
+    std::string seq, qual;
+    bool has_qual;
+};
+
+// Finds the end of the line starting at pos. The unterminated line is
+// accepted only at the end of the input.
+bool FindLineEnd(const char *text, size_t pos, size_t size, bool final, size_t &eol) {
+    const void *p = memchr(text + pos, '\n', size - pos);
+    if (p) {
+        eol = static_cast<const char*>(p) - text;
+        return true;
+    }
+    eol = size;
+    return final;
+}
+
+size_t LineSize(const char *text, size_t from, size_t eol) {
+    size_t len = eol - from;
+    if (len && text[eol - 1] == '\r')
+        --len;
+    return len;
+}
+
+void AppendUpper(std::string &s, const char *line, size_t len) {
+    size_t from = s.size();
+    s.append(line, len);
+    std::transform(s.begin() + from, s.end(), s.begin() + from, [](char c) { return (char)toupper(c); });
+}
+
+/*
+ * Scans the record starting at the header line at pos, moves pos to the
+ * position after the record. Record is not complete if it might continue
+ * after the end of the text. The record is stored only if rec is given.
+ * Mimics kseq_read().
+ */
+ScanResult ScanRecord(const char *text, size_t &pos, size_t size, bool final, Record *rec) {
+    size_t eol;
+    if (!FindLineEnd(text, pos, size, final, eol))
+        return ScanResult::Incomplete;
+    if (rec) {
+        rec->name = text + pos + 1;
+        // The bundled kseq reads the name up to the end of the line, so the
+        // comment stays a part of the name
+        rec->name_size = (eol > pos ? LineSize(text, pos + 1, eol) : 0);
+        rec->seq.clear();
+        rec->qual.clear();
+        rec->has_qual = false;
+    }
+
+    // Sequence lines up to the next header or the separator
+    size_t p = std::min(eol + 1, size), seq_size = 0;
+    while (true) {
+        if (p >= size) {
+            if (!final)
+                return ScanResult::Incomplete;
+            break;
+        }
+        char c = text[p];
+        if (c == '>' || c == '+' || c == '@')
+            break;
+        if (c == '\n') {
+            ++p;
+            continue;
+        }
+        if (!FindLineEnd(text, p, size, final, eol))
+            return ScanResult::Incomplete;
+        size_t len = LineSize(text, p, eol);
+        seq_size += len;
+        if (rec)
+            AppendUpper(rec->seq, text + p, len);
+        p = std::min(eol + 1, size);
+    }
+
+    if (p >= size || text[p] != '+') { // FASTA
+        pos = p;
+        return ScanResult::Complete;
+    }
+
+    // Skip the separator line, then quality lines up to the sequence length
+    if (!FindLineEnd(text, p, size, final, eol))
+        return ScanResult::Incomplete;
+    if (eol >= size)
+        return ScanResult::Malformed;
+    p = eol + 1;
+
+    size_t qual_size = 0;
+    do {
+        if (p >= size) {
+            if (!final)
+                return ScanResult::Incomplete;
+            break;
+        }
+        if (!FindLineEnd(text, p, size, final, eol))
+            return ScanResult::Incomplete;
+        size_t len = LineSize(text, p, eol);
+        qual_size += len;
+        if (rec)
+            rec->qual.append(text + p, len);
+        p = std::min(eol + 1, size);
+    } while (qual_size < seq_size);
+
+    if (qual_size != seq_size)
+        return ScanResult::Malformed;
+
+    if (rec)
+        rec->has_qual = true;
+    pos = p;
+    return ScanResult::Complete;
+}
+
+uint32_t GetLE32(const unsigned char *p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+uint16_t GetLE16(const unsigned char *p) {
+    return uint16_t(p[0] | (p[1] << 8));
+}
+
+const size_t BGZF_HEADER_SIZE = 18;
+
+// Standard BGZF header: gzip with a single 'BC' extra subfield holding the block size
+bool IsBGZFHeader(const unsigned char *h) {
+    return h[0] == 31 && h[1] == 139 && h[2] == 8 && (h[3] & 4) &&
+           GetLE16(h + 10) == 6 && h[12] == 'B' && h[13] == 'C' && GetLE16(h + 14) == 2;
+}
+
+// Inflates the BGZF block (compressed data with the trailing CRC32 and ISIZE)
+void InflateBGZFBlock(const std::string &block, std::string &out) {
+    const unsigned char *data = reinterpret_cast<const unsigned char*>(block.data());
+    size_t csize = block.size() - 8;
+    out.resize(GetLE32(data + csize + 4));
+
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    CHECK_FATAL_ERROR(inflateInit2(&strm, -15) == Z_OK, "Failed to initialize inflate");
+    strm.next_in = const_cast<unsigned char*>(data);
+    strm.avail_in = unsigned(csize);
+    strm.next_out = reinterpret_cast<unsigned char*>(&out[0]);
+    strm.avail_out = unsigned(out.size());
+    int res = inflate(&strm, Z_FINISH);
+    inflateEnd(&strm);
+    CHECK_FATAL_ERROR(res == Z_STREAM_END && strm.avail_out == 0, "Corrupted BGZF block");
+
+    uint32_t crc = uint32_t(crc32(0L, reinterpret_cast<const unsigned char*>(out.data()), unsigned(out.size())));
+    CHECK_FATAL_ERROR(crc == GetLE32(data + csize), "BGZF block checksum mismatch");
+}
+
+}
+
+ParallelFastaFastqGzParser::ParallelFastaFastqGzParser(const std::string &filename,
+                                                       FileReadFlags flags,
+                                                       size_t chunk_size)
+        : Parser(filename, flags), chunk_size_(chunk_size),
+          max_threads_(std::max(2u, unsigned(flags.threads))), nthreads_(0), budgeted_(0),
+          started_(false), in_flight_(0), emitted_(0), input_done_(false), stop_(false),
+          raw_(nullptr), gz_(nullptr), bgzf_(false),
+          current_id_(0), current_pos_(0) {
+    open();
+}
+
+ParallelFastaFastqGzParser::~ParallelFastaFastqGzParser() {
+    close();
+}
+
+void ParallelFastaFastqGzParser::open() {
+    in_flight_ = emitted_ = 0;
+    input_done_ = stop_ = started_ = false;
+    current_.reset();
+    current_id_ = current_pos_ = 0;
+
+    raw_ = fopen(filename_.c_str(), "rb");
+    if (!raw_) {
+        is_open_ = false;
+        return;
+    }
+    unsigned char header[BGZF_HEADER_SIZE];
+    bgzf_ = (fread(header, 1, BGZF_HEADER_SIZE, raw_) == BGZF_HEADER_SIZE && IsBGZFHeader(header));
+    if (bgzf_) {
+        rewind(raw_);
+    } else {
+        fclose(raw_);
+        raw_ = nullptr;
+        gz_ = gzopen(filename_.c_str(), "r");
+        if (!gz_) {
+            is_open_ = false;
+            return;
+        }
+        gzbuffer(static_cast<gzFile>(gz_), 1 << 20);
+    }
+
+    is_open_ = true;
+    eof_ = false;
+}
+
+void ParallelFastaFastqGzParser::Start() {
+    started_ = true;
+    nthreads_ = max_threads_;
+    if (flags_.budget)
+        nthreads_ = budgeted_ = flags_.budget->Acquire(max_threads_);
+    // The reader and one worker run even if the budget is exhausted
+    nthreads_ = std::max(2u, nthreads_);
+
+    reader_ = std::thread(&ParallelFastaFastqGzParser::ReadInput, this);
+    for (unsigned i = 0; i + 1 < nthreads_; ++i)
+        workers_.emplace_back(&ParallelFastaFastqGzParser::ParseChunks, this);
+
+    ReadAhead();
+}
+
+void ParallelFastaFastqGzParser::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    space_cv_.notify_all();
+    work_cv_.notify_all();
+    ready_cv_.notify_all();
+
+    if (reader_.joinable())
+        reader_.join();
+    for (auto &worker : workers_)
+        worker.join();
+    workers_.clear();
+
+    if (flags_.budget)
+        flags_.budget->Release(budgeted_);
+    budgeted_ = 0;
+
+    if (raw_)
+        fclose(raw_);
+    raw_ = nullptr;
+    if (gz_)
+        gzclose(static_cast<gzFile>(gz_));
+    gz_ = nullptr;
+
+    pending_.clear();
+    ready_.clear();
+}
+
+void ParallelFastaFastqGzParser::close() {
+    if (!is_open_)
+        return;
+
+    Stop();
+    current_.reset();
+    is_open_ = false;
+    eof_ = true;
+}
+
+bool ParallelFastaFastqGzParser::eof() const {
+    // Whether anything is left is known only after the first chunk is parsed
+    if (is_open_ && !started_)
+        const_cast<ParallelFastaFastqGzParser*>(this)->Start();
+    return eof_;
+}
+
+ParallelFastaFastqGzParser &ParallelFastaFastqGzParser::operator>>(SingleRead &read) {
+    if (eof())
+        return *this;
+
+    read = std::move(current_->reads[current_pos_++]);
+    ReadAhead();
+    return *this;
+}
+
+void ParallelFastaFastqGzParser::ReadAhead() {
+    if (current_ && current_pos_ < current_->reads.size())
+        return;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (current_) {
+        current_.reset();
+        in_flight_ -= 1;
+        space_cv_.notify_one();
+    }
+
+    ready_cv_.wait(lock, [this] {
+        return ready_.count(current_id_) || (input_done_ && current_id_ >= emitted_);
+    });
+    auto it = ready_.find(current_id_);
+    if (it == ready_.end()) {
+        // Nothing is left, so the threads and the input are released now
+        lock.unlock();
+        eof_ = true;
+        Stop();
+        return;
+    }
+
+    current_ = std::move(it->second);
+    ready_.erase(it);
+    current_id_ += 1;
+    current_pos_ = 0;
+}
+
+void ParallelFastaFastqGzParser::ReadInput() {
+    std::string buffer;
+    bool final = false;
+    while (!final) {
+        if (bgzf_) {
+            if (!ReadBGZF(buffer, final))
+                break;
+        } else {
+            size_t size = buffer.size();
+            buffer.resize(size + chunk_size_);
+            int res = gzread(static_cast<gzFile>(gz_), &buffer[size], unsigned(chunk_size_));
+            CHECK_FATAL_ERROR(res >= 0, "Failed to read " << filename_);
+            buffer.resize(size + size_t(res));
+            final = (size_t(res) < chunk_size_);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_)
+                break;
+        }
+        if (!EmitChunks(buffer, final))
+            break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        input_done_ = true;
+    }
+    work_cv_.notify_all();
+    ready_cv_.notify_all();
+}
+
+bool ParallelFastaFastqGzParser::ReadBGZF(std::string &buffer, bool &final) {
+    // BGZF blocks carry at most 64K of data
+    size_t nblocks = std::max<size_t>(1, chunk_size_ >> 16);
+    std::vector<std::string> blocks;
+    for (size_t i = 0; i < nblocks; ++i) {
+        unsigned char header[BGZF_HEADER_SIZE];
+        size_t read = fread(header, 1, BGZF_HEADER_SIZE, raw_);
+        if (read == 0) {
+            final = true;
+            break;
+        }
+        CHECK_FATAL_ERROR(read == BGZF_HEADER_SIZE && IsBGZFHeader(header),
+                          "Invalid BGZF block in " << filename_);
+
+        size_t block_size = size_t(GetLE16(header + 16)) + 1;
+        CHECK_FATAL_ERROR(block_size >= BGZF_HEADER_SIZE + 8, "Invalid BGZF block in " << filename_);
+        blocks.emplace_back(block_size - BGZF_HEADER_SIZE, '\0');
+        CHECK_FATAL_ERROR(fread(&blocks.back()[0], 1, blocks.back().size(), raw_) == blocks.back().size(),
+                          "Truncated BGZF block in " << filename_);
+    }
+
+    std::vector<std::string> data(blocks.size());
+#   pragma omp parallel for num_threads(nthreads_) schedule(dynamic)
+    for (size_t i = 0; i < blocks.size(); ++i)
+        InflateBGZFBlock(blocks[i], data[i]);
+
+    for (const auto &block : data)
+        buffer += block;
+
+    return true;
+}
+
+bool ParallelFastaFastqGzParser::EmitChunks(std::string &buffer, bool final) {
+    if (!final && buffer.size() < chunk_size_)
+        return true;
+
+    std::unique_ptr<Chunk> chunk(new Chunk());
+    const char *text = buffer.data();
+    size_t size = buffer.size(), pos = 0, cut = 0;
+    bool malformed = false;
+    while (true) {
+        // Skip everything up to the header, as kseq does
+        while (pos < size && text[pos] != '>' && text[pos] != '@')
+            ++pos;
+        if (pos >= size) {
+            cut = size;
+            break;
+        }
+
+        size_t end = pos;
+        ScanResult res = ScanRecord(text, end, size, final, nullptr);
+        if (res == ScanResult::Incomplete) {
+            cut = pos;
+            break;
+        }
+        if (res == ScanResult::Malformed) {
+            WARN("Malformed record in " << filename_ << ", the rest of the file is ignored");
+            cut = size = pos;
+            malformed = true;
+            break;
+        }
+
+        chunk->records.push_back(pos);
+        pos = end;
+    }
+
+    std::string rest(buffer, cut, buffer.size() - cut);
+    buffer.resize(size);
+    chunk->text.swap(buffer);
+    buffer.swap(rest);
+    if (chunk->records.empty())
+        return !malformed;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    // The chunk being returned and the ones being parsed
+    space_cv_.wait(lock, [this] { return stop_ || in_flight_ < nthreads_ + 1; });
+    if (stop_)
+        return false;
+    in_flight_ += 1;
+    pending_[emitted_++] = std::move(chunk);
+    work_cv_.notify_one();
+
+    return !malformed;
+}
+
+void ParallelFastaFastqGzParser::ParseChunks() {
+    while (true) {
+        size_t id;
+        std::unique_ptr<Chunk> chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [this] { return stop_ || !pending_.empty() || input_done_; });
+            if (stop_ || pending_.empty())
+                return;
+
+            auto it = pending_.begin();
+            id = it->first;
+            chunk = std::move(it->second);
+            pending_.erase(it);
+        }
+
+        ParseChunk(*chunk);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_[id] = std::move(chunk);
+        }
+        ready_cv_.notify_all();
+    }
+}
+
+void ParallelFastaFastqGzParser::ParseChunk(Chunk &chunk) const {
+    const char *text = chunk.text.data();
+    chunk.reads.resize(chunk.records.size());
+    Record rec;
+    for (size_t i = 0; i < chunk.records.size(); ++i) {
+        size_t pos = chunk.records[i];
+        size_t end = (i + 1 < chunk.records.size() ? chunk.records[i + 1] : chunk.text.size());
+        ScanResult res = ScanRecord(text, pos, end, /* final */ true, &rec);
+        VERIFY_MSG(res == ScanResult::Complete, "Chunk is not split at the record boundary");
+
+        if (rec.has_qual && flags_.use_name && flags_.use_quality) {
+            chunk.reads[i] = SingleRead(std::string(rec.name, rec.name_size), rec.seq, rec.qual, flags_.offset,
+                                        0, 0, flags_.validate);
+        } else if (flags_.use_name) {
+            chunk.reads[i] = SingleRead(std::string(rec.name, rec.name_size), rec.seq,
+                                        0, 0, flags_.validate);
+        } else
+            chunk.reads[i] = SingleRead(rec.seq,
+                                        0, 0, flags_.validate);
+    }
+
+    std::string().swap(chunk.text);
+    std::vector<size_t>().swap(chunk.records);
+}
+
+}
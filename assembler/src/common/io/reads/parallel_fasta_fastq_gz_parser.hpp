@@ -0,0 +1,140 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "parser.hpp"
+#include "single_read.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace io {
+
+/*
+ * Threads shared by the parsers of the files read at once, see FileReadFlags.
+ */
+class ThreadBudget {
+public:
+    explicit ThreadBudget(unsigned threads)
+            : available_(threads) {}
+
+    // Takes up to wanted threads, returns the number taken
+    unsigned Acquire(unsigned wanted) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unsigned res = std::min(wanted, available_);
+        available_ -= res;
+        return res;
+    }
+
+    void Release(unsigned threads) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        available_ += threads;
+    }
+
+private:
+    std::mutex mutex_;
+    unsigned available_;
+};
+
+/*
+ * FASTA / FASTQ parser (possibly gzipped) which uses several threads.
+ *
+ * The reader thread inflates the input into large text chunks cut at the
+ * record boundaries. BGZF blocks are inflated in parallel, other gzip files
+ * are inflated sequentially. The records of the chunks are turned into
+ * SingleReads by the worker threads, the reads are returned in the file order.
+ * Records are recognized the same way as kseq does.
+ *
+ * The threads are started by the first query of the stream and stopped at its
+ * end, so the opened but not yet read streams take neither threads nor memory.
+ */
+class ParallelFastaFastqGzParser: public Parser {
+    struct Chunk {
+        std::string text;
+        std::vector<size_t> records;
+        std::vector<SingleRead> reads;
+    };
+
+public:
+    static const size_t DEFAULT_CHUNK_SIZE = 4 << 20;
+
+    /*
+     * Default constructor.
+     *
+     * @param filename The name of the file to be opened.
+     * @param flags Reading flags, the number of threads is taken from there.
+     * @param chunk_size The approximate size of the text passed to the worker.
+     */
+    ParallelFastaFastqGzParser(const std::string &filename,
+                               FileReadFlags flags = FileReadFlags(),
+                               size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    ~ParallelFastaFastqGzParser();
+
+    bool eof() const override;
+
+    ParallelFastaFastqGzParser &operator>>(SingleRead &read) override;
+
+    void close() override;
+
+private:
+    void open() override;
+
+    // Starts the threads and waits for the first chunk
+    void Start();
+    // Joins the threads and closes the input
+    void Stop();
+
+    // Reader thread
+    void ReadInput();
+    bool ReadBGZF(std::string &buffer, bool &final);
+    // Returns false if no more input should be read
+    bool EmitChunks(std::string &buffer, bool final);
+
+    // Worker threads
+    void ParseChunks();
+    void ParseChunk(Chunk &chunk) const;
+
+    // Waits for the next chunk having reads
+    void ReadAhead();
+
+    size_t chunk_size_;
+    // Threads requested by the flags and the ones running, taken from the budget
+    unsigned max_threads_, nthreads_, budgeted_;
+    bool started_;
+
+    std::thread reader_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable space_cv_, work_cv_, ready_cv_;
+    // Chunks to be parsed and parsed ones by the chunk number
+    std::map<size_t, std::unique_ptr<Chunk>> pending_, ready_;
+    size_t in_flight_;
+    size_t emitted_;
+    bool input_done_;
+    bool stop_;
+
+    // Opened input, used by the reader thread only
+    FILE *raw_;
+    void *gz_;
+    bool bgzf_;
+
+    std::unique_ptr<Chunk> current_;
+    size_t current_id_, current_pos_;
+
+    ParallelFastaFastqGzParser(const ParallelFastaFastqGzParser &) = delete;
+    void operator=(const ParallelFastaFastqGzParser &) = delete;
+};
+
+}
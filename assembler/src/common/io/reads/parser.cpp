@@ -30,6 +30,7 @@
 #include "file_read_flags.hpp"
 #include "single_read.hpp"
 #include "fasta_fastq_gz_parser.hpp"
+#include "parallel_fasta_fastq_gz_parser.hpp"
 #include "io/sam/bam_parser.hpp"
 
 namespace io {
@@ -70,6 +71,9 @@ Parser* SelectParser(const std::string& filename,
   if (ext == "bam")
       return new BAMParser(filename, flags);
 
+  if (flags.threads > 1)
+      return new ParallelFastaFastqGzParser(filename, flags);
+
   return new FastaFastqGzParser(filename, flags);
   /*
   if ((ext == "fastq") || (ext == "fastq.gz") ||
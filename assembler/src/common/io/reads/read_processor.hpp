@@ -8,21 +8,85 @@
 #ifndef __HAMMER_READ_PROCESSOR_HPP__
 #define __HAMMER_READ_PROCESSOR_HPP__
 
-#include "io/reads/mpmc_bounded.hpp"
 #include "utils/parallel/openmp_wrapper.h"
 
+#include <condition_variable>
 #include <memory>
-#include <sched.h>
+#include <mutex>
+#include <vector>
 
 #pragma GCC diagnostic push
 #ifdef __clang__
 #pragma clang diagnostic ignored "-Wunused-private-field"
 #endif
 namespace hammer {
+
+/**
+ * @brief Blocking queue of the batch indices. Capacity is never exceeded
+ *        since the number of batches is fixed.
+ */
+class BatchQueue {
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<size_t> items_;
+    bool closed_;
+
+public:
+    BatchQueue()
+            : closed_(false) {}
+
+    void push(size_t item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            items_.push_back(item);
+        }
+        cv_.notify_one();
+    }
+
+    bool try_pop(size_t &item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty())
+            return false;
+        item = items_.back();
+        items_.pop_back();
+        return true;
+    }
+
+    /**
+     * @brief Blocks until the item is available.
+     * @return false if the queue is closed and empty
+     */
+    bool pop(size_t &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty())
+            return false;
+        item = items_.back();
+        items_.pop_back();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        cv_.notify_all();
+    }
+};
+
+/**
+ * @brief Runs the operation over all the reads of the stream in parallel.
+ *        Reads are passed to the workers in batches. Batches are reused, so
+ *        the reads are not reallocated if the operation accepts the read by
+ *        reference. Otherwise, the operation gets the ownership of the read.
+ */
 class ReadProcessor {
     static size_t constexpr cacheline_size = 64;
     typedef char cacheline_pad_t[cacheline_size];
 
+    static const size_t BATCH_SIZE = 4096;
+
     unsigned nthreads_;
     cacheline_pad_t pad0;
     size_t read_;
@@ -31,17 +95,50 @@ class ReadProcessor {
     cacheline_pad_t pad2;
 
 private:
+    template<class ReadT, class Result>
+    struct Batch {
+        std::vector<std::unique_ptr<ReadT>> reads;
+        size_t size = 0;
+        std::vector<Result> results;
+    };
+
+    // Operations accepting the read by reference are preferred
+    template<class Op, class ReadT>
+    static auto Apply(Op &op, std::unique_ptr<ReadT> &r, int) -> decltype(op(*r)) {
+        return op(*r);
+    }
+
+    template<class Op, class ReadT>
+    static auto Apply(Op &op, std::unique_ptr<ReadT> &r, long) -> decltype(op(std::move(r))) {
+        return op(std::move(r)); // Pass ownership of read down to processor
+    }
+
+    template<class Reader, class BatchT>
+    static void Fill(Reader &irs, BatchT &batch) {
+        batch.size = 0;
+        batch.reads.resize(BATCH_SIZE);
+        for (auto &r : batch.reads) {
+            if (irs.eof())
+                break;
+            if (!r)
+                r.reset(new typename Reader::ReadT);
+            irs >> *r;
+            batch.size += 1;
+        }
+    }
+
     template<class Reader, class Op>
     bool RunSingle(Reader &irs, Op &op) {
-        using ReadPtr = std::unique_ptr<typename Reader::ReadT>;
+        std::unique_ptr<typename Reader::ReadT> r;
 
         while (!irs.eof()) {
-            ReadPtr r = ReadPtr(new typename Reader::ReadT) ;
+            if (!r)
+                r.reset(new typename Reader::ReadT);
             irs >> *r;
             read_ += 1;
 
             processed_ += 1;
-            if (op(std::move(r))) // Pass ownership of read down to processor
+            if (Apply(op, r, 0))
                 return true;
         }
 
@@ -50,14 +147,15 @@ private:
 
     template<class Reader, class Op, class Writer>
     void RunSingle(Reader &irs, Op &op, Writer &writer) {
-        using ReadPtr = std::unique_ptr<typename Reader::ReadT>;
+        std::unique_ptr<typename Reader::ReadT> r;
 
         while (!irs.eof()) {
-            ReadPtr r = ReadPtr(new typename Reader::ReadT) ;
+            if (!r)
+                r.reset(new typename Reader::ReadT);
             irs >> *r;
             read_ += 1;
 
-            auto res = op(std::move(r)); // Pass ownership of read down to processor
+            auto res = Apply(op, r, 0);
             processed_ += 1;
 
             if (res)
@@ -65,142 +163,116 @@ private:
         }
     }
 
-public:
-    ReadProcessor(unsigned nthreads)
-            : nthreads_(nthreads), read_(0), processed_(0) { }
-
-    size_t read() const { return read_; }
-
-    size_t processed() const { return processed_; }
-
-    template<class Reader, class Op>
-    bool Run(Reader &irs, Op &op) {
-        using ReadPtr = std::unique_ptr<typename Reader::ReadT>;
+    /**
+     * @brief The master thread fills the batches and other threads process them.
+     *        Processed batches are returned to the master, which flushes their
+     *        results and reuses them. If there is no batch to fill, the master
+     *        processes the filled one by itself.
+     * @return true if any of the operation calls returned true (for the operations returning bool)
+     */
+    template<class Reader, class Op, class Flush>
+    bool RunBatched(Reader &irs, Op &op, Flush flush, bool stop_on_result) {
+        typedef decltype(Apply(op, std::declval<std::unique_ptr<typename Reader::ReadT>&>(), 0)) Result;
+        typedef Batch<typename Reader::ReadT, Result> BatchT;
+
+        std::vector<BatchT> batches(2 * nthreads_);
+        BatchQueue filled, processed;
+        for (size_t i = 0; i < batches.size(); ++i)
+            processed.push(i);
 
-        if (nthreads_ < 2)
-            return RunSingle(irs, op);
+        bool stop = false;
+        auto process = [&](BatchT &batch) {
+            bool batch_stop = false;
+            for (size_t i = 0; i < batch.size; ++i) {
+                auto res = Apply(op, batch.reads[i], 0);
+                if (!res)
+                    continue;
+                if (stop_on_result)
+                    batch_stop = true;
+                else
+                    batch.results.push_back(std::move(res));
+            }
 
-        // Round nthreads to next power of two
-        unsigned bufsize = nthreads_ - 1;
-        bufsize = (bufsize >> 1) | bufsize;
-        bufsize = (bufsize >> 2) | bufsize;
-        bufsize = (bufsize >> 4) | bufsize;
-        bufsize = (bufsize >> 8) | bufsize;
-        bufsize = (bufsize >> 16) | bufsize;
-        bufsize += 1;
+#           pragma omp atomic
+            processed_ += batch.size;
 
-        mpmc_bounded_queue<ReadPtr> in_queue(2 * bufsize);
+            if (batch_stop) {
+#               pragma omp atomic write
+                stop = true;
+            }
+        };
 
-        bool stop = false;
-#   pragma omp parallel shared(in_queue, irs, op, stop) num_threads(nthreads_)
+#   pragma omp parallel num_threads(nthreads_)
         {
 #     pragma omp master
             {
                 while (!irs.eof()) {
-                    ReadPtr r = ReadPtr(new typename Reader::ReadT) ;
-                    irs >> *r;
+                    size_t idx;
+                    if (!processed.try_pop(idx)) {
+                        if (filled.try_pop(idx))
+                            process(batches[idx]);
+                        else
+                            processed.pop(idx); // Never closed, so always succeeds
+                    }
+
+                    BatchT &batch = batches[idx];
+                    flush(batch.results);
+                    Fill(irs, batch);
 #         pragma omp atomic
-                    read_ += 1;
-
-                    while (!in_queue.enqueue(std::move(r)))
-                        sched_yield();
+                    read_ += batch.size;
+                    filled.push(idx);
 
-#         pragma omp flush (stop)
-                    if (stop)
+                    bool stopped;
+#         pragma omp atomic read
+                    stopped = stop;
+                    if (stopped)
                         break;
                 }
 
-                in_queue.close();
+                filled.close();
             }
 
-            while (1) {
-                ReadPtr r;
-
-                if (!in_queue.wait_dequeue(r))
-                    break;
-
-#       pragma omp atomic
-                processed_ += 1;
-
-                bool res = op(std::move(r));
-                if (res) {
-#         pragma omp atomic
-                    stop |= res;
-                }
+            size_t idx;
+            while (filled.pop(idx)) {
+                process(batches[idx]);
+                processed.push(idx);
             }
         }
 
-#   pragma omp flush(stop)
+        for (auto &batch : batches)
+            flush(batch.results);
+
         return stop;
     }
 
-    template<class Reader, class Op, class Writer>
-    void Run(Reader &irs, Op &op, Writer &writer) {
-        using ReadPtr = std::unique_ptr<typename Reader::ReadT>;
-
-        if (nthreads_ < 2) {
-            RunSingle(irs, op, writer);
-            return;
-        }
-
-        // Round nthreads to next power of two
-        unsigned bufsize = nthreads_ - 1;
-        bufsize = (bufsize >> 1) | bufsize;
-        bufsize = (bufsize >> 2) | bufsize;
-        bufsize = (bufsize >> 4) | bufsize;
-        bufsize = (bufsize >> 8) | bufsize;
-        bufsize = (bufsize >> 16) | bufsize;
-        bufsize += 1;
-
-        mpmc_bounded_queue<ReadPtr> in_queue(bufsize), out_queue(2 * bufsize);
-#   pragma omp parallel shared(in_queue, out_queue, irs, op, writer) num_threads(nthreads_)
-        {
-#     pragma omp master
-            {
-                while (!irs.eof()) {
-                    ReadPtr r = ReadPtr(new typename Reader::ReadT) ;
-                    irs >> *r;
-
-                    // First, try to provide read to the queue. If it's full, never mind.
-                    bool status = in_queue.enqueue(std::move(r));
-
-                    // Flush down the output queue
-                    ReadPtr outr;
-                    while (out_queue.dequeue(outr))
-                        writer << *outr;
-
-                    // If the input queue was originally full, wait until we can insert
-                    // the read once again.
-                    if (!status)
-                        while (!in_queue.enqueue(std::move(r)))
-                            sched_yield();
-                }
+public:
+    ReadProcessor(unsigned nthreads)
+            : nthreads_(nthreads), read_(0), processed_(0) { }
 
-                in_queue.close();
+    size_t read() const { return read_; }
 
-                // Flush down the output queue while in master threads.
-                ReadPtr outr;
-                while (out_queue.dequeue(outr))
-                    writer << *outr;
-            }
+    size_t processed() const { return processed_; }
 
-            while (1) {
-                ReadPtr r;
+    template<class Reader, class Op>
+    bool Run(Reader &irs, Op &op) {
+        if (nthreads_ < 2)
+            return RunSingle(irs, op);
 
-                if (!in_queue.wait_dequeue(r))
-                    break;
+        return RunBatched(irs, op, [](std::vector<bool> &) {}, /* stop_on_result */ true);
+    }
 
-                auto res = op(std::move(r));
-                if (res)
-                    while (!out_queue.enqueue(std::move(res)))
-                        sched_yield();
-            }
+    template<class Reader, class Op, class Writer>
+    void Run(Reader &irs, Op &op, Writer &writer) {
+        if (nthreads_ < 2) {
+            RunSingle(irs, op, writer);
+            return;
         }
 
-        // Flush down the output queue
-        ReadPtr outr;
-        while (out_queue.dequeue(outr))
-            writer << *outr;
+        RunBatched(irs, op, [&writer](auto &results) {
+            for (auto &res : results)
+                writer << *res;
+            results.clear();
+        }, /* stop_on_result */ false);
     }
 };
 
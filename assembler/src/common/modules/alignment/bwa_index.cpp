@@ -6,6 +6,8 @@
 
 #include "bwa_index.hpp"
 
+#include "io/binary/binary.hpp"
+
 #include "bwa/bwa.h"
 #include "bwa/bwamem.h"
 #include "bwa/rle.h"
@@ -25,14 +27,30 @@ int is_bwt(uint8_t *T, bwtint_t n);
 
 namespace alignment {
 
+static std::shared_ptr<const BWAGraphIndex> BuildIndex(const debruijn_graph::Graph& g) {
+    auto index = std::make_shared<BWAGraphIndex>(g);
+    index->Init();
+    return index;
+}
+
 BWAIndex::BWAIndex(const debruijn_graph::Graph& g, AlignmentMode mode)
-        : g_(g),
+        : BWAIndex(BuildIndex(g), mode) {}
+
+BWAIndex::BWAIndex(std::shared_ptr<const BWAGraphIndex> index, AlignmentMode mode)
+        : g_(index->g()),
           memopt_(mem_opt_init(), free),
-          idx_(nullptr, bwa_idx_destroy),
+          index_(std::move(index)),
           mode_(mode),
           skip_secondary_(true) {
+    VERIFY(!index_->empty());
+    InitOptions();
+}
+
+BWAIndex::~BWAIndex() {}
+
+void BWAIndex::InitOptions() {
     memopt_->flag |= MEM_F_SOFTCLIP;
-    switch (mode) {
+    switch (mode_) {
         default:
         case AlignmentMode::Default:
             break;
@@ -55,11 +73,12 @@ BWAIndex::BWAIndex(const debruijn_graph::Graph& g, AlignmentMode mode)
             skip_secondary_ = false;
             break;
     };
-
-    Init();
 }
 
-BWAIndex::~BWAIndex() {}
+BWAGraphIndex::BWAGraphIndex(const debruijn_graph::Graph& g)
+        : g_(g), idx_(nullptr, bwa_idx_destroy) {}
+
+BWAGraphIndex::~BWAGraphIndex() {}
 
 static uint8_t* seqlib_add1(const std::string &seq, const std::string &name,
                             bntseq_t *bns, uint8_t *pac, int64_t *m_pac, int *m_seqs, int *m_holes, bntamb1_t **q) {
@@ -219,7 +238,13 @@ static bntann1_t* seqlib_add_to_anns(const std::string& name, const std::string&
     return ann;
 }
 
-void BWAIndex::Init() {
+void BWAGraphIndex::clear() {
+    idx_.reset();
+    ids_.clear();
+}
+
+void BWAGraphIndex::Init() {
+    INFO("Building BWA index over " << g_.e_size() / 2 << " canonical edges");
     idx_.reset((bwaidx_t*)calloc(1, sizeof(bwaidx_t)));
     ids_.clear();
 
@@ -272,6 +297,63 @@ void BWAIndex::Init() {
     idx_->bwt = bwt;
     idx_->bns = bns;
     idx_->pac = fwd_pac;
+
+    // Pack everything into a single memory block
+    bwa_idx2mem(idx_.get());
+}
+
+void BWAGraphIndex::BinWrite(std::ostream &os) const {
+    using io::binary::BinWrite;
+
+    VERIFY(idx_ && idx_->mem);
+    BinWrite(os, ids_, idx_->l_mem);
+    os.write(reinterpret_cast<const char*>(idx_->mem), idx_->l_mem);
+}
+
+void BWAGraphIndex::BinRead(std::istream &is) {
+    using io::binary::BinRead;
+
+    int64_t l_mem;
+    BinRead(is, ids_, l_mem);
+    uint8_t *mem = (uint8_t*)malloc(l_mem);
+    is.read(reinterpret_cast<char*>(mem), l_mem);
+    VERIFY_MSG(is, "Failed to read BWA index");
+
+    idx_.reset((bwaidx_t*)calloc(1, sizeof(bwaidx_t)));
+    // idx takes the ownership over the memory block
+    bwa_mem2idx(l_mem, mem, idx_.get());
+}
+
+BWAIndexHolder::BWAIndexHolder(const debruijn_graph::Graph &g)
+        : omnigraph::GraphActionHandler<debruijn_graph::Graph>(g, "BWAIndexHolder") {
+    // The index is not built until requested
+    this->Detach();
+}
+
+std::shared_ptr<const BWAGraphIndex> BWAIndexHolder::index() {
+    if (!this->IsAttached()) {
+        index_ = std::make_shared<BWAGraphIndex>(this->g());
+        index_->Init();
+        this->Attach();
+    }
+
+    return index_;
+}
+
+void BWAIndexHolder::Invalidate() {
+    // Mappers that are still alive keep their own reference to the old index
+    index_.reset();
+    this->Detach();
+}
+
+void BWAIndexHolder::BinWrite(std::ostream &os) const {
+    VERIFY(index_);
+    index_->BinWrite(os);
+}
+
+void BWAIndexHolder::BinRead(std::istream &is) {
+    index_ = std::make_shared<BWAGraphIndex>(this->g());
+    index_->BinRead(is);
 }
 
 #if 0
@@ -313,6 +395,7 @@ static bool MostlyInVertex(size_t rb, size_t re, size_t edge_len, size_t k) {
 omnigraph::MappingPath<debruijn_graph::EdgeId> BWAIndex::GetMappingPath(const mem_alnreg_v &ar, const std::string &seq,
                                                                         bool only_simple) const {
     omnigraph::MappingPath<debruijn_graph::EdgeId> res;
+    const bwaidx_t *idx = index_->idx();
 
     // Turn read length into k-mers
     bool is_short = false;
@@ -335,7 +418,8 @@ omnigraph::MappingPath<debruijn_graph::EdgeId> BWAIndex::GetMappingPath(const me
             if (size_t(a.re - a.rb) <= g_.k()) continue;
         }
         int is_rev = 0;
-        size_t pos = bns_depos(idx_->bns, a.rb < idx_->bns->l_pac? a.rb : a.re - 1, &is_rev) - idx_->bns->anns[a.rid].offset;
+        size_t pos = bns_depos(idx->bns, a.rb < idx->bns->l_pac? a.rb : a.re - 1, &is_rev) - idx->bns->anns[a.rid].offset;
+        debruijn_graph::EdgeId e = index_->edge(a.rid);
         size_t initial_range_end;
         size_t mapping_range_end;
 
@@ -343,7 +427,7 @@ omnigraph::MappingPath<debruijn_graph::EdgeId> BWAIndex::GetMappingPath(const me
         if (is_short) {
             initial_range_end = a.qb + 1;
             mapping_range_end = pos + 1;
-            if (mapping_range_end > g_.length(ids_[a.rid]))
+            if (mapping_range_end > g_.length(e))
                 continue;
         } else {
             initial_range_end = a.qe - g_.k();
@@ -352,19 +436,19 @@ omnigraph::MappingPath<debruijn_graph::EdgeId> BWAIndex::GetMappingPath(const me
         DEBUG(a);
 //FIXME: what about other scoring systems?
         double qual = double(a.score)/double(a.qe - a.qb);
-        DEBUG("Edge: "<< ids_[a.rid] << " quality from score: " << qual);
+        DEBUG("Edge: "<< e << " quality from score: " << qual);
         
         //Important for alignments shorter than K
-        if (MostlyInVertex(pos, pos + a.re - a.rb, g_.length(ids_[a.rid]), g_.k()))
+        if (MostlyInVertex(pos, pos + a.re - a.rb, g_.length(e), g_.k()))
             continue;
         if (!is_rev) {
-            res.push_back(ids_[a.rid],
+            res.push_back(e,
                           { { (size_t)a.qb, initial_range_end },
                             { pos, mapping_range_end}, qual});
         } else {
-            res.push_back(g_.conjugate(ids_[a.rid]),
+            res.push_back(g_.conjugate(e),
                           { { (size_t)a.qb, initial_range_end }, //.Invert(read_length),
-                            Range(pos,  mapping_range_end).Invert(g_.length(ids_[a.rid])) , qual});
+                            Range(pos,  mapping_range_end).Invert(g_.length(e)) , qual});
 
         }
         if (only_simple && res.size() > 1)
@@ -377,10 +461,11 @@ omnigraph::MappingPath<debruijn_graph::EdgeId> BWAIndex::GetMappingPath(const me
 omnigraph::MappingPath<debruijn_graph::EdgeId> BWAIndex::AlignSequence(const Sequence &sequence,
                                                                        bool only_simple) const {
     omnigraph::MappingPath<debruijn_graph::EdgeId> res;
-    VERIFY(idx_);
+    const bwaidx_t *idx = index_->idx();
+    VERIFY(idx);
 
     std::string seq = sequence.str();
-    mem_alnreg_v ar = mem_align1(memopt_.get(), idx_->bwt, idx_->bns, idx_->pac,
+    mem_alnreg_v ar = mem_align1(memopt_.get(), idx->bwt, idx->bns, idx->pac,
                                  int(seq.length()), seq.data());
     res = GetMappingPath(ar, seq, only_simple);
 
@@ -7,8 +7,12 @@
 #pragma once
 
 #include "assembly_graph/core/graph.hpp"
+#include "assembly_graph/core/action_handlers.hpp"
 #include "assembly_graph/paths/mapping_path.hpp"
 
+#include <memory>
+#include <vector>
+
 extern "C" {
 struct bwaidx_s;
 typedef struct bwaidx_s bwaidx_t;
@@ -23,6 +27,38 @@ typedef struct mem_alnreg_vs mem_alnreg_v;
 
 namespace alignment {
 
+// BWT-based index over all the canonical edges of the graph. It does not
+// depend on the alignment options, so it could be shared between several
+// BWAIndex instances. The index is kept in a single contiguous memory block,
+// so it could be (de)serialized in one go.
+class BWAGraphIndex {
+  public:
+    // bwaidx is incomplete below, therefore we need to outline ctor and dtor.
+    explicit BWAGraphIndex(const debruijn_graph::Graph& g);
+    ~BWAGraphIndex();
+
+    void Init();
+    bool empty() const { return !idx_; }
+    void clear();
+
+    const debruijn_graph::Graph &g() const { return g_; }
+    const bwaidx_t *idx() const { return idx_.get(); }
+    debruijn_graph::EdgeId edge(size_t rid) const { return ids_[rid]; }
+
+    void BinWrite(std::ostream &os) const;
+    void BinRead(std::istream &is);
+
+  private:
+    const debruijn_graph::Graph& g_;
+
+    // hold the full index structure
+    std::unique_ptr<bwaidx_t, void(*)(bwaidx_t*)> idx_;
+
+    std::vector<debruijn_graph::EdgeId> ids_;
+
+    DECL_LOGGER("BWAIndex");
+};
+
 class BWAIndex {
   public:
     enum class AlignmentMode {
@@ -32,15 +68,15 @@ class BWAIndex {
         Ont2D
     };
 
-    // bwaidx / memopt are incomplete below, therefore we need to outline ctor
-    // and dtor.
+    // memopt is incomplete below, therefore we need to outline ctor and dtor.
     BWAIndex(const debruijn_graph::Graph& g, AlignmentMode mode = AlignmentMode::Default);
+    BWAIndex(std::shared_ptr<const BWAGraphIndex> index, AlignmentMode mode = AlignmentMode::Default);
     ~BWAIndex();
 
     omnigraph::MappingPath<debruijn_graph::EdgeId> AlignSequence(const Sequence &sequence,
                                                                  bool only_simple = false) const;
   private:
-    void Init();
+    void InitOptions();
     omnigraph::MappingPath<debruijn_graph::EdgeId> GetMappingPath(const mem_alnreg_v&, const std::string &, bool = false) const;
 
     const debruijn_graph::Graph& g_;
@@ -48,10 +84,7 @@ class BWAIndex {
     // Store the options in memory
     std::unique_ptr<mem_opt_t, void(*)(void*)> memopt_;
 
-    // hold the full index structure
-    std::unique_ptr<bwaidx_t, void(*)(bwaidx_t*)> idx_;
-
-    std::vector<debruijn_graph::EdgeId> ids_;
+    std::shared_ptr<const BWAGraphIndex> index_;
 
     AlignmentMode mode_;
     bool skip_secondary_;
@@ -59,4 +92,31 @@ class BWAIndex {
     DECL_LOGGER("BWAIndex");
 };
 
+// Graph pack component holding the BWA index of the current graph, so all the
+// BWA-based mappers could share it instead of rebuilding. The index is built
+// on demand and is dropped (and the holder is detached) on any change of the
+// graph.
+class BWAIndexHolder : public omnigraph::GraphActionHandler<debruijn_graph::Graph> {
+  public:
+    explicit BWAIndexHolder(const debruijn_graph::Graph &g);
+
+    std::shared_ptr<const BWAGraphIndex> index();
+
+    void HandleAdd(debruijn_graph::EdgeId) override { Invalidate(); }
+    void HandleDelete(debruijn_graph::EdgeId) override { Invalidate(); }
+    void HandleMerge(const std::vector<debruijn_graph::EdgeId> &, debruijn_graph::EdgeId) override { Invalidate(); }
+    void HandleGlue(debruijn_graph::EdgeId, debruijn_graph::EdgeId, debruijn_graph::EdgeId) override { Invalidate(); }
+    void HandleSplit(debruijn_graph::EdgeId, debruijn_graph::EdgeId, debruijn_graph::EdgeId) override { Invalidate(); }
+
+    void BinWrite(std::ostream &os) const;
+    void BinRead(std::istream &is);
+
+  private:
+    void Invalidate();
+
+    std::shared_ptr<BWAGraphIndex> index_;
+
+    DECL_LOGGER("BWAIndex");
+};
+
 }
@@ -22,6 +22,12 @@ public:
             : debruijn_graph::AbstractSequenceMapper<Graph>(g),
             index_(g, mode) {}
 
+    // Use the prebuilt (e.g. owned by graph pack) index
+    explicit BWAReadMapper(std::shared_ptr<const BWAGraphIndex> index,
+                           BWAIndex::AlignmentMode mode = BWAIndex::AlignmentMode::Default)
+            : debruijn_graph::AbstractSequenceMapper<Graph>(index->g()),
+            index_(std::move(index), mode) {}
+
     omnigraph::MappingPath<EdgeId> MapSequence(const Sequence &sequence,
                                                bool only_simple = false) const override {
         return index_.AlignSequence(sequence, only_simple);
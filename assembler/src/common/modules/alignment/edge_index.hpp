@@ -8,6 +8,7 @@
 #pragma once
 
 #include <limits>
+#include <unordered_set>
 #include "assembly_graph/core/graph.hpp"
 #include "assembly_graph/core/action_handlers.hpp"
 #include "assembly_graph/index/edge_info_updater.hpp"
@@ -31,6 +32,7 @@ class EdgeIndex: public omnigraph::GraphActionHandler<Graph> {
     using InnerIndex64 = KmerFreeEdgeIndex<Graph, uint64_t>;
 
     typedef typename Graph::EdgeId EdgeId;
+    typedef typename Graph::VertexId VertexId;
 public:
     typedef RtSeq KMer;
     static constexpr size_t NOT_FOUND = size_t(-1);
@@ -68,6 +70,12 @@ private:
         updater_.DeleteKmers(this->g(), e, *index);
     }
 
+    template<class Index>
+    void Update(Index *index, const std::vector<EdgeId> &deleted, const std::vector<EdgeId> &added) {
+        updater_.Delete(this->g(), *index, deleted);
+        updater_.Update(this->g(), *index, added);
+    }
+
     template<class Index>
     void clear(Index *index) {
         if (!inner_index_)
@@ -141,6 +149,29 @@ public:
         DISPATCH_TO(DeleteKmers, e);
     }
 
+    bool IsDeferrable() const override {
+        return true;
+    }
+
+    /*
+     * The k-mers of the edges which are both added and deleted within the batch are not touched. Every k-mer
+     * belongs to a single edge and the edge ids are not reused till the commit, so deleting the k-mers of the
+     * old edges and then putting the ones of the new edges gives the same index as the sequential updates.
+     */
+    void HandleBatch(const omnigraph::ActionLog<VertexId, EdgeId> &log) override {
+        typedef typename omnigraph::ActionLog<VertexId, EdgeId>::Kind Kind;
+        std::unordered_set<EdgeId> added;
+        std::vector<EdgeId> deleted;
+        for (const auto &event : log) {
+            if (event.kind == Kind::AddEdge)
+                added.insert(event.edge);
+            else if (event.kind == Kind::DeleteEdge && !added.erase(event.edge))
+                deleted.push_back(event.edge);
+        }
+        std::vector<EdgeId> to_add(added.begin(), added.end());
+        DISPATCH_TO(Update, deleted, to_add);
+    }
+
     bool contains(const KMer& kmer) const {
         DISPATCH_TO(contains, kmer);
     }
@@ -12,10 +12,27 @@
 #include <tsl/htrie_map.h>
 #include <boost/iterator/iterator_facade.hpp>
 
+#include <atomic>
+#include <limits>
+#include <vector>
+
 #define XXH_INLINE_ALL
 #include "xxh/xxhash.h"
 
 namespace debruijn_graph {
+/*
+ * Substitution forest over k-mers. Every k-mer seen as a key or as a value is
+ * a node, the k-mers are stored in the arena owned by the map and the trie
+ * holds 32-bit node numbers. A key points to its substitution, the k-mers
+ * without one are the roots. The new keys are linked directly to the root of
+ * the value and the lookups compress the paths in the union-find style, so
+ * the chains stay short without a separate normalization.
+ *
+ * Modifications are not thread-safe. Lookups are lock-free and may run
+ * concurrently with each other (but not with the modifications): the path
+ * compression only changes the parent links, which are accessed atomically.
+ * Pointers returned by find() are invalidated when a new k-mer is inserted.
+ */
 class KMerMap {
     struct str_hash {
         std::size_t operator()(const char* key, std::size_t key_size) const {
@@ -26,21 +43,31 @@ class KMerMap {
     typedef RtSeq Kmer;
     typedef RtSeq Seq;
     typedef typename Seq::DataType RawSeqData;
-    typedef typename tsl::htrie_map<char, RawSeqData*, str_hash> HTMap;
+    typedef uint32_t Slot;
+    typedef typename tsl::htrie_map<char, Slot, str_hash> HTMap;
 
+    // Iterates over the keys together with their roots
     class iterator : public boost::iterator_facade<iterator,
                                                    const std::pair<Kmer, Seq>,
                                                    std::forward_iterator_tag,
                                                    const std::pair<Kmer, Seq>> {
       public:
-        iterator(unsigned k, HTMap::const_iterator iter)
-                : k_(k), iter_(iter) {}
+        iterator(const KMerMap &map, HTMap::const_iterator iter)
+                : map_(&map), iter_(iter) {
+            skip_roots();
+        }
 
       private:
         friend class boost::iterator_core_access;
 
+        void skip_roots() {
+            while (iter_ != map_->nodes_.end() && map_->is_root(iter_.value()))
+                ++iter_;
+        }
+
         void increment() {
             ++iter_;
+            skip_roots();
         }
 
         bool equal(const iterator &other) const {
@@ -49,95 +76,248 @@ class KMerMap {
 
         const std::pair<Kmer, Seq> dereference() const {
             iter_.key(key_out_);
-            Kmer k(k_, (const RawSeqData*)key_out_.data());
-            Seq s(k_, (const RawSeqData*)iter_.value());
+            Kmer k(map_->k_, (const RawSeqData*)key_out_.data());
+            Seq s(map_->k_, map_->kmer(map_->root(iter_.value())));
             return std::make_pair(k, s);
         }
 
-        unsigned k_;
+        const KMerMap *map_;
         HTMap::const_iterator iter_;
         mutable std::string key_out_;
     };
 
   public:
     KMerMap(unsigned k)
-            : k_(k) {
+            : k_(k), size_(0), collect_stats_(false), lookups_(0), chain_steps_(0) {
         rawcnt_ = (unsigned)Seq::GetDataSize(k_);
     }
 
-    ~KMerMap() {
-        clear();
-    }
-
+    // The key becomes a root. The keys whose paths were compressed past it keep their
+    // substitutions, so this is only meant for remapping the k-mer back
     void erase(const Kmer &key) {
-        auto res = mapping_.find_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end())
+        Slot slot = node(key.data());
+        if (slot == NONE || is_root(slot))
             return;
 
-        delete[] res.value();
-        mapping_.erase(res);
+        set_parent(slot, slot);
+        size_ -= 1;
     }
 
     void set(const Kmer &key, const Seq &value) {
-        RawSeqData *rawvalue = nullptr;
-        auto res = mapping_.find_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end()) {
-            rawvalue = new RawSeqData[rawcnt_];
-            mapping_.insert_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData), rawvalue);
-        } else {
-            rawvalue = res.value();
-        }
-        memcpy(rawvalue, value.data(), rawcnt_ * sizeof(RawSeqData));
+        Slot to = root(insert(value.data())), from = insert(key.data());
+        VERIFY_MSG(from != to, "Cyclic k-mer substitution");
+        if (is_root(from))
+            size_ += 1;
+        set_parent(from, to);
     }
 
     bool count(const Kmer &key) const {
-        return mapping_.count_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
+        Slot slot = node(key.data());
+        return slot != NONE && !is_root(slot);
     }
 
+    /**
+     * @return the final substitution of the key or nullptr if there is none
+     */
     const RawSeqData *find(const Kmer &key) const {
-        auto res = mapping_.find_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end())
-            return nullptr;
-
-        return res.value();
+        return find(key.data());
     }
 
     const RawSeqData *find(const RawSeqData *key) const {
-        auto res = mapping_.find_ks((const char*)key, rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end())
+        Slot slot = node(key);
+        if (slot == NONE || is_root(slot))
             return nullptr;
 
-        return res.value();
+        if (!collect_stats_)
+            return kmer(root(slot));
+
+        size_t steps = 0;
+        const RawSeqData *res = kmer(root(slot, &steps));
+        lookups_.fetch_add(1, std::memory_order_relaxed);
+        chain_steps_.fetch_add(steps, std::memory_order_relaxed);
+        return res;
     }
 
     void clear() {
-        // Delete all the values
-        for (auto it = mapping_.begin(); it != mapping_.end(); ++it) {
-            VERIFY(it.value() != nullptr);
-            delete[] it.value();
-            it.value() = nullptr;
+        nodes_.clear();
+        kmers_.clear();
+        parent_.clear();
+        size_ = 0;
+    }
+
+    /**
+     * Compresses all the paths, moves the k-mers to the arena in the order of the
+     * trie and drops the roots nothing points to. Invalidates the pointers
+     * returned by find().
+     */
+    void compact() {
+        size_t nodes = parent_.size();
+        std::vector<bool> used(nodes, false);
+        for (Slot slot = 0; slot < nodes; ++slot) {
+            if (!is_root(slot))
+                used[slot] = used[root(slot)] = true;
         }
 
-        // Delete the mapping and all the keys
-        mapping_.clear();
+        std::vector<Slot> renumber(nodes, Slot(NONE));
+        std::vector<RawSeqData> kmers;
+        kmers.reserve(nodes * rawcnt_);
+        std::vector<std::string> unused;
+        for (auto it = nodes_.begin(); it != nodes_.end(); ++it) {
+            Slot slot = it.value();
+            if (!used[slot]) {
+                unused.push_back(it.key());
+                continue;
+            }
+            renumber[slot] = Slot(kmers.size() / rawcnt_);
+            it.value() = renumber[slot];
+            kmers.insert(kmers.end(), kmer(slot), kmer(slot) + rawcnt_);
+        }
+        for (const auto &key : unused)
+            nodes_.erase_ks(key.data(), key.size());
+
+        std::vector<Slot> parent(kmers.size() / rawcnt_);
+        for (Slot slot = 0; slot < nodes; ++slot) {
+            if (used[slot])
+                parent[renumber[slot]] = renumber[parent_[slot]];
+        }
+        kmers_.swap(kmers);
+        parent_.swap(parent);
     }
 
     size_t size() const {
-        return mapping_.size();
+        return size_;
     }
 
     iterator begin() const {
-        return iterator(k_, mapping_.begin());
+        return iterator(*this, nodes_.begin());
     }
 
     iterator end() const {
-        return iterator(k_, mapping_.end());
+        return iterator(*this, nodes_.end());
+    }
+
+    /**
+     * Turns on counting the links followed by find(). The counters are shared by
+     * all the threads, so this is meant for the diagnostics only.
+     */
+    void collect_stats(bool collect) {
+        collect_stats_ = collect;
+    }
+
+    bool collects_stats() const {
+        return collect_stats_;
+    }
+
+    /**
+     * @return the average number of links followed by find() for the substituted keys
+     */
+    double average_chain_length() const {
+        uint64_t lookups = lookups_.load(std::memory_order_relaxed);
+        return lookups ? double(chain_steps_.load(std::memory_order_relaxed)) / double(lookups) : 0.;
+    }
+
+    void reset_stats() {
+        lookups_ = 0;
+        chain_steps_ = 0;
+    }
+
+    /**
+     * Writes the number of nodes, the arena of the k-mers and the parent links,
+     * each with a single write.
+     */
+    void BinWrite(std::ostream &file) const {
+        size_t nodes = parent_.size();
+        file.write((const char *) &nodes, sizeof(nodes));
+        file.write((const char *) kmers_.data(), kmers_.size() * sizeof(RawSeqData));
+        file.write((const char *) parent_.data(), parent_.size() * sizeof(Slot));
+    }
+
+    void BinRead(std::istream &file) {
+        clear();
+
+        size_t nodes;
+        file.read((char *) &nodes, sizeof(nodes));
+        VERIFY_MSG(nodes < NONE, "Too many k-mers in the map");
+        kmers_.resize(nodes * rawcnt_);
+        file.read((char *) kmers_.data(), kmers_.size() * sizeof(RawSeqData));
+        parent_.resize(nodes);
+        file.read((char *) parent_.data(), parent_.size() * sizeof(Slot));
+
+        for (Slot slot = 0; slot < nodes; ++slot) {
+            nodes_.insert_ks((const char *) kmer(slot), rawcnt_ * sizeof(RawSeqData), slot);
+            if (!is_root(slot))
+                size_ += 1;
+        }
     }
 
   private:
+    static const Slot NONE = std::numeric_limits<Slot>::max();
+
+    const RawSeqData *kmer(Slot slot) const {
+        return kmers_.data() + size_t(slot) * rawcnt_;
+    }
+
+    Slot parent(Slot slot) const {
+        return __atomic_load_n(&parent_[slot], __ATOMIC_RELAXED);
+    }
+
+    void set_parent(Slot slot, Slot parent) const {
+        __atomic_store_n(&parent_[slot], parent, __ATOMIC_RELAXED);
+    }
+
+    bool is_root(Slot slot) const {
+        return parent(slot) == slot;
+    }
+
+    Slot node(const RawSeqData *kmer) const {
+        auto res = nodes_.find_ks((const char*)kmer, rawcnt_ * sizeof(RawSeqData));
+        return res == nodes_.end() ? NONE : res.value();
+    }
+
+    // Finds the node of the k-mer or adds it as a new root
+    Slot insert(const RawSeqData *kmer) {
+        Slot slot = node(kmer);
+        if (slot != NONE)
+            return slot;
+
+        VERIFY_MSG(parent_.size() < NONE, "Too many k-mers in the map");
+        slot = Slot(parent_.size());
+        kmers_.insert(kmers_.end(), kmer, kmer + rawcnt_);
+        parent_.push_back(slot);
+        nodes_.insert_ks((const char*)kmer, rawcnt_ * sizeof(RawSeqData), slot);
+        return slot;
+    }
+
+    // Redirects all the nodes on the path to the root. Concurrent lookups store the same roots
+    Slot root(Slot slot, size_t *steps = nullptr) const {
+        Slot root = slot;
+        size_t length = 0;
+        for (Slot next = parent(root); next != root; next = parent(root)) {
+            root = next;
+            length += 1;
+        }
+        while (slot != root) {
+            Slot next = parent(slot);
+            set_parent(slot, root);
+            slot = next;
+        }
+        if (steps)
+            *steps = length;
+        return root;
+    }
+
     unsigned k_;
     unsigned rawcnt_;
-    HTMap mapping_;
+    HTMap nodes_;
+    // rawcnt_ elements per node
+    std::vector<RawSeqData> kmers_;
+    // Parent links, updated by the lookups as well
+    mutable std::vector<Slot> parent_;
+    // The number of keys, i.e. non-root nodes
+    size_t size_;
+    bool collect_stats_;
+    mutable std::atomic<uint64_t> lookups_;
+    mutable std::atomic<uint64_t> chain_steps_;
 };
 
 }
@@ -15,6 +15,7 @@
 #include "adt/kmer_vector.hpp"
 
 #include <set>
+#include <mutex>
 #include <cstdlib>
 
 namespace debruijn_graph {
@@ -28,7 +29,9 @@ class KmerMapper : public omnigraph::GraphActionHandler<Graph> {
 
     unsigned k_;
     KMerMap mapping_;
-    bool normalized_;
+    // Remappings may come from the concurrent graph modifications. Substitute() does not
+    // lock, so the lookups must not overlap with the remappings
+    std::mutex mutex_;
 
     bool CheckAllDifferent(const Sequence &old_s, const Sequence &new_s) const {
         std::set<Kmer> kmers;
@@ -49,8 +52,7 @@ public:
     KmerMapper(const Graph &g) :
             base(g, "KmerMapper"),
             k_(unsigned(g.k() + 1)),
-            mapping_(k_),
-            normalized_(false) {
+            mapping_(k_) {
     }
 
     virtual ~KmerMapper() {}
@@ -63,31 +65,12 @@ public:
         return mapping_.end();
     }
 
+    /**
+     * Lookups keep the substitution chains short by themselves, this only compresses
+     * all of them at once and compacts the storage for the better locality.
+     */
     void Normalize() {
-        if (normalized_)
-            return;
-
-        adt::KMerVector<Kmer> all(k_, size());
-        for (auto it = begin(); it != end(); ++it)
-            all.push_back(it->first);
-
-        std::vector<const RawSeqData*> roots(all.size(), nullptr);
-
-#       pragma omp parallel for
-        for (size_t i = 0; i < all.size(); ++i) {
-            Seq val(k_, all[i]);
-            roots[i] = GetRoot(val);
-        }
-
-#       pragma omp parallel for
-        for (size_t i = 0; i < all.size(); ++i) {
-            if (roots[i] != nullptr) {
-                Seq kmer(k_, all[i]);
-                mapping_.set(kmer, Seq(k_, roots[i]));
-            }
-        }
-
-        normalized_ = true;
+        mapping_.compact();
     }
 
     unsigned k() const {
@@ -105,6 +88,7 @@ public:
 
     void RemapKmers(const Sequence &old_s, const Sequence &new_s) {
         VERIFY(this->IsAttached());
+        std::lock_guard<std::mutex> lock(mutex_);
         size_t old_length = old_s.size() - k_ + 1;
         size_t new_length = new_s.size() - k_ + 1;
         UniformPositionAligner aligner(old_s.size() - k_ + 1,
@@ -140,7 +124,6 @@ public:
             }
 
             mapping_.set(old_kmer, new_kmer);
-            normalized_ = false;
         }
     }
 
@@ -149,34 +132,14 @@ public:
         RemapKmers(this->g().EdgeNucls(edge1), this->g().EdgeNucls(edge2));
     }
 
-    const RawSeqData* GetRoot(const Kmer &kmer) const {
-        const RawSeqData *answer = nullptr;
-        const RawSeqData *rawval = mapping_.find(kmer);
-
-        while (rawval != nullptr) {
-            Seq val(k_, rawval);
-
-            answer = rawval;
-            rawval = mapping_.find(val);
-        }
-        return answer;
+    bool IsDeferrable() const override {
+        return true;
     }
 
-
     Kmer Substitute(const Kmer &kmer) const {
         VERIFY(this->IsAttached());
-        const auto *rawval = mapping_.find(kmer);
-        if (rawval == nullptr)
-            return kmer;
-
-        const auto *newval = rawval;
-        while (rawval != nullptr) {
-            // VERIFY(answer != val);
-            newval = rawval;
-            rawval = mapping_.find(newval);
-        }
-
-        return Kmer(k_, newval);
+        const auto *root = mapping_.find(kmer);
+        return root ? Kmer(k_, root) : kmer;
     }
 
     bool CanSubstitute(const Kmer &kmer) const {
@@ -184,38 +147,39 @@ public:
     }
 
     void BinWrite(std::ostream &file) const {
-        size_t sz = size();
-        file.write((const char *) &sz, sizeof(sz));
-
-        for (auto iter = begin(); iter != end(); ++iter) {
-            Kmer::BinWrite(file, iter->first);
-            Kmer::BinWrite(file, iter->second);
-        }
+        mapping_.BinWrite(file);
     }
 
     void BinRead(std::istream &file) {
         clear();
-
-        size_t size;
-        file.read((char *) &size, sizeof(size));
-        for (uint32_t i = 0; i < size; ++i) {
-            Kmer key(k_);
-            Seq value(k_);
-            Kmer::BinRead(file, &key);
-            Seq::BinRead(file, &value);
-            mapping_.set(key, value);
-        }
-        normalized_ = false;
+        mapping_.BinRead(file);
     }
 
     void clear() {
-        normalized_ = false;
         return mapping_.clear();
     }
 
     size_t size() const {
         return mapping_.size();
     }
+
+    // Enables counting the substitution links followed by the lookups, for the diagnostics
+    void CollectStats(bool collect) {
+        mapping_.collect_stats(collect);
+    }
+
+    bool CollectsStats() const {
+        return mapping_.collects_stats();
+    }
+
+    // Average number of the substitution links followed per lookup of a remapped k-mer
+    double AverageChainLength() const {
+        return mapping_.average_chain_length();
+    }
+
+    void ResetStats() {
+        mapping_.reset_stats();
+    }
 };
 
 } // namespace debruijn_graph
@@ -0,0 +1,129 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "mapping_cache.hpp"
+
+#include "io/binary/binary.hpp"
+#include "utils/logger/logger.hpp"
+
+namespace debruijn_graph {
+
+namespace {
+constexpr size_t CACHE_BUFFER_SIZE = 1 << 20;
+}
+
+MappingCache::Writer::Writer(const std::string &filename)
+        : buf_(new char[CACHE_BUFFER_SIZE]) {
+    os_.rdbuf()->pubsetbuf(buf_.get(), CACHE_BUFFER_SIZE);
+    os_.open(filename, std::ios::binary | std::ios::trunc);
+    CHECK_FATAL_ERROR(os_.is_open(), "Cannot open mapping cache file " << filename << " for writing");
+}
+
+void MappingCache::Writer::Write(const MappingPath<EdgeId> &path) {
+    using io::binary::BinWrite;
+
+    // Initial ranges go along the read, so store the starts as signed deltas.
+    // The lowest bit of the mapped range length tells whether the mapping
+    // quality differs from the default one.
+    BinWrite(os_, path.size());
+    size_t prev = 0;
+    for (size_t i = 0; i < path.size(); ++i) {
+        const MappingRange &mr = path.mapping_at(i);
+        const Range &ir = mr.initial_range, &er = mr.mapped_range;
+        bool has_quality = (mr.quality != 1.0);
+        BinWrite(os_,
+                 path.edge_at(i),
+                 int64_t(ir.start_pos) - int64_t(prev), ir.size(),
+                 er.start_pos, (er.size() << 1) | has_quality);
+        if (has_quality)
+            BinWrite(os_, mr.quality);
+        prev = ir.start_pos;
+    }
+}
+
+void MappingCache::Writer::Close() {
+    os_.close();
+    CHECK_FATAL_ERROR(!os_.fail(), "I/O error while writing mapping cache");
+}
+
+MappingCache::Reader::Reader(const std::string &filename)
+        : buf_(new char[CACHE_BUFFER_SIZE]) {
+    is_.rdbuf()->pubsetbuf(buf_.get(), CACHE_BUFFER_SIZE);
+    is_.open(filename, std::ios::binary);
+    CHECK_FATAL_ERROR(is_.is_open(), "Cannot open mapping cache file " << filename << " for reading");
+}
+
+MappingPath<EdgeId> MappingCache::Reader::Read() {
+    using io::binary::BinRead;
+
+    size_t sz;
+    BinRead(is_, sz);
+
+    std::vector<EdgeId> edges(sz);
+    std::vector<MappingRange> ranges(sz);
+    size_t prev = 0;
+    for (size_t i = 0; i < sz; ++i) {
+        int64_t delta;
+        size_t ilen, estart, elen;
+        BinRead(is_, edges[i], delta, ilen, estart, elen);
+
+        size_t istart = size_t(int64_t(prev) + delta);
+        double quality = 1.0;
+        if (elen & 1)
+            BinRead(is_, quality);
+        elen >>= 1;
+
+        ranges[i] = MappingRange(istart, istart + ilen, estart, estart + elen, quality);
+        prev = istart;
+    }
+    VERIFY_MSG(is_, "Mapping cache is corrupted");
+
+    return { edges, ranges };
+}
+
+bool MappingCache::Reader::eof() {
+    return is_.peek() == std::ifstream::traits_type::eof();
+}
+
+void MappingCache::Reader::Close() {
+    is_.close();
+}
+
+void MappingCache::StartRecord(size_t stream_count) {
+    VERIFY(!ready_);
+    files_.clear();
+    writers_.clear();
+    for (size_t i = 0; i < stream_count; ++i) {
+        files_.push_back(workdir_->tmp_file("mapping_cache"));
+        writers_.emplace_back(new Writer(files_.back()->file()));
+    }
+}
+
+void MappingCache::StartReplay(size_t stream_count) {
+    VERIFY(ready_);
+    VERIFY_MSG(stream_count == files_.size(),
+               "Mapping cache was recorded for " << files_.size() << " streams, "
+               "but " << stream_count << " streams are to be replayed");
+    readers_.clear();
+    for (const auto &file : files_)
+        readers_.emplace_back(new Reader(file->file()));
+}
+
+void MappingCache::Finish() {
+    for (auto &writer : writers_)
+        writer->Close();
+    writers_.clear();
+
+    for (auto &reader : readers_) {
+        VERIFY_MSG(reader->eof(), "Mapping cache was not replayed completely");
+        reader->Close();
+    }
+    readers_.clear();
+
+    ready_ = true;
+}
+
+}
@@ -0,0 +1,78 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "assembly_graph/core/graph.hpp"
+#include "assembly_graph/paths/mapping_path.hpp"
+#include "utils/filesystem/temporary.hpp"
+
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace debruijn_graph {
+
+using omnigraph::MappingPath;
+using omnigraph::MappingRange;
+
+// On-disk cache of read-to-graph mappings. It is filled during the first pass
+// over the library and replayed during the subsequent passes over the very
+// same read streams, so the reads are mapped only once. Every read stream is
+// stored in a separate file, therefore the streams could be replayed in
+// parallel. Mapping paths are stored as (edge id, delta-coded ranges) using
+// LEB128 encoding.
+class MappingCache {
+  public:
+    class Writer {
+      public:
+        explicit Writer(const std::string &filename);
+        void Write(const MappingPath<EdgeId> &path);
+        void Close();
+
+      private:
+        // Declared before the stream: the stream flushes into it on destruction
+        std::unique_ptr<char[]> buf_;
+        std::ofstream os_;
+    };
+
+    class Reader {
+      public:
+        explicit Reader(const std::string &filename);
+        MappingPath<EdgeId> Read();
+        bool eof();
+        void Close();
+
+      private:
+        std::unique_ptr<char[]> buf_;
+        std::ifstream is_;
+    };
+
+    explicit MappingCache(fs::TmpDir workdir)
+            : workdir_(workdir), ready_(false) {}
+
+    // The cache becomes ready after the first pass is completed
+    bool ready() const { return ready_; }
+    size_t stream_count() const { return files_.size(); }
+
+    void StartRecord(size_t stream_count);
+    void StartReplay(size_t stream_count);
+    void Finish();
+
+    Writer &writer(size_t i) { return *writers_[i]; }
+    Reader &reader(size_t i) { return *readers_[i]; }
+
+  private:
+    fs::TmpDir workdir_;
+    std::vector<fs::TmpFile> files_;
+    std::vector<std::unique_ptr<Writer>> writers_;
+    std::vector<std::unique_ptr<Reader>> readers_;
+    bool ready_;
+
+    DECL_LOGGER("MappingCache");
+};
+
+}
@@ -13,6 +13,30 @@ using namespace std;
 const int DijkstraGraphSequenceBase::SHORT_SEQ_LENGTH;
 const int DijkstraGraphSequenceBase::ED_DEVIATION;
 
+// Workspaces released by the finished runs of the thread
+static thread_local std::vector<std::unique_ptr<DijkstraWorkspace>> workspace_pool;
+
+std::unique_ptr<DijkstraWorkspace> DijkstraGraphSequenceBase::AcquireWorkspace() {
+    if (workspace_pool.empty())
+        return std::unique_ptr<DijkstraWorkspace>(new DijkstraWorkspace());
+
+    auto workspace = std::move(workspace_pool.back());
+    workspace_pool.pop_back();
+    return workspace;
+}
+
+void DijkstraGraphSequenceBase::ReleaseWorkspace(std::unique_ptr<DijkstraWorkspace> workspace) {
+    // The pooled workspaces keep only the bounded bucket arrays
+    workspace->clear();
+    workspace_pool.push_back(std::move(workspace));
+}
+
+DijkstraGraphSequenceBase::~DijkstraGraphSequenceBase() {
+    // Moved-from objects have no workspace
+    if (workspace_)
+        ReleaseWorkspace(std::move(workspace_));
+}
+
 bool DijkstraGraphSequenceBase::IsBetter(int seq_ind, int ed) {
     if (seq_ind == (int) ss_.size() ) {
         if (ed <= path_max_length_) {
@@ -31,22 +55,22 @@ bool DijkstraGraphSequenceBase::IsBetter(int seq_ind, int ed) {
 }
 
 void DijkstraGraphSequenceBase::Update(const QueueState &state, const QueueState &prev_state, int score) {
-    if (visited_.count(state) > 0) {
-        if (visited_[state] >= score) {
+    if (workspace_->visited.count(state) > 0) {
+        if (workspace_->visited[state] >= score) {
             ++ updates_;
-            q_.erase(make_pair(visited_[state], state));
+            workspace_->queue.erase(make_pair(workspace_->visited[state], state));
             if (IsBetter(state.i, score)) {
-                q_.insert(make_pair(score, state));
-                visited_[state] = score;
-                prev_states_[state] = prev_state;
+                workspace_->queue.insert(make_pair(score, state));
+                workspace_->visited[state] = score;
+                workspace_->prev_states[state] = prev_state;
             }
         }
     } else {
         if (IsBetter(state.i, score)) {
             ++ updates_;
-            visited_.insert(make_pair(state, score));
-            prev_states_.insert(make_pair(state, prev_state));
-            q_.insert(make_pair(score, state));
+            workspace_->visited.insert(make_pair(state, score));
+            workspace_->prev_states.insert(make_pair(state, prev_state));
+            workspace_->queue.insert(make_pair(score, state));
         }
     }
 }
@@ -92,7 +116,7 @@ void DijkstraGraphSequenceBase::AddNewEdge(const GraphState &gs, const QueueStat
 }
 
 bool DijkstraGraphSequenceBase::QueueLimitsExceeded(size_t iter) {
-    return_code_.queue_limit = q_.size() > queue_limit_;
+    return_code_.queue_limit = workspace_->queue.size() > queue_limit_;
     return_code_.iter_limit = iter > iter_limit_;
     return return_code_.status;
 }
@@ -102,15 +126,15 @@ bool DijkstraGraphSequenceBase::RunDijkstra() {
     size_t iter = 0;
     QueueState cur_state;
     int ed = 0;
-    while (q_.size() > 0 &&
+    while (workspace_->queue.size() > 0 &&
             !QueueLimitsExceeded(iter) &&
             ed <= path_max_length_ &&
             updates_ < gap_cfg_.updates_limit) {
-        cur_state = q_.begin()->second;
-        ed = visited_[cur_state];
+        cur_state = workspace_->queue.begin()->second;
+        ed = workspace_->visited[cur_state];
         ++ iter;
-        q_.erase(q_.begin());
-        if (visited_.count(end_qstate_) > 0) {
+        workspace_->queue.erase(workspace_->queue.begin());
+        if (workspace_->visited.count(end_qstate_) > 0) {
             found_path = true;
         }
         if (IsEndPosition(cur_state)) {
@@ -136,13 +160,13 @@ void DijkstraGraphSequenceBase::CloseGap() {
     if (found_path) {
         QueueState state(end_qstate_);
         while (!state.empty()) {
-            min_score_ = visited_[end_qstate_];
-            int start_edge = prev_states_[state].i;
+            min_score_ = workspace_->visited[end_qstate_];
+            int start_edge = workspace_->prev_states[state].i;
             int end_edge =  state.i;
             mapping_path_.push_back(state.gs.e,
                                     omnigraph::MappingRange(Range(start_edge, end_edge),
                                             Range(state.gs.start_pos, state.gs.end_pos) ));
-            state = prev_states_[state];
+            state = workspace_->prev_states[state];
         }
         mapping_path_.reverse();
     }
@@ -12,6 +12,8 @@
 #include "sequence/sequence_tools.hpp"
 #include "utils/perf/perfcounter.hpp"
 
+#include <memory>
+
 namespace sensitive_aligner {
 
 using debruijn_graph::EdgeId;
@@ -143,6 +145,31 @@ struct hash<sensitive_aligner::QueueState> {
 
 namespace sensitive_aligner {
 
+// Queue and states of a Dijkstra run, reused by the runs of the same thread:
+// the cleared hash tables keep their buckets, unless there are too many of them
+struct DijkstraWorkspace {
+    std::set<std::pair<int, QueueState>> queue;
+    std::unordered_map<QueueState, int> visited;
+    std::unordered_map<QueueState, QueueState> prev_states;
+
+    void clear() {
+        queue.clear();
+        Clear(visited);
+        Clear(prev_states);
+    }
+
+  private:
+    static const size_t MAX_KEPT_BUCKETS = 1 << 16;
+
+    template<class Map>
+    static void Clear(Map &map) {
+        if (map.bucket_count() > MAX_KEPT_BUCKETS)
+            Map().swap(map);
+        else
+            map.clear();
+    }
+};
+
 class DijkstraGraphSequenceBase {
   public:
     DijkstraGraphSequenceBase(const debruijn_graph::Graph &g,
@@ -158,7 +185,8 @@ class DijkstraGraphSequenceBase {
         , min_score_(std::numeric_limits<int>::max())
         , queue_limit_(gap_cfg_.queue_limit)
         , iter_limit_(gap_cfg_.iteration_limit)
-        , updates_(0) {
+        , updates_(0)
+        , workspace_(AcquireWorkspace()) {
         best_ed_.resize(ss_.size(), path_max_length_);
         AddNewEdge(GraphState(start_e_, start_p_, (int) g_.length(start_e_)), QueueState(), 0);
     }
@@ -198,7 +226,9 @@ class DijkstraGraphSequenceBase {
         return end_qstate_.i;
     }
 
-    ~DijkstraGraphSequenceBase() {}
+    DijkstraGraphSequenceBase(DijkstraGraphSequenceBase &&) = default;
+
+    ~DijkstraGraphSequenceBase();
 
   protected:
     bool IsBetter(int seq_ind, int ed);
@@ -234,14 +264,16 @@ class DijkstraGraphSequenceBase {
     static const int SHORT_SEQ_LENGTH = 100;
     static const int ED_DEVIATION = 20;
 
-    std::set<std::pair<int, QueueState>> q_;
-    std::unordered_map<QueueState, int> visited_;
-    std::unordered_map<QueueState, QueueState> prev_states_;
+    static std::unique_ptr<DijkstraWorkspace> AcquireWorkspace();
+
+    static void ReleaseWorkspace(std::unique_ptr<DijkstraWorkspace> workspace);
+
     std::vector<int> best_ed_;
 
     const size_t queue_limit_;
     const size_t iter_limit_;
     size_t updates_;
+    std::unique_ptr<DijkstraWorkspace> workspace_;
 };
 
 
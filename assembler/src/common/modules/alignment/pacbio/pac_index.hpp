@@ -21,6 +21,8 @@
 #include "modules/alignment/pacbio/pacbio_read_structures.hpp"
 #include "modules/alignment/pacbio/gap_filler.hpp"
 
+#include "adt/concurrent_cache.hpp"
+
 namespace sensitive_aligner {
 
 //TODO:: invent appropriate name, move code to .cpp
@@ -39,6 +41,7 @@ class PacBioMappingIndex {
                        debruijn_graph::config::pacbio_processor pb_config,
                        alignment::BWAIndex::AlignmentMode mode)
         : g_(g),
+          distance_cache_(DISTANCE_CACHE_SIZE),
           pb_config_(pb_config),
           bwa_mapper_(g, mode) {
         DEBUG("PB Mapping Index construction started");
@@ -86,8 +89,16 @@ class PacBioMappingIndex {
 
     static const size_t SHORT_SPURIOUS_LENGTH = 500;
     static const int SIMILARITY_LENGTH = 200;
-    //presumably separate class for this and GetDistance
-    mutable std::map<std::pair<VertexId, VertexId>, size_t> distance_cashed_;
+    static const size_t DISTANCE_CACHE_SIZE = 1 << 22;
+
+    struct VertexPairHash {
+        size_t operator()(const std::pair<VertexId, VertexId> &p) const {
+            return phmap::HashState().combine(0, p.first.int_id(), p.second.int_id());
+        }
+    };
+
+    // Shared by all the aligning threads
+    mutable adt::concurrent_cache<std::pair<VertexId, VertexId>, size_t, VertexPairHash> distance_cache_;
     size_t read_count_;
     debruijn_graph::config::pacbio_processor pb_config_;
 
@@ -357,31 +368,21 @@ class PacBioMappingIndex {
                        bool update_cache = true) const {
         size_t result = size_t(-1);
         auto vertex_pair = std::make_pair(start_v, end_v);
-        bool not_found;
-        auto distance_it = distance_cashed_.begin();
-        //FIXME should permit multiple readers
-        #pragma omp critical(pac_index)
-        {
-            distance_it = distance_cashed_.find(vertex_pair);
-            not_found = (distance_it == distance_cashed_.end());
-        }
-        if (not_found) {
-            omnigraph::DijkstraHelper<debruijn_graph::Graph>::BoundedDijkstra dijkstra(
-                omnigraph::DijkstraHelper<debruijn_graph::Graph>::CreateBoundedDijkstra(g_,
-                        pb_config_.max_path_in_dijkstra,
-                        pb_config_.max_vertex_in_dijkstra));
-            dijkstra.Run(start_v);
-            if (dijkstra.DistanceCounted(end_v)) {
-                result = dijkstra.GetDistance(end_v);
-            }
-            if (update_cache) {
-                #pragma omp critical(pac_index)
-                distance_cashed_.insert({vertex_pair, result});
-            }
-        } else {
+        if (distance_cache_.find(vertex_pair, result)) {
             TRACE("taking from cashed");
-            result = distance_it->second;
+            return result;
+        }
+
+        omnigraph::DijkstraHelper<debruijn_graph::Graph>::BoundedDijkstra dijkstra(
+            omnigraph::DijkstraHelper<debruijn_graph::Graph>::CreateBoundedDijkstra(g_,
+                    pb_config_.max_path_in_dijkstra,
+                    pb_config_.max_vertex_in_dijkstra));
+        dijkstra.Run(start_v);
+        if (dijkstra.DistanceCounted(end_v)) {
+            result = dijkstra.GetDistance(end_v);
         }
+        if (update_cache)
+            distance_cache_.insert(vertex_pair, result);
 
         return result;
     }
@@ -10,6 +10,8 @@
 #include "io/reads/paired_read.hpp"
 #include "io/reads/read_stream_vector.hpp"
 
+#include "utils/parallel/openmp_wrapper.h"
+
 namespace debruijn_graph {
 
 SequenceMapperNotifier::SequenceMapperNotifier(const GraphPack& gp, size_t lib_count)
@@ -35,20 +37,44 @@ void SequenceMapperNotifier::NotifyStopProcessLibrary(size_t ilib) const {
 void SequenceMapperNotifier::NotifyMergeBuffer(size_t ilib, size_t ithread) const {
     std::string thread_str = std::to_string(ithread);
     TIME_TRACE_SCOPE("SequenceMapperNotifier::MergeBuffer", thread_str);
-    for (const auto& listener : listeners_[ilib])
-        listener->MergeBuffer(ithread);
+    for (const auto& listener : listeners_[ilib]) {
+        if (!listener->HasMergeableBuffers())
+            listener->MergeBuffer(ithread);
+    }
+}
+
+void SequenceMapperNotifier::NotifyReduceBuffers(size_t ilib, size_t thread_count) const {
+    std::vector<SequenceMapperListener*> listeners;
+    for (const auto& listener : listeners_[ilib]) {
+        if (listener->HasMergeableBuffers())
+            listeners.push_back(listener);
+    }
+    if (listeners.empty())
+        return;
+
+    TIME_TRACE_SCOPE("SequenceMapperNotifier::ReduceBuffers");
+    // Buffers i and i + step are merged into i, the buffer 0 gets everything in the end
+    for (size_t step = 1; step < thread_count; step *= 2) {
+        size_t end = thread_count - step;
+        #pragma omp parallel for num_threads(thread_count) schedule(dynamic)
+        for (size_t i = 0; i < end; i += 2 * step) {
+            for (const auto& listener : listeners)
+                listener->MergeBuffers(i, i + step);
+        }
+    }
+
+    for (const auto& listener : listeners)
+        listener->MergeBuffer(0);
 }
 
 template<>
 void SequenceMapperNotifier::NotifyProcessRead(const io::PairedReadSeq& r,
-                                               const SequenceMapperT& mapper,
+                                               MappingSource& source,
                                                size_t ilib,
                                                size_t ithread) const
 {
-    const Sequence& read1 = r.first().sequence();
-    const Sequence& read2 = r.second().sequence();
-    MappingPath<EdgeId> path1 = mapper.MapSequence(read1);
-    MappingPath<EdgeId> path2 = mapper.MapSequence(read2);
+    MappingPath<EdgeId> path1 = source(r.first());
+    MappingPath<EdgeId> path2 = source(r.second());
     for (const auto& listener : listeners_[ilib]) {
         listener->ProcessPairedRead(ithread, r, path1, path2);
         listener->ProcessSingleRead(ithread, r.first(), path1);
@@ -58,12 +84,12 @@ void SequenceMapperNotifier::NotifyProcessRead(const io::PairedReadSeq& r,
 
 template<>
 void SequenceMapperNotifier::NotifyProcessRead(const io::PairedRead& r,
-                                               const SequenceMapperT& mapper,
+                                               MappingSource& source,
                                                size_t ilib,
                                                size_t ithread) const
 {
-    MappingPath<EdgeId> path1 = mapper.MapRead(r.first());
-    MappingPath<EdgeId> path2 = mapper.MapRead(r.second());
+    MappingPath<EdgeId> path1 = source(r.first());
+    MappingPath<EdgeId> path2 = source(r.second());
     for (const auto& listener : listeners_[ilib]) {
         listener->ProcessPairedRead(ithread, r, path1, path2);
         listener->ProcessSingleRead(ithread, r.first(), path1);
@@ -73,23 +99,22 @@ void SequenceMapperNotifier::NotifyProcessRead(const io::PairedRead& r,
 
 template<>
 void SequenceMapperNotifier::NotifyProcessRead(const io::SingleReadSeq& r,
-                                               const SequenceMapperT& mapper,
+                                               MappingSource& source,
                                                size_t ilib,
                                                size_t ithread) const
 {
-    const Sequence& read = r.sequence();
-    MappingPath<EdgeId> path = mapper.MapSequence(read);
+    MappingPath<EdgeId> path = source(r);
     for (const auto& listener : listeners_[ilib])
         listener->ProcessSingleRead(ithread, r, path);
 }
 
 template<>
 void SequenceMapperNotifier::NotifyProcessRead(const io::SingleRead& r,
-                                               const SequenceMapperT& mapper,
+                                               MappingSource& source,
                                                size_t ilib,
                                                size_t ithread) const
 {
-    MappingPath<EdgeId> path = mapper.MapRead(r);
+    MappingPath<EdgeId> path = source(r);
     for (const auto& listener : listeners_[ilib])
         listener->ProcessSingleRead(ithread, r, path);
 }
@@ -9,6 +9,7 @@
 #define SEQUENCE_MAPPER_NOTIFIER_HPP_
 
 #include "sequence_mapper.hpp"
+#include "mapping_cache.hpp"
 
 #include "assembly_graph/paths/mapping_path.hpp"
 #include "assembly_graph/core/graph.hpp"
@@ -17,6 +18,8 @@
 
 #include "utils/perf/timetracer.hpp"
 
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -36,12 +39,24 @@ public:
     virtual void ProcessSingleRead(size_t /* thread_index */, const io::SingleReadSeq& /* r */, const MappingPath<EdgeId>& /* read */) {}
 
     virtual void MergeBuffer(size_t /* thread_index */) {}
-    
+
+    // Listeners returning true here are never asked to merge the buffers while the
+    // library is being processed. Instead, the buffers are merged pairwise via
+    // MergeBuffers() as a parallel tree reduction at the end, and the only remaining
+    // buffer is merged via MergeBuffer(0).
+    virtual bool HasMergeableBuffers() const { return false; }
+
+    // Merges the buffer of src thread into the one of dst thread. Could be called
+    // concurrently for different pairs of threads.
+    virtual void MergeBuffers(size_t /* dst_thread */, size_t /* src_thread */) {}
+
     virtual ~SequenceMapperListener() {}
 };
 
 class SequenceMapperNotifier {
     static constexpr size_t BUFFER_SIZE = 200000;
+    // The number of reads to process before the next attempt to merge the buffer
+    static constexpr size_t MERGE_RETRY = 1024;
 public:
     typedef SequenceMapper<Graph> SequenceMapperT;
 
@@ -51,61 +66,115 @@ public:
 
     void Subscribe(size_t lib_index, SequenceMapperListener* listener);
 
+    // If cache is provided, the mappings are recorded into it during the first
+    // pass and replayed from it (without invoking the mapper) afterwards. The
+    // same set of read streams must be used for all the passes.
     template<class ReadType>
     void ProcessLibrary(io::ReadStreamList<ReadType>& streams,
-                        size_t lib_index, const SequenceMapperT& mapper, size_t threads_count = 0) {
+                        size_t lib_index, const SequenceMapperT& mapper, size_t threads_count = 0,
+                        MappingCache *cache = nullptr) {
         std::string lib_str = std::to_string(lib_index);
         TIME_TRACE_SCOPE("SequenceMapperNotifier::ProcessLibrary", lib_str);
         if (threads_count == 0)
             threads_count = streams.size();
 
         streams.reset();
+        if (cache) {
+            if (cache->ready()) {
+                INFO("Replaying cached read mappings");
+                cache->StartReplay(streams.size());
+            } else
+                cache->StartRecord(streams.size());
+        }
         NotifyStartProcessLibrary(lib_index, threads_count);
-        size_t counter = 0, n = 15;
+        std::atomic<size_t> counter{0};
+        size_t n = 15;
+        // Buffers are merged by one thread at a time. Other threads do not wait for
+        // the merge, they continue processing the reads and try again later.
+        std::mutex merge_mutex;
 
-        #pragma omp parallel for num_threads(threads_count) shared(counter)
+        #pragma omp parallel for num_threads(threads_count) shared(counter, n, merge_mutex)
         for (size_t i = 0; i < streams.size(); ++i) {
-            size_t size = 0;
+            size_t size = 0, merge_at = BUFFER_SIZE;
             ReadType r;
             auto& stream = streams[i];
+            MappingSource source(mapper, cache, i);
             while (!stream.eof()) {
-                if (size == BUFFER_SIZE) {
-                    #pragma omp critical
-                    {
+                if (size >= merge_at) {
+                    std::unique_lock<std::mutex> lock(merge_mutex, std::try_to_lock);
+                    if (lock.owns_lock()) {
                         counter += size;
                         if (counter >> n) {
-                            INFO("Processed " << counter << " reads");
+                            INFO("Processed " << counter.load() << " reads");
                             n += 1;
                         }
                         size = 0;
+                        merge_at = BUFFER_SIZE;
                         NotifyMergeBuffer(lib_index, i);
-                    }
+                    } else
+                        merge_at = size + MERGE_RETRY;
                 }
                 stream >> r;
                 ++size;
-                NotifyProcessRead(r, mapper, lib_index, i);
+                NotifyProcessRead(r, source, lib_index, i);
             }
-            #pragma omp atomic
             counter += size;
         }
 
+        if (cache)
+            cache->Finish();
+
         for (size_t i = 0; i < threads_count; ++i)
             NotifyMergeBuffer(lib_index, i);
+        NotifyReduceBuffers(lib_index, threads_count);
 
-        INFO("Total " << counter << " reads processed");
+        INFO("Total " << counter.load() << " reads processed");
         NotifyStopProcessLibrary(lib_index);
     }
 
 private:
+    // Provides mappings of the reads from a single stream either via mapper
+    // or via the mapping cache
+    class MappingSource {
+      public:
+        MappingSource(const SequenceMapperT &mapper, MappingCache *cache, size_t stream)
+                : mapper_(mapper),
+                  writer_(cache && !cache->ready() ? &cache->writer(stream) : nullptr),
+                  reader_(cache && cache->ready() ? &cache->reader(stream) : nullptr) {}
+
+        template<class ReadType>
+        MappingPath<EdgeId> operator()(const ReadType &r) {
+            if (reader_)
+                return reader_->Read();
+
+            MappingPath<EdgeId> path = Map(r);
+            if (writer_)
+                writer_->Write(path);
+            return path;
+        }
+
+      private:
+        MappingPath<EdgeId> Map(const io::SingleRead &r) const { return mapper_.MapRead(r); }
+        MappingPath<EdgeId> Map(const io::SingleReadSeq &r) const { return mapper_.MapSequence(r.sequence()); }
+
+        const SequenceMapperT &mapper_;
+        MappingCache::Writer *writer_;
+        MappingCache::Reader *reader_;
+    };
+
     template<class ReadType>
-    void NotifyProcessRead(const ReadType& r, const SequenceMapperT& mapper, size_t ilib, size_t ithread) const;
+    void NotifyProcessRead(const ReadType& r, MappingSource &source, size_t ilib, size_t ithread) const;
 
     void NotifyStartProcessLibrary(size_t ilib, size_t thread_count) const;
 
     void NotifyStopProcessLibrary(size_t ilib) const;
 
+    // Merges the buffer of the thread for the listeners without mergeable buffers
     void NotifyMergeBuffer(size_t ilib, size_t ithread) const;
 
+    // Reduces the buffers of all the threads for the listeners with mergeable buffers
+    void NotifyReduceBuffers(size_t ilib, size_t thread_count) const;
+
     const GraphPack& gp_;
 
     std::vector<std::vector<SequenceMapperListener*> > listeners_;  //first vector's size = count libs
@@ -17,6 +17,7 @@
 #include "assembly_graph/graph_support/scaff_supplementary.hpp"
 
 #include <cmath>
+#include <functional>
 
 namespace path_extend {
 
@@ -401,6 +402,11 @@ public:
             return;
         }
 
+        // Visited cycles are kept per extender, so they could not be passed
+        // from the speculative extension to the main extenders
+        if (!SpeculationLog::WriteLocal(visited_cycles_coverage_map_.graph(), path, pos))
+            return;
+
         auto p = path_storage_.CreatePair(path.SubPath(pos));
 
         visited_cycles_coverage_map_.Subscribe(p);
@@ -424,20 +430,32 @@ protected:
 
 
 class CompositeExtender {
+public:
+    // Creates the same set of extenders working with another coverage map and
+    // used edges storage
+    typedef std::function<std::vector<std::shared_ptr<PathExtender>>(const GraphCoverageMap&,
+                                                                     UsedUniqueStorage&)> ExtendersFactory;
+
 private:
     bool MakeGrowStep(BidirectionalPath& path, PathContainer* paths_storage);
     void GrowAllPaths(PathContainer& paths, PathContainer& result);
+    void GrowAllPathsSpeculatively(PathContainer& paths, PathContainer& result, unsigned nthreads);
 
 public:
     CompositeExtender(const Graph &g, GraphCoverageMap& cov_map,
                       UsedUniqueStorage &unique,
-                      const std::vector<std::shared_ptr<PathExtender>> &pes)
+                      const std::vector<std::shared_ptr<PathExtender>> &pes,
+                      ExtendersFactory factory = nullptr)
             : g_(g),
               cover_map_(cov_map),
               used_storage_(unique),
-              extenders_(pes) {}
+              extenders_(pes),
+              factory_(std::move(factory)) {}
 
-    void GrowAll(PathContainer& paths, PathContainer& result);
+    // Seeds are extended in parallel if the factory is provided. The
+    // resulting paths are the same as in the single-threaded mode.
+    void GrowAll(PathContainer& paths, PathContainer& result, unsigned nthreads = 1);
+    void GrowSeed(const BidirectionalPath& seed, PathContainer& result);
     void GrowPath(BidirectionalPath& path, PathContainer* paths_storage) {
         while (MakeGrowStep(path, paths_storage)) { }
     }
@@ -447,6 +465,7 @@ private:
     GraphCoverageMap &cover_map_;
     UsedUniqueStorage &used_storage_;
     std::vector<std::shared_ptr<PathExtender>> extenders_;
+    ExtendersFactory factory_;
 };
 
 
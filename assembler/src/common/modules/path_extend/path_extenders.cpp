@@ -7,11 +7,79 @@
 
 #include "path_extender.hpp"
 
+#include "utils/parallel/openmp_wrapper.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
 namespace path_extend {
 
-void CompositeExtender::GrowAll(PathContainer& paths, PathContainer& result) {
+namespace {
+
+// Extension of a single seed made on top of the state of the main extender.
+// All the changes are kept aside, so they could be either committed or thrown
+// away.
+struct SeedExtension {
+    SeedExtension()
+            : log(/*speculative*/true) {}
+
+    PathContainer paths;
+    UsedUniqueStorage::PathEdges marks;
+    SpeculationLog log;
+};
+
+class SpeculativeExtender {
+public:
+    SpeculativeExtender(const Graph &g,
+                        const GraphCoverageMap &cover_map, const UsedUniqueStorage &used_storage,
+                        const CompositeExtender::ExtendersFactory &factory)
+            : cover_map_(GraphCoverageMap::Overlay(cover_map)),
+              used_storage_(UsedUniqueStorage::Overlay(used_storage)),
+              extender_(g, cover_map_, used_storage_, factory(cover_map_, used_storage_)) {}
+
+    std::unique_ptr<SeedExtension> Extend(const BidirectionalPath &seed) {
+        auto res = std::make_unique<SeedExtension>();
+        {
+            SpeculationLog::Scope scope(res->log);
+            extender_.GrowSeed(seed, res->paths);
+        }
+        res->marks = used_storage_.TakeMarks();
+        cover_map_.Clear();
+
+        return res;
+    }
+
+private:
+    GraphCoverageMap cover_map_;
+    UsedUniqueStorage used_storage_;
+    CompositeExtender extender_;
+};
+
+bool ReadsAny(const SeedExtension &extension, const std::unordered_set<EdgeId> &edges) {
+    for (EdgeId e : extension.log.reads()) {
+        if (edges.count(e))
+            return true;
+    }
+    return false;
+}
+
+void ReportProgress(size_t i, size_t total) {
+    VERBOSE_POWER_T2(i, 100, "Processed " << i << " paths from " << total << " (" << i * 100 / total << "%)");
+    if (total > 10 && i % (total / 10 + 1) == 0) {
+        INFO("Processed " << i << " paths from " << total << " (" << i * 100 / total << "%)");
+    }
+}
+
+const size_t SPECULATION_BATCH_PER_THREAD = 64;
+
+}
+
+void CompositeExtender::GrowAll(PathContainer& paths, PathContainer& result, unsigned nthreads) {
     result.clear();
-    GrowAllPaths(paths, result);
+    if (nthreads > 1 && factory_)
+        GrowAllPathsSpeculatively(paths, result, nthreads);
+    else
+        GrowAllPaths(paths, result);
     result.FilterEmptyPaths();
 }
 
@@ -29,50 +97,137 @@ bool CompositeExtender::MakeGrowStep(BidirectionalPath& path, PathContainer* pat
     return false;
 }
 
+void CompositeExtender::GrowSeed(const BidirectionalPath& seed, PathContainer& result) {
+    //In 2015 modes do not use a seed already used in paths.
+    //FIXME what is the logic here?
+    if (used_storage_.UniqueCheckEnabled()) {
+        bool was_used = false;
+        for (size_t ind =0; ind < seed.Size(); ind++) {
+            EdgeId eid = seed.At(ind);
+            auto path_id = seed.GetId();
+            if (used_storage_.IsUsedAndUnique(eid, path_id)) {
+                DEBUG("Used edge " << g_.int_id(eid));
+                was_used = true;
+                break;
+            } else {
+                used_storage_.insert(eid, path_id);
+            }
+        }
+        if (was_used) {
+            DEBUG("skipping already used seed");
+            return;
+        }
+    }
+
+    if (!cover_map_.IsCovered(seed)) {
+        BidirectionalPath &path = CreatePath(result, cover_map_, seed);
+
+        size_t count_trying = 0;
+        size_t current_path_len = 0;
+        do {
+            current_path_len = path.Length();
+            count_trying++;
+            GrowPath(path, &result);
+            GrowPath(*path.GetConjPath(), &result);
+        } while (count_trying < 10 && (path.Length() != current_path_len));
+            DEBUG("result path " << path.GetId());
+            path.PrintDEBUG();
+    }
+}
+
 void CompositeExtender::GrowAllPaths(PathContainer& paths, PathContainer& result) {
     for (size_t i = 0; i < paths.size(); ++i) {
-        VERBOSE_POWER_T2(i, 100, "Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
-        if (paths.size() > 10 && i % (paths.size() / 10 + 1) == 0) {
-            INFO("Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
-        }
-        //In 2015 modes do not use a seed already used in paths.
-        //FIXME what is the logic here?
-        if (used_storage_.UniqueCheckEnabled()) {
-            bool was_used = false;
-            const BidirectionalPath &p = paths.Get(i);
-            for (size_t ind =0; ind < p.Size(); ind++) {
-                EdgeId eid = p.At(ind);
-                auto path_id = p.GetId();
-                if (used_storage_.IsUsedAndUnique(eid, path_id)) {
-                    DEBUG("Used edge " << g_.int_id(eid));
-                    was_used = true;
-                    break;
-                } else {
-                    used_storage_.insert(eid, path_id);
+        ReportProgress(i, paths.size());
+        GrowSeed(paths.Get(i), result);
+    }
+}
+
+// Seeds are processed in batches. First, all the seeds of the batch are
+// extended in parallel on top of the state left by the previous batches. Then
+// the extensions are committed in seed order. An extension is valid if it has
+// not looked at the edges covered or used by the seeds committed earlier in the
+// same batch, otherwise the seed is extended again on top of the up-to-date
+// state. Therefore the result does not depend on the number of threads.
+void CompositeExtender::GrowAllPathsSpeculatively(PathContainer& paths, PathContainer& result,
+                                                  unsigned nthreads) {
+    INFO("Extending seeds speculatively using " << nthreads << " threads");
+    std::vector<std::unique_ptr<SpeculativeExtender>> workers;
+    for (unsigned i = 0; i < nthreads; ++i)
+        workers.push_back(std::make_unique<SpeculativeExtender>(g_, cover_map_, used_storage_, factory_));
+
+    // Edges of the IS cycles visited by the main extenders. These are never
+    // seen by the speculative extenders.
+    std::unordered_set<EdgeId> local_changes;
+    size_t redone = 0, serial = 0;
+
+    size_t start = 0;
+    while (start < paths.size()) {
+        size_t end = std::min(paths.size(), start + nthreads * SPECULATION_BATCH_PER_THREAD);
+        std::vector<std::unique_ptr<SeedExtension>> extensions(end - start);
+
+#       pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+        for (size_t i = start; i < end; ++i)
+            extensions[i - start] = workers[omp_get_thread_num()]->Extend(paths.Get(i));
+
+        // Edges covered or used by the seeds committed in this batch
+        std::unordered_set<EdgeId> changes;
+        size_t i = start;
+        while (i < end) {
+            ReportProgress(i, paths.size());
+            auto &extension = extensions[i - start];
+            if (extension->log.failed() || ReadsAny(*extension, changes) || ReadsAny(*extension, local_changes)) {
+                redone += 1;
+                extension = workers.front()->Extend(paths.Get(i));
+            }
+
+            if (extension->log.failed() || ReadsAny(*extension, local_changes)) {
+                // Extension changes the state of the extenders, so it could
+                // be done by the main ones only. Their changes are not
+                // tracked, so the rest of the batch is to be extended again.
+                SpeculationLog log(/*speculative*/false);
+                {
+                    SpeculationLog::Scope scope(log);
+                    GrowSeed(paths.Get(i), result);
                 }
+                local_changes.insert(log.local_writes().begin(), log.local_writes().end());
+                serial += 1;
+                i += 1;
+                break;
             }
-            if (was_used) {
-                DEBUG("skipping already used seed");
-                continue;
+
+            std::unordered_map<size_t, size_t> path_ids;
+            bool first = true;
+            for (auto it = extension->paths.begin(); it != extension->paths.end(); ++it) {
+                auto ppair = result.AddPair(BidirectionalPath::clone(it.get()),
+                                            BidirectionalPath::clone(it.getConjugate()));
+                path_ids[it.get().GetId()] = ppair.first.GetId();
+                path_ids[it.getConjugate().GetId()] = ppair.second.GetId();
+                // Only the path grown from the seed is registered in coverage map
+                if (first) {
+                    cover_map_.Subscribe(ppair);
+                    for (size_t j = 0; j < ppair.first.Size(); ++j) {
+                        changes.insert(ppair.first.At(j));
+                        changes.insert(ppair.second.At(j));
+                    }
+                    first = false;
+                }
             }
-        }
 
-        if (!cover_map_.IsCovered(paths.Get(i))) {
-            BidirectionalPath &path = CreatePath(result, cover_map_,
-                                                 paths.Get(i));
-
-            size_t count_trying = 0;
-            size_t current_path_len = 0;
-            do {
-                current_path_len = path.Length();
-                count_trying++;
-                GrowPath(path, &result);
-                GrowPath(*path.GetConjPath(), &result);
-            } while (count_trying < 10 && (path.Length() != current_path_len));
-                DEBUG("result path " << path.GetId());
-                path.PrintDEBUG();
+            used_storage_.AddMarks(extension->marks, [&](size_t id) {
+                auto entry = path_ids.find(id);
+                return entry == path_ids.end() ? id : entry->second;
+            });
+            for (const auto &entry : extension->marks)
+                changes.insert(entry.second.begin(), entry.second.end());
+
+            extension.reset();
+            i += 1;
         }
+
+        start = i;
     }
+
+    INFO("Seeds extended again: " << redone << ", extended by the main extenders: " << serial);
 }
 
 bool LoopDetectingPathExtender::TryUseEdge(BidirectionalPath &path, EdgeId e, const Gap &gap) {
@@ -47,9 +47,10 @@ PathContainer PathExtendResolver::MakeSimpleSeeds() const {
     return edges;
 }
 
-PathContainer PathExtendResolver::ExtendSeeds(PathContainer &seeds, CompositeExtender &composite_extender) const {
+PathContainer PathExtendResolver::ExtendSeeds(PathContainer &seeds, CompositeExtender &composite_extender,
+                                              unsigned nthreads) const {
     PathContainer paths;
-    composite_extender.GrowAll(seeds, paths);
+    composite_extender.GrowAll(seeds, paths, nthreads);
     return paths;
 }
 
@@ -27,7 +27,8 @@ public:
             : g_(g), k_(g.k()) {}
     
     PathContainer MakeSimpleSeeds() const;
-    PathContainer ExtendSeeds(PathContainer &seeds, CompositeExtender &composite_extender) const;
+    PathContainer ExtendSeeds(PathContainer &seeds, CompositeExtender &composite_extender,
+                              unsigned nthreads = 1) const;
 
     //Paths should be deduplicated first!
     void RemoveOverlaps(PathContainer &paths, GraphCoverageMap &coverage_map,
@@ -19,6 +19,71 @@ namespace path_extend {
 
 using namespace debruijn_graph;
 
+// Accesses of the current thread to the state shared between the seeds during
+// path extension. Speculative extension (i.e. the one made ahead of the
+// preceding seeds) records all the edges it has looked at, so it could be
+// checked later that none of them was changed by the preceding seeds. Changes
+// of the extender-local state could not be passed from speculative extension
+// to the main extenders, so they are rejected and recorded in serial mode.
+class SpeculationLog {
+public:
+    explicit SpeculationLog(bool speculative)
+            : speculative_(speculative), failed_(false) {}
+
+    class Scope {
+    public:
+        explicit Scope(SpeculationLog &log)
+                : prev_(current()) {
+            current() = &log;
+        }
+
+        ~Scope() {
+            current() = prev_;
+        }
+
+    private:
+        SpeculationLog *prev_;
+    };
+
+    static void Read(EdgeId e) {
+        SpeculationLog *log = current();
+        if (log && log->speculative_)
+            log->reads_.push_back(e);
+    }
+
+    // Returns false if the extender-local state must not be changed
+    static bool WriteLocal(const Graph &g, const BidirectionalPath &path, size_t from) {
+        SpeculationLog *log = current();
+        if (!log)
+            return true;
+        if (log->speculative_) {
+            log->failed_ = true;
+            return false;
+        }
+
+        for (size_t i = from; i < path.Size(); ++i) {
+            log->local_writes_.push_back(path.At(i));
+            log->local_writes_.push_back(g.conjugate(path.At(i)));
+        }
+        return true;
+    }
+
+    bool failed() const { return failed_; }
+    const std::vector<EdgeId> &reads() const { return reads_; }
+    const std::vector<EdgeId> &local_writes() const { return local_writes_; }
+
+private:
+    static SpeculationLog *&current() {
+        static thread_local SpeculationLog *log = nullptr;
+        return log;
+    }
+
+    bool speculative_;
+    bool failed_;
+    std::vector<EdgeId> reads_;
+    std::vector<EdgeId> local_writes_;
+};
+
 // Handles all paths in PathContainer.
 // For each edge output all paths  that _traverse_ this path. If path contains multiple instances - count them. Position of the edge is not reported.
 class GraphCoverageMap: public PathListener {
@@ -31,6 +96,9 @@ private:
     phmap::parallel_flat_hash_map<EdgeId, MapDataT> edge_coverage_;
     const MapDataT empty_;
 
+    // Read-only map the current one is laid over, see Overlay()
+    const GraphCoverageMap *base_;
+
     void EdgeAdded(EdgeId e, BidirectionalPath &path) {
         edge_coverage_[e][&path] += 1;
     }
@@ -66,7 +134,8 @@ public:
 
     GraphCoverageMap(GraphCoverageMap&&) = default;
 
-    explicit GraphCoverageMap(const Graph& g) : g_(g) {
+    explicit GraphCoverageMap(const Graph& g)
+            : g_(g), base_(nullptr) {
         //FIXME heavy constructor
         edge_coverage_.reserve(g_.e_size());
     }
@@ -78,6 +147,20 @@ public:
 
     ~GraphCoverageMap() {}
 
+    // Creates an empty map laid over the base one: the lookups take the paths
+    // of both maps into account, while the new paths are added only here.
+    // Base map must not be changed while the overlay is in use.
+    static GraphCoverageMap Overlay(const GraphCoverageMap &base) {
+        GraphCoverageMap res(base.g_);
+        res.base_ = &base;
+        return res;
+    }
+
+    // Forgets all the paths (but not the ones of the base map)
+    void Clear() {
+        edge_coverage_.clear();
+    }
+
     void AddPaths(const PathContainer& paths, bool subscribe = false) {
         for (auto &path_pair : paths) {
             ProcessPath(*path_pair.first, subscribe);
@@ -114,26 +197,38 @@ public:
         EdgeRemoved(e, path);
     }
 
-    const MapDataT &GetEdgePaths(EdgeId e) const {
-        auto iter = edge_coverage_.find(e);
-        if (iter != edge_coverage_.end()) {
-            return iter->second;
-        }
-        return empty_;
+    // Returned by value: the overlay merges the paths of the base map in, and
+    // the lookups might come from several threads
+    MapDataT GetEdgePaths(EdgeId e) const {
+        SpeculationLog::Read(e);
+        const MapDataT &paths = OwnEdgePaths(e);
+        if (!base_)
+            return paths;
+
+        MapDataT res = base_->GetEdgePaths(e);
+        if (res.empty())
+            return paths;
+
+        res.insert(paths.begin(), paths.end());
+        return res;
     }
 
     size_t Count(EdgeId e, const BidirectionalPath &path) const {
+        SpeculationLog::Read(e);
+        size_t res = (base_ ? base_->Count(e, path) : 0);
         auto entry = edge_coverage_.find(e);
         if (entry == edge_coverage_.end())
-            return 0;
+            return res;
 
         auto cov = entry->second.find(const_cast<BidirectionalPath*>(&path));
-        return (cov == entry->second.end() ? 0 : cov->second);
+        return res + (cov == entry->second.end() ? 0 : cov->second);
     }
 
     size_t GetCoverage(EdgeId e) const {
+        SpeculationLog::Read(e);
+        size_t res = (base_ ? base_->GetCoverage(e) : 0);
         auto iter = edge_coverage_.find(e);
-        return (iter != edge_coverage_.end() ? iter->second.size() : 0);
+        return res + (iter != edge_coverage_.end() ? iter->second.size() : 0);
     }
 
     bool IsCovered(EdgeId e) const {
@@ -149,7 +244,11 @@ public:
     }
 
     BidirectionalPathSet GetCoveringPaths(EdgeId e) const {
+        SpeculationLog::Read(e);
         BidirectionalPathSet res;
+        if (base_)
+            res = base_->GetCoveringPaths(e);
+
         auto iter = edge_coverage_.find(e);
         if (iter == edge_coverage_.end())
             return res;
@@ -160,6 +259,7 @@ public:
         return res;
     }
 
+    // Iteration and size do not take the base map into account
     auto begin() const {
         return edge_coverage_.begin();
     }
@@ -176,6 +276,14 @@ public:
         return g_;
     }
 
+private:
+    const MapDataT &OwnEdgePaths(EdgeId e) const {
+        auto iter = edge_coverage_.find(e);
+        if (iter != edge_coverage_.end()) {
+            return iter->second;
+        }
+        return empty_;
+    }
 };
 
 // Result -- first edge is loop's back edge, second is loop exit edge
@@ -319,7 +319,7 @@ void PathExtendLauncher::AddScaffUniqueStorage(size_t uniqe_edge_len) {
     additional_edge_analyzer.FillUniqueEdgeStorage(unique_data_.unique_storages_.back());
 }
 
-Extenders PathExtendLauncher::ConstructMPExtenders(const ExtendersGenerator &generator) {
+void PathExtendLauncher::FillMPUniqueEdgeStorages() {
     const pe_config::ParamSetT &pset = params_.pset;
 
     size_t cur_length = unique_data_.min_unique_length_ - pset.scaffolding2015.unique_length_step;
@@ -334,8 +334,6 @@ Extenders PathExtendLauncher::ConstructMPExtenders(const ExtendersGenerator &gen
         INFO("Will add final extenders for length " << lower_bound);
         AddScaffUniqueStorage(lower_bound);
     }
-
-    return generator.MakeMPExtenders();
 }
 
 void PathExtendLauncher::FillPathContainer(size_t lib_index, size_t size_threshold) {
@@ -407,28 +405,17 @@ void  PathExtendLauncher::FillPBUniqueEdgeStorages() {
     INFO(unique_data_.unique_pb_storage_.size() << " unique edges");
 }
 
-Extenders PathExtendLauncher::ConstructPBExtenders(const ExtendersGenerator &generator) {
-    FillPBUniqueEdgeStorages();
-    return generator.MakePBScaffoldingExtenders();
-}
-
-
-Extenders PathExtendLauncher::ConstructExtenders(const GraphCoverageMap &cover_map,
-                                                 UsedUniqueStorage &used_unique_storage) {
+void PathExtendLauncher::PrepareExtenders() {
     INFO("Creating main extenders, unique edge length = " << unique_data_.min_unique_length_);
     if (!config::PipelineHelper::IsPlasmidPipeline(params_.mode) &&  (support_.SingleReadsMapped() || support_.HasLongReads()))
         FillLongReadsCoverageMaps();
-    ExtendersGenerator generator(dataset_info_, params_, gp_, cover_map,
-                                 unique_data_, used_unique_storage, support_);
-    Extenders extenders = generator.MakeBasicExtenders();
 
     //long reads scaffolding extenders.
-
     if (!config::PipelineHelper::IsPlasmidPipeline(params_.mode) && support_.HasLongReads()) {
         if (params_.pset.sm == scaffolding_mode::sm_old) {
             INFO("Will not use new long read scaffolding algorithm in this mode");
         } else {
-            utils::push_back_all(extenders, ConstructPBExtenders(generator));
+            FillPBUniqueEdgeStorages();
         }
     }
 
@@ -436,14 +423,27 @@ Extenders PathExtendLauncher::ConstructExtenders(const GraphCoverageMap &cover_m
         if (params_.pset.sm == scaffolding_mode::sm_old) {
             INFO("Will not use mate-pairs is this mode");
         } else {
-            utils::push_back_all(extenders, ConstructMPExtenders(generator));
+            FillMPUniqueEdgeStorages();
         }
     }
+}
+
+Extenders PathExtendLauncher::MakeExtenders(const GraphCoverageMap &cover_map,
+                                            UsedUniqueStorage &used_unique_storage) const {
+    ExtendersGenerator generator(dataset_info_, params_, gp_, cover_map,
+                                 unique_data_, used_unique_storage, support_);
+    Extenders extenders = generator.MakeBasicExtenders();
+
+    if (!config::PipelineHelper::IsPlasmidPipeline(params_.mode) && support_.HasLongReads() &&
+        params_.pset.sm != scaffolding_mode::sm_old)
+        utils::push_back_all(extenders, generator.MakePBScaffoldingExtenders());
+
+    if (support_.HasMPReads() && params_.pset.sm != scaffolding_mode::sm_old)
+        utils::push_back_all(extenders, generator.MakeMPExtenders());
 
     if (params_.pset.use_coordinated_coverage)
         utils::push_back_all(extenders, generator.MakeCoverageExtenders());
 
-    INFO("Total number of extenders is " << extenders.size());
     return extenders;
 }
 
@@ -627,12 +627,18 @@ void PathExtendLauncher::Launch() {
 
     GraphCoverageMap cover_map(graph_);
     UsedUniqueStorage used_unique_storage(unique_data_.main_unique_storage_, graph_);
-    Extenders extenders = ConstructExtenders(cover_map, used_unique_storage);
+    PrepareExtenders();
+    Extenders extenders = MakeExtenders(cover_map, used_unique_storage);
+    INFO("Total number of extenders is " << extenders.size());
+    // Extra sets of extenders are used to extend the seeds in parallel
     CompositeExtender composite_extender(graph_, cover_map,
                                          used_unique_storage,
-                                         extenders);
+                                         extenders,
+                                         [this](const GraphCoverageMap &cover_map, UsedUniqueStorage &used_unique_storage) {
+                                             return MakeExtenders(cover_map, used_unique_storage);
+                                         });
 
-    auto paths = resolver.ExtendSeeds(seeds, composite_extender);
+    auto paths = resolver.ExtendSeeds(seeds, composite_extender, cfg::get().max_threads);
     DebugOutputPaths(paths, "raw_paths");
 
     RemoveOverlapsAndArtifacts(paths, cover_map, resolver);
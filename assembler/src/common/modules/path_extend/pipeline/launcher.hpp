@@ -70,13 +70,14 @@ class PathExtendLauncher {
 
     void PolishPaths(const PathContainer &paths, PathContainer &result, const GraphCoverageMap &cover_map) const;
 
-    Extenders ConstructExtenders(const GraphCoverageMap &cover_map, UsedUniqueStorage &used_unique_storage);
+    // Fills all the storages required by the extenders
+    void PrepareExtenders();
 
-    Extenders ConstructMPExtenders(const ExtendersGenerator &generator);
+    Extenders MakeExtenders(const GraphCoverageMap &cover_map, UsedUniqueStorage &used_unique_storage) const;
 
-    void AddScaffUniqueStorage(size_t uniqe_edge_len);
+    void FillMPUniqueEdgeStorages();
 
-    Extenders ConstructPBExtenders(const ExtendersGenerator &generator);
+    void AddScaffUniqueStorage(size_t uniqe_edge_len);
 
     void FilterPaths();
 
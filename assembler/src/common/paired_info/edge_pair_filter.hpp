@@ -0,0 +1,39 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "adt/bf.hpp"
+
+#define XXH_INLINE_ALL
+#include "xxh/xxhash.h"
+
+#include <cstdint>
+#include <utility>
+
+namespace omnigraph {
+
+namespace de {
+
+// Both edges go into every digest: the blocked filter takes the block from the
+// digest with seed 0, so it must not depend on the first edge only
+template<class EdgeId>
+struct EdgePairFilterHasher {
+    static const uint64_t SALT = 0x9E3779B97F4A7C15ull;
+
+    uint64_t operator()(const std::pair<EdgeId, EdgeId> &ep, uint64_t seed) const {
+        uint64_t h[2] = { ep.first.hash(), ep.second.hash() };
+        return XXH3_64bits_withSeed(h, sizeof(h), seed + SALT);
+    }
+};
+
+template<class EdgeId>
+using EdgePairFilter = bf::blocked_counting_bloom_filter<std::pair<EdgeId, EdgeId>, 2,
+                                                         EdgePairFilterHasher<EdgeId>>;
+
+}
+
+}
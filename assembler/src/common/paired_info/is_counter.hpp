@@ -73,6 +73,15 @@ public:
         tmp_hists_[thread_index].clear();
     }
 
+    bool HasMergeableBuffers() const override { return true; }
+
+    void MergeBuffers(size_t dst_thread, size_t src_thread) override {
+        for (const auto& kv: tmp_hists_[src_thread])
+            tmp_hists_[dst_thread][kv.first] += kv.second;
+
+        tmp_hists_[src_thread].clear();
+    }
+
     void FindMean(double& mean, double& delta, std::map<size_t, size_t>& percentiles) const {
         find_mean(hist_, mean, delta, percentiles);
     }
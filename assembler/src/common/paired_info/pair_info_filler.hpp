@@ -8,7 +8,7 @@
 #ifndef PAIR_INFO_FILLER_HPP_
 #define PAIR_INFO_FILLER_HPP_
 
-#include "paired_info/concurrent_pair_info_buffer.hpp"
+#include "paired_info/sharded_pair_info_buffer.hpp"
 #include "modules/alignment/sequence_mapper_notifier.hpp"
 
 namespace debruijn_graph {
@@ -31,36 +31,38 @@ public:
               buffer_pi_(graph),
               round_distance_(round_distance) {}
 
-    void StartProcessLibrary(size_t) override {
+    void StartProcessLibrary(size_t threads_count) override {
         DEBUG("Start processing: start");
-        buffer_pi_.clear();
+        buffer_pi_.Reset(threads_count);
         DEBUG("Start processing: end");
     }
 
     void StopProcessLibrary() override {
         // paired_index_.Merge(buffer_pi_);
+        buffer_pi_.Reduce();
         paired_index_.MoveAssign(buffer_pi_);
         buffer_pi_.clear();
     }
     
-    void ProcessPairedRead(size_t,
+    void ProcessPairedRead(size_t thread_index,
                            const io::PairedRead& r,
                            const MappingPath<EdgeId>& read1,
                            const MappingPath<EdgeId>& read2) override {
-        ProcessPairedRead(read1, read2, r.distance());
+        ProcessPairedRead(thread_index, read1, read2, r.distance());
     }
 
-    void ProcessPairedRead(size_t,
+    void ProcessPairedRead(size_t thread_index,
                            const io::PairedReadSeq& r,
                            const MappingPath<EdgeId>& read1,
                            const MappingPath<EdgeId>& read2) override {
-        ProcessPairedRead(read1, read2, r.distance());
+        ProcessPairedRead(thread_index, read1, read2, r.distance());
     }
 
     virtual ~LatePairedIndexFiller() {}
 
 private:
-    void ProcessPairedRead(const MappingPath<EdgeId>& path1,
+    void ProcessPairedRead(size_t thread_index,
+                           const MappingPath<EdgeId>& path1,
                            const MappingPath<EdgeId>& path2, size_t read_distance) {
         for (size_t i = 0; i < path1.size(); ++i) {
             std::pair<EdgeId, MappingRange> mapping_edge_1 = path1[i];
@@ -84,7 +86,7 @@ private:
                     if (round_distance_ > 1)
                         edge_distance = int(std::round(edge_distance / double(round_distance_))) * round_distance_;
 
-                    buffer_pi_.Add(mapping_edge_1.first, mapping_edge_2.first,
+                    buffer_pi_.Add(thread_index, mapping_edge_1.first, mapping_edge_2.first,
                                    omnigraph::de::RawPoint(edge_distance, weight));
 
                 }
@@ -95,7 +97,7 @@ private:
 private:
     WeightF weight_f_;
     omnigraph::de::UnclusteredPairedInfoIndexT<Graph>& paired_index_;
-    omnigraph::de::ConcurrentPairedInfoBuffer<Graph> buffer_pi_;
+    omnigraph::de::ShardedPairedInfoBuffer<Graph> buffer_pi_;
     unsigned round_distance_;
 
     DECL_LOGGER("LatePairedIndexFiller");
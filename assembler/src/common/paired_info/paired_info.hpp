@@ -649,6 +649,10 @@ public:
 
         }
     }
+
+    bool IsDeferrable() const override {
+        return true;
+    }
 };
 
 /**
@@ -0,0 +1,299 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "histogram.hpp"
+#include "histptr.hpp"
+#include "paired_info.hpp"
+#include "paired_info_buffer.hpp"
+
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/verify.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace omnigraph {
+
+namespace de {
+
+/**
+ * @brief Paired info buffer which does not synchronize the insertions at all. Every thread appends the points
+ *        into its own set of shards, edge pairs are distributed between the shards by the hash of the first edge.
+ *        The points are turned into histograms only by Reduce(), which processes the shards in parallel:
+ *        the points of a shard are radix-sorted by the edge pair and then collapsed. Until then the buffer
+ *        is not accessible.
+ */
+template<typename G, typename Traits, template<typename, typename> class Container>
+class ShardedPairedBuffer : public PairedBufferBase<ShardedPairedBuffer<G, Traits, Container>,
+                                                    G, Traits> {
+    typedef ShardedPairedBuffer<G, Traits, Container> self;
+    typedef PairedBufferBase<self, G, Traits> base;
+
+  protected:
+    using typename base::InnerPoint;
+    typedef omnigraph::de::Histogram<InnerPoint> InnerHistogram;
+    typedef omnigraph::de::StrongWeakPtr<InnerHistogram> InnerHistPtr;
+
+  public:
+    using typename base::Graph;
+    using typename base::EdgeId;
+    using typename base::EdgePair;
+    using typename base::Point;
+
+    typedef Container<EdgeId, InnerHistPtr> InnerMap;
+    typedef Container<EdgeId, InnerMap> StorageMap;
+
+  private:
+    // Point of the canonical edge pair
+    struct Record {
+        EdgeId e1, e2;
+        InnerPoint p;
+    };
+    typedef std::vector<Record> Records;
+
+    // Non-owning reference to the histogram of the conjugate pair
+    struct View {
+        EdgeId e1, e2;
+        typename InnerHistPtr::pointer hist;
+    };
+
+    struct ThreadShards {
+        std::vector<Records> shards;
+        size_t size;
+        size_t compact_threshold;
+    };
+
+    // Thread shards are collapsed as soon as they get larger, so the memory
+    // consumption is bounded by the number of distinct points
+    static const size_t MIN_COMPACT_THRESHOLD = 1 << 20;
+    static const size_t SHARDS_PER_THREAD = 4;
+
+  public:
+    ShardedPairedBuffer(const Graph &g, size_t nthreads = 1)
+            : base(g) {
+        Reset(nthreads);
+    }
+
+    //---------------- Data inserting methods ----------------
+
+    /**
+     * @brief Adds a point between two edges. Could be called concurrently for different threads.
+     */
+    void Add(size_t thread, EdgeId e1, EdgeId e2, Point p) {
+        VERIFY(thread < threads_.size());
+        InnerPoint sp = Traits::Shrink(p, this->CalcOffset(e1));
+        EdgePair ep = this->MinMaxConjugatePair({ e1, e2 }).first;
+
+        ThreadShards &thread_shards = *threads_[thread];
+        Records &shard = thread_shards.shards[ShardOf(ep.first)];
+        shard.push_back({ ep.first, ep.second, sp });
+        thread_shards.size += 1;
+        if (this->IsSelfConj(e1, e2)) { // This would double the weight of self-conjugate pairs
+            shard.push_back({ ep.first, ep.second, sp });
+            thread_shards.size += 1;
+        }
+
+        if (thread_shards.size > thread_shards.compact_threshold)
+            Compact(thread_shards);
+    }
+
+    /**
+     * @brief Turns the points added so far into the histograms. No insertions are allowed after that.
+     */
+    void Reduce() {
+        size_t nshards = shards_.size();
+        std::vector<std::vector<std::vector<View>>> views(nshards, std::vector<std::vector<View>>(nshards));
+        std::vector<size_t> sizes(nshards, 0);
+
+        // First, collect the points of every shard and create the histograms
+        // for the canonical pairs
+#       pragma omp parallel for schedule(dynamic) num_threads(threads_.size())
+        for (size_t i = 0; i < nshards; ++i)
+            sizes[i] = ReduceShard(i, views[i]);
+
+        // Second, add the histograms of the conjugate pairs. These belong to
+        // the shards of the conjugate edges
+#       pragma omp parallel for schedule(dynamic) num_threads(threads_.size())
+        for (size_t i = 0; i < nshards; ++i) {
+            for (size_t j = 0; j < nshards; ++j) {
+                for (const View &view : views[j][i]) {
+                    auto res = shards_[i][view.e1].insert(std::make_pair(view.e2, InnerHistPtr(view.hist, /* owning */ false)));
+                    VERIFY_MSG(res.second, "Index insertion inconsistency");
+                }
+                std::vector<View>().swap(views[j][i]);
+            }
+        }
+
+        for (size_t i = 0; i < nshards; ++i) {
+            for (auto &entry : shards_[i])
+                storage_[entry.first] = std::move(entry.second);
+            shards_[i].clear();
+            this->size_ += sizes[i];
+        }
+    }
+
+    //---------------- Miscellaneous ----------------
+
+    /**
+     * @brief Clears the whole buffer.
+     */
+    void clear() {
+        Reset(threads_.size());
+    }
+
+    /**
+     * @brief Clears the whole buffer and prepares it for the insertions from the given number of threads.
+     */
+    void Reset(size_t nthreads) {
+        VERIFY(nthreads > 0);
+        storage_.clear();
+        this->size_ = 0;
+
+        threads_.clear();
+        for (size_t i = 0; i < nthreads; ++i) {
+            threads_.emplace_back(new ThreadShards());
+            threads_.back()->shards.resize(nthreads * SHARDS_PER_THREAD);
+            threads_.back()->size = 0;
+            threads_.back()->compact_threshold = MIN_COMPACT_THRESHOLD;
+        }
+        shards_ = std::vector<StorageMap>(nthreads * SHARDS_PER_THREAD);
+    }
+
+    typename StorageMap::locked_table lock_table() {
+        return storage_.lock_table();
+    }
+
+  private:
+    size_t ShardOf(EdgeId e) const {
+        uint64_t h = uint64_t(this->graph().int_id(e)) * 0x9E3779B97F4A7C15ull;
+        return size_t(h >> 32) % shards_.size();
+    }
+
+    uint64_t Key(EdgeId e) const {
+        return uint64_t(this->graph().int_id(e));
+    }
+
+    // LSD radix sort by edge pair, the bytes which are the same for all the
+    // records are skipped
+    void RadixSort(Records &records) const {
+        if (records.size() < 2)
+            return;
+
+        uint64_t first_mask = 0, second_mask = 0;
+        for (const Record &r : records) {
+            first_mask |= Key(r.e1);
+            second_mask |= Key(r.e2);
+        }
+
+        Records tmp(records.size());
+        for (unsigned pass = 0; pass < 16; ++pass) {
+            bool second = (pass < 8);
+            unsigned shift = 8 * (pass % 8);
+            if (((second ? second_mask : first_mask) >> shift) == 0)
+                continue;
+
+            auto digit = [&](const Record &r) {
+                return size_t((Key(second ? r.e2 : r.e1) >> shift) & 0xFF);
+            };
+
+            size_t counts[256] = {};
+            for (const Record &r : records)
+                counts[digit(r)] += 1;
+            if (counts[digit(records.front())] == records.size())
+                continue;
+
+            size_t pos = 0;
+            for (size_t &count : counts) {
+                size_t c = count;
+                count = pos;
+                pos += c;
+            }
+            for (const Record &r : records)
+                tmp[counts[digit(r)]++] = r;
+            records.swap(tmp);
+        }
+    }
+
+    // Sorts the records and merges the points with the same distance
+    void Collapse(Records &records) const {
+        RadixSort(records);
+
+        size_t res = 0;
+        for (size_t i = 0; i < records.size(); ) {
+            size_t j = i + 1;
+            while (j < records.size() && records[j].e1 == records[i].e1 && records[j].e2 == records[i].e2)
+                ++j;
+
+            std::sort(records.begin() + i, records.begin() + j,
+                      [](const Record &a, const Record &b) { return a.p.d < b.p.d; });
+            size_t start = res;
+            for (size_t k = i; k < j; ++k) {
+                if (res > start && records[res - 1].p.d == records[k].p.d)
+                    records[res - 1].p += records[k].p;
+                else
+                    records[res++] = records[k];
+            }
+            i = j;
+        }
+        records.resize(res);
+    }
+
+    void Compact(ThreadShards &thread_shards) const {
+        thread_shards.size = 0;
+        for (Records &shard : thread_shards.shards) {
+            Collapse(shard);
+            thread_shards.size += shard.size();
+        }
+        thread_shards.compact_threshold = 2 * thread_shards.size;
+        if (thread_shards.compact_threshold < MIN_COMPACT_THRESHOLD)
+            thread_shards.compact_threshold = MIN_COMPACT_THRESHOLD;
+    }
+
+    // Returns the number of points added
+    size_t ReduceShard(size_t shard, std::vector<std::vector<View>> &views) {
+        Records records;
+        for (auto &thread_shards : threads_) {
+            Records &part = thread_shards->shards[shard];
+            records.insert(records.end(), part.begin(), part.end());
+            Records().swap(part);
+        }
+        Collapse(records);
+
+        size_t added = 0;
+        StorageMap &storage = shards_[shard];
+        for (size_t i = 0; i < records.size(); ) {
+            EdgeId e1 = records[i].e1, e2 = records[i].e2;
+            auto hist = new InnerHistogram();
+            for (; i < records.size() && records[i].e1 == e1 && records[i].e2 == e2; ++i)
+                hist->merge_point(records[i].p);
+            storage[e1].insert(std::make_pair(e2, InnerHistPtr(hist, /* owning */ true)));
+
+            bool selfconj = this->IsSelfConj(e1, e2);
+            added += (selfconj ? hist->size() : 2 * hist->size());
+            if (!selfconj) {
+                EdgePair conj = this->ConjugatePair(e1, e2);
+                views[ShardOf(conj.first)].push_back({ conj.first, conj.second, hist });
+            }
+        }
+
+        return added;
+    }
+
+  protected:
+    std::vector<std::unique_ptr<ThreadShards>> threads_;
+    std::vector<StorageMap> shards_;
+    StorageMap storage_;
+};
+
+template<class Graph>
+using ShardedPairedInfoBuffer = ShardedPairedBuffer<Graph, RawPointTraits, btree_map>;
+
+} // namespace de
+
+} // namespace omnigraph
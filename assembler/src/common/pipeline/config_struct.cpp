@@ -17,6 +17,8 @@
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Support/FileSystem.h"
 
+#include <boost/algorithm/string.hpp>
+
 #include <string>
 #include <vector>
 #include <common/io/binary/binary.hpp>
@@ -220,6 +222,27 @@ void load(debruijn_config::construction& con,
     load(con.read_buffer_size, pt, "read_buffer_size", complete);
     load(con.read_cov_threshold, pt, "read_cov_threshold", complete);
 
+    // Optional, set by the pipeline for the first iteration only
+    if (pt.find("precount_k") != pt.not_found()) {
+        std::vector<std::string> ks;
+        std::string precount_k = pt.get<std::string>("precount_k");
+        boost::split(ks, precount_k, boost::is_any_of(",; "), boost::token_compress_on);
+        con.precount_k.clear();
+        for (const auto &k : ks) {
+            if (!k.empty())
+                con.precount_k.push_back(unsigned(std::stoul(k)));
+        }
+    }
+    // Optional, set by the pipeline for the next iterations
+    load(con.use_precounted, pt, "use_precounted", false);
+
+    // Optional, the defaults are the plain shared counters
+    load(con.coverage_cache_size, pt, "coverage_cache_size", false);
+    load(con.coverage_replicas, pt, "coverage_replicas", false);
+    CHECK_FATAL_ERROR(!(con.coverage_cache_size & (con.coverage_cache_size - 1)),
+                      "coverage_cache_size must be zero or a power of two, got " << con.coverage_cache_size);
+    CHECK_FATAL_ERROR(con.coverage_replicas > 0, "coverage_replicas must be positive");
+
     con.read_buffer_size *= 1024 * 1024;
     load(con.early_tc, pt, "early_tip_clipper", complete);
 }
@@ -305,10 +305,21 @@ struct debruijn_config {
         bool keep_perfect_loops;
         unsigned read_cov_threshold;
         size_t read_buffer_size;
+        // K of the next iterations which k+1-mers are counted during the same pass over the reads
+        std::vector<unsigned> precount_k;
+        // Whether the k+1-mers counted by the first iteration are taken
+        bool use_precounted;
+        // Per-thread cache of the k-mer coverage counts (entries, 0 to disable) and the number
+        // of the copies of the counters, see utils::CoverageHashMapBuilder
+        size_t coverage_cache_size;
+        unsigned coverage_replicas;
         construction() :
                 keep_perfect_loops(true),
                 read_cov_threshold(0),
-                read_buffer_size(0) {}
+                read_buffer_size(0),
+                use_precounted(false),
+                coverage_cache_size(0),
+                coverage_replicas(1) {}
     };
 
     simplification simp;
@@ -12,6 +12,7 @@
 #include "assembly_graph/handlers/edges_position_handler.hpp"
 #include "assembly_graph/paths/bidirectional_path_container.hpp"
 #include "common/modules/alignment/rna/ss_coverage.hpp"
+#include "modules/alignment/bwa_index.hpp"
 #include "modules/alignment/edge_index.hpp"
 #include "modules/alignment/kmer_mapper.hpp"
 #include "modules/alignment/long_read_storage.hpp"
@@ -42,6 +43,7 @@ GraphPack::GraphPack(size_t k, const std::string &workdir, size_t lib_count,
     emplace<EdgeQuality<Graph>>(g);
     emplace<EdgesPositionHandler<Graph>>(g, max_mapping_gap + k, max_gap_diff);
     emplace<ConnectedComponentCounter>(g);
+    emplace<alignment::BWAIndexHolder>(g);
     emplace_with_key<path_extend::PathContainer>("exSPAnder paths");
     if (detach_indices)
         DetachAll();
@@ -74,9 +76,12 @@ void GraphPack::EnsureBasicMapping() {
 
     VERIFY(kmer_mapper.IsAttached());
     EnsureIndex();
-    INFO("Normalizing k-mer map. Total " << kmer_mapper.size() << " kmers to process");
+    INFO("Compacting k-mer map. Total " << kmer_mapper.size() << " kmers");
+    if (kmer_mapper.CollectsStats())
+        INFO("Average substitution chain length " << kmer_mapper.AverageChainLength());
     kmer_mapper.Normalize();
-    INFO("Normalizing done");
+    kmer_mapper.ResetStats();
+    INFO("Compacting done");
 }
 
 void GraphPack::EnsureQuality() {
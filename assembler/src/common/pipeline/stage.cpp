@@ -84,6 +84,11 @@ class PhaseIdComparator {
     const char* id_;
 };
 
+bool CompositeStageBase::IsPhaseCheckpoint(const std::string &checkpoint) const {
+    size_t len = strlen(id());
+    return checkpoint.compare(0, len, id()) == 0 && checkpoint.size() > len && checkpoint[len] == ':';
+}
+
 void CompositeStageBase::run(debruijn_graph::GraphPack& gp,
                              const char* started_from) {
     // The logic here is as follows. By this time StageManager already called
@@ -92,8 +97,21 @@ void CompositeStageBase::run(debruijn_graph::GraphPack& gp,
     // function. Phases are supposed only to load the differences.
     VERIFY(parent_);
     init(gp, started_from);
+    const SavesPolicy &saves_policy = parent_->saves_policy();
     auto start_phase = phases_.begin();
-    if (started_from &&
+    std::string last_saves = (started_from && strcmp(started_from, "last") == 0 ?
+                              saves_policy.GetLastCheckpoint() : "");
+    if (IsPhaseCheckpoint(last_saves)) {
+        // The starting phase is RIGHT AFTER the last saved one
+        auto last_phase = std::find_if(phases_.begin(), phases_.end(), PhaseIdComparator(last_saves.c_str()));
+        if (last_phase == phases_.end()) {
+            ERROR("Invalid phase checkpoint: " << last_saves);
+            exit(-1);
+        }
+        TIME_TRACE_SCOPE("load phase", last_saves);
+        (*last_phase)->load(gp, saves_policy.LoadPath(), last_saves.c_str());
+        start_phase = std::next(last_phase);
+    } else if (started_from &&
         strstr(started_from, ":") &&
         started_from == strstr(started_from, id())) {
         start_phase = std::find_if(phases_.begin(), phases_.end(), PhaseIdComparator(started_from));
@@ -107,7 +125,7 @@ void CompositeStageBase::run(debruijn_graph::GraphPack& gp,
             composite_id += ":";
             composite_id += prev_phase->id();
             TIME_TRACE_SCOPE("load phase", composite_id);
-            prev_phase->load(gp, parent_->saves_policy().LoadPath(), composite_id.c_str());
+            prev_phase->load(gp, saves_policy.LoadPath(), composite_id.c_str());
         }
     }
 
@@ -120,15 +138,24 @@ void CompositeStageBase::run(debruijn_graph::GraphPack& gp,
             phase->run(gp, started_from);
         }
 
-        if (parent_->saves_policy().EnabledCheckpoints() != SavesPolicy::Checkpoints::None) {
+        // The last phase is not saved, the whole stage is saved right after it
+        if (saves_policy.EnabledCheckpoints() != SavesPolicy::Checkpoints::None &&
+            std::next(start_phase) != et) {
             std::string composite_id(id());
             composite_id += ":";
             composite_id += phase->id();
 
-            TIME_TRACE_SCOPE("save phase", composite_id);
-            phase->save(gp, parent_->saves_policy().SavesPath(), composite_id.c_str());
-            //TODO: currently no phases are writing saves.
-            //When they will, erase the previous saves when SavesPolicy::Last
+            auto prev_saves = saves_policy.GetLastCheckpoint();
+            {
+                TIME_TRACE_SCOPE("save phase", composite_id);
+                phase->save(gp, saves_policy.SavesPath(), composite_id.c_str());
+            }
+            saves_policy.UpdateCheckpoint(composite_id.c_str());
+            // Saves of the previous stage are kept, they are needed to resume
+            // from the phase checkpoint
+            if (IsPhaseCheckpoint(prev_saves) && saves_policy.EnabledCheckpoints() == SavesPolicy::Checkpoints::Last) {
+                fs::remove_if_exists(fs::append_path(saves_policy.SavesPath(), prev_saves));
+            }
         }
     }
 
@@ -153,7 +180,8 @@ void StageManager::run(debruijn_graph::GraphPack& g,
                     WARN("Nothing to continue");
                     return;
                 }
-                start_stage = std::next(last_stage);
+                // The checkpoint of the phase: the stage continues from the next phase
+                start_stage = (strstr(last_saves.c_str(), ":") ? last_stage : std::next(last_stage));
             } else {
                 WARN("No saved checkpoint");
             }
@@ -183,6 +211,7 @@ void StageManager::run(debruijn_graph::GraphPack& g,
         AssemblyStage *stage = start_stage->get();
 
         INFO("STAGE == " << stage->name() << " (id: " << stage->id() << ")");
+        auto prev_saves = saves_policy_.GetLastCheckpoint();
         stage->prepare(g, start_from);        
         {
             TIME_TRACE_SCOPE(stage->name());
@@ -190,14 +219,18 @@ void StageManager::run(debruijn_graph::GraphPack& g,
         }
 
         if (saves_policy_.EnabledCheckpoints() != SavesPolicy::Checkpoints::None) {
-            auto prev_saves = saves_policy_.GetLastCheckpoint();
+            // Composite stages might have saved some of their phases
+            auto phase_saves = saves_policy_.GetLastCheckpoint();
             {
                 TIME_TRACE_SCOPE("save", saves_policy_.SavesPath());
                 stage->save(g, saves_policy_.SavesPath());
             }
             saves_policy_.UpdateCheckpoint(stage->id());
-            if (!prev_saves.empty() && saves_policy_.EnabledCheckpoints() == SavesPolicy::Checkpoints::Last) {
-                fs::remove_if_exists(fs::append_path(saves_policy_.SavesPath(), prev_saves));
+            if (saves_policy_.EnabledCheckpoints() == SavesPolicy::Checkpoints::Last) {
+                for (const auto &saves : { prev_saves, phase_saves }) {
+                    if (!saves.empty() && saves != stage->id())
+                        fs::remove_if_exists(fs::append_path(saves_policy_.SavesPath(), saves));
+                }
             }
         }
     }
@@ -86,6 +86,8 @@ public:
     void run(debruijn_graph::GraphPack &gp, const char * = nullptr);
 
 private:
+    bool IsPhaseCheckpoint(const std::string &checkpoint) const;
+
     std::vector<std::unique_ptr<PhaseBase> > phases_;
 };
 
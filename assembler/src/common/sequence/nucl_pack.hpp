@@ -0,0 +1,207 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "nucl.hpp"
+#include "seq_common.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define NUCL_PACK_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Packing of the nucleotide strings into 2-bit codes, 32 nucleotides per word,
+ * the first nucleotide in the lowest bits. This is the layout of Sequence
+ * and Seq. SSE4.1 and AVX2 kernels are selected at runtime, the scalar one is
+ * the fallback and the reference.
+ *
+ * The input is either ACGT/acgt or 0123 string, mixing is not allowed. Other
+ * symbols produce unspecified codes.
+ */
+namespace nucl_pack {
+
+typedef seq_element_type ST;
+
+enum class Isa {
+    Scalar,
+    SSE41,
+    AVX2
+};
+
+typedef void (*Packer)(const char *s, size_t n, bool digits, bool rc, ST *dst);
+
+namespace impl {
+
+const size_t STN = sizeof(ST) * 4;
+
+// Codes of n <= STN nucleotides in one word, reversed and complemented if rc
+inline ST PackWordScalar(const char *s, size_t n, bool digits, bool rc) {
+    ST data = 0;
+    for (size_t i = 0; i < n; ++i) {
+        char c = s[rc ? n - 1 - i : i];
+        c = digits ? c : dignucl(c);
+        if (rc)
+            c = complement(c);
+        data |= ST(c) << (2 * i);
+    }
+    return data;
+}
+
+// Pointer to the symbols of the i-th word. The words of the reverse-complement
+// are taken from the end of the string
+inline const char *WordStart(const char *s, size_t n, size_t i, bool rc) {
+    return rc ? s + n - STN * (i + 1) : s + STN * i;
+}
+
+// The last incomplete word is packed with the scalar code in all the variants
+inline void PackTail(const char *s, size_t n, bool digits, bool rc, ST *dst) {
+    size_t words = n / STN, rest = n % STN;
+    if (rest)
+        dst[words] = PackWordScalar(rc ? s : s + STN * words, rest, digits, rc);
+}
+
+inline void PackScalar(const char *s, size_t n, bool digits, bool rc, ST *dst) {
+    for (size_t i = 0, words = n / STN; i < words; ++i)
+        dst[i] = PackWordScalar(WordStart(s, n, i, rc), STN, digits, rc);
+    PackTail(s, n, digits, rc, dst);
+}
+
+#ifdef NUCL_PACK_X86
+
+// ACGT codes are looked up by the low nibble of the symbol, which is 1, 3, 7 and 4
+// respectively. Lowercase letters have the same low nibble
+#define NUCL_PACK_LUT 0, 0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0
+#define NUCL_PACK_REVERSE 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+#define NUCL_PACK_GATHER 0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+
+// 16 symbols to 16 codes, then 2-bit codes are merged into 4-bit and 8-bit
+// lanes by the multiply-adds, and the low bytes of 32-bit lanes are gathered
+__attribute__((target("sse4.1")))
+inline uint32_t Pack16SSE41(const char *s, bool digits, bool rc) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+    if (!digits)
+        v = _mm_shuffle_epi8(_mm_setr_epi8(NUCL_PACK_LUT), _mm_and_si128(v, _mm_set1_epi8(0x0F)));
+    if (rc)
+        v = _mm_shuffle_epi8(_mm_xor_si128(v, _mm_set1_epi8(3)), _mm_setr_epi8(NUCL_PACK_REVERSE));
+    v = _mm_maddubs_epi16(v, _mm_set1_epi16(0x0401));
+    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00100001));
+    v = _mm_shuffle_epi8(v, _mm_setr_epi8(NUCL_PACK_GATHER));
+    return uint32_t(_mm_extract_epi32(v, 0));
+}
+
+__attribute__((target("sse4.1")))
+inline void PackSSE41(const char *s, size_t n, bool digits, bool rc, ST *dst) {
+    for (size_t i = 0, words = n / STN; i < words; ++i) {
+        const char *w = WordStart(s, n, i, rc);
+        uint32_t lo = Pack16SSE41(rc ? w + STN / 2 : w, digits, rc);
+        uint32_t hi = Pack16SSE41(rc ? w : w + STN / 2, digits, rc);
+        dst[i] = ST(lo) | (ST(hi) << 32);
+    }
+    PackTail(s, n, digits, rc, dst);
+}
+
+__attribute__((target("avx2")))
+inline ST PackWordAVX2(const char *s, bool digits, bool rc) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+    if (!digits)
+        v = _mm256_shuffle_epi8(_mm256_setr_epi8(NUCL_PACK_LUT, NUCL_PACK_LUT),
+                                _mm256_and_si256(v, _mm256_set1_epi8(0x0F)));
+    if (rc) {
+        // Bytes are reversed inside the 128-bit lanes, then the lanes are swapped
+        v = _mm256_shuffle_epi8(_mm256_xor_si256(v, _mm256_set1_epi8(3)),
+                                _mm256_setr_epi8(NUCL_PACK_REVERSE, NUCL_PACK_REVERSE));
+        v = _mm256_permute4x64_epi64(v, 0x4E);
+    }
+    v = _mm256_maddubs_epi16(v, _mm256_set1_epi16(0x0401));
+    v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00100001));
+    v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(NUCL_PACK_GATHER, NUCL_PACK_GATHER));
+    return ST(uint32_t(_mm256_extract_epi32(v, 0))) | (ST(uint32_t(_mm256_extract_epi32(v, 4))) << 32);
+}
+
+__attribute__((target("avx2")))
+inline void PackAVX2(const char *s, size_t n, bool digits, bool rc, ST *dst) {
+    for (size_t i = 0, words = n / STN; i < words; ++i)
+        dst[i] = PackWordAVX2(WordStart(s, n, i, rc), digits, rc);
+    PackTail(s, n, digits, rc, dst);
+}
+
+#undef NUCL_PACK_LUT
+#undef NUCL_PACK_REVERSE
+#undef NUCL_PACK_GATHER
+
+#endif
+
+}
+
+inline bool Supported(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar:
+            return true;
+#ifdef NUCL_PACK_X86
+        case Isa::SSE41:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.1");
+        case Isa::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+/**
+ * @return packing routine for the given instruction set, it must be supported
+ */
+inline Packer GetPacker(Isa isa) {
+    switch (isa) {
+#ifdef NUCL_PACK_X86
+        case Isa::SSE41:
+            return impl::PackSSE41;
+        case Isa::AVX2:
+            return impl::PackAVX2;
+#endif
+        default:
+            return impl::PackScalar;
+    }
+}
+
+/**
+ * @return the best instruction set of the running CPU
+ */
+inline Isa BestIsa() {
+    if (Supported(Isa::AVX2))
+        return Isa::AVX2;
+    if (Supported(Isa::SSE41))
+        return Isa::SSE41;
+    return Isa::Scalar;
+}
+
+/**
+ * Packs n nucleotides of s into dst (Sequence::DataSize(n) words), reverse-complement if rc
+ */
+inline void Pack(const char *s, size_t n, bool digits, bool rc, ST *dst) {
+    static const Packer packer = GetPacker(BestIsa());
+    packer(s, n, digits, rc, dst);
+}
+
+/**
+ * Reverse-complement of 32 packed nucleotides: the 2-bit groups are reversed
+ * by the byte swap and the swaps of nibbles and pairs, then complemented.
+ */
+inline uint64_t ReverseComplementWord(uint64_t x) {
+    x = __builtin_bswap64(x);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    return ~x;
+}
+
+}
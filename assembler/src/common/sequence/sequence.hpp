@@ -14,6 +14,7 @@
 
 #include "seq.hpp"
 #include "rtseq.hpp"
+#include "nucl_pack.hpp"
 
 #include <llvm/ADT/IntrusiveRefCntPtr.h>
 #include <llvm/Support/TrailingObjects.h>
@@ -38,7 +39,7 @@ class Sequence {
 
         ManagedNuclBuffer() {}
 
-        ManagedNuclBuffer(size_t nucls, ST *buf) {
+        ManagedNuclBuffer(size_t nucls, const ST *buf) {
             std::uninitialized_copy(buf, buf + Sequence::DataSize(nucls), data());
         }
 
@@ -50,7 +51,7 @@ class Sequence {
             return new (mem) ManagedNuclBuffer();
         }
 
-        static ManagedNuclBuffer *create(size_t nucls, ST *data) {
+        static ManagedNuclBuffer *create(size_t nucls, const ST *data) {
             void *mem = ::operator new(totalSizeToAlloc<ST>(Sequence::DataSize(nucls)));
             return new (mem) ManagedNuclBuffer(nucls, data);
         }
@@ -64,10 +65,6 @@ class Sequence {
     bool   rtl_  : 1;  // Right to left + complimentary (?)
     llvm::IntrusiveRefCntPtr<ManagedNuclBuffer> data_;
 
-    static size_t DataSize(size_t size) {
-        return (size + STN - 1) >> STNBits;
-    }
-
     template<typename S>
     void InitFromNucls(const S &s, bool rc = false) {
         size_t bytes_size = DataSize(size_);
@@ -121,6 +118,26 @@ class Sequence {
             bytes[cur] = 0;
     }
 
+    // Contiguous strings are packed by the vectorized code
+    void InitFromNucls(const char *s, bool rc = false) {
+        VERIFY(is_dignucl(s[0]) || is_nucl(s[0]));
+        nucl_pack::Pack(s, size_, is_dignucl(s[0]), rc, data_->data());
+    }
+
+    void InitFromNucls(const std::string &s, bool rc = false) {
+        InitFromNucls(s.c_str(), rc);
+    }
+
+    // STN nucleotides of the buffer starting from pos, the ones past the end of the sequence are garbage
+    ST PackedWindow(size_t pos) const {
+        const ST *bytes = data_->data();
+        size_t i = pos >> STNBits, shift = (pos & (STN - 1)) << 1;
+        ST res = bytes[i] >> shift;
+        if (shift && ((i + 1) << STNBits) < from_ + size_)
+            res |= bytes[i + 1] << (STBits - shift);
+        return res;
+    }
+
     inline bool ReadHeader(std::istream &file);
     inline bool WriteHeader(std::ostream &file) const;
 
@@ -132,6 +149,13 @@ class Sequence {
             : size_(size), from_(from), rtl_(rtl), data_(seq.data_) {}
 
 public:
+    /**
+     * @return the number of elements needed to store the given number of packed nucleotides
+     */
+    static size_t DataSize(size_t size) {
+        return (size + STN - 1) >> STNBits;
+    }
+
     /**
      * Sequence initialization (arbitrary size string)
      *
@@ -144,7 +168,7 @@ public:
 
     explicit Sequence(char *s, bool rc = false)
             : Sequence(strlen(s), 0) {
-        InitFromNucls(s, rc);
+        InitFromNucls(static_cast<const char *>(s), rc);
     }
 
     template<typename S>
@@ -170,6 +194,13 @@ public:
         kmer.copy_data(data_->data());
     }
 
+    /**
+     * Low level constructor from the packed nucleotides (DataSize(size) elements),
+     * e.g. ones produced by copy_data(). Handle with care.
+     */
+    explicit Sequence(size_t size, const seq_element_type *data_array)
+            : size_(size), from_(0), rtl_(false), data_(ManagedNuclBuffer::create(size_, data_array)) {}
+
     Sequence(const Sequence &s)
             : Sequence(s, s.from_, s.size_, s.rtl_) {}
 
@@ -265,6 +296,11 @@ public:
 
     inline std::string str() const;
 
+    /**
+     * Packs the nucleotides into DataSize(size()) elements, the unused bits of the last one are zeroed
+     */
+    inline void copy_data(seq_element_type *dst) const;
+
     inline std::string err() const;
 
     size_t size() const {
@@ -391,6 +427,30 @@ std::string Sequence::err() const {
     return oss.str();
 }
 
+void Sequence::copy_data(seq_element_type *dst) const {
+    size_t data_size = DataSize(size_);
+    if (!data_size)
+        return;
+
+    if (!rtl_ && (from_ & (STN - 1)) == 0) {
+        memcpy(dst, data_->data() + (from_ >> STNBits), data_size * sizeof(ST));
+    } else if (!rtl_) {
+        for (size_t i = 0; i < data_size; ++i)
+            dst[i] = PackedWindow(from_ + (i << STNBits));
+    } else {
+        // Words of the reverse-complement are taken from the end of the buffer
+        for (size_t i = 0; i < data_size; ++i) {
+            size_t cnt = size_ - (i << STNBits);
+            cnt = cnt < STN ? cnt : STN;
+            ST word = nucl_pack::ReverseComplementWord(PackedWindow(from_ + size_ - (i << STNBits) - cnt));
+            dst[i] = word >> ((STN - cnt) << 1);
+        }
+    }
+
+    if (size_ & (STN - 1))
+        dst[data_size - 1] &= (ST(1) << ((size_ & (STN - 1)) << 1)) - 1;
+}
+
 std::ostream &operator<<(std::ostream &os, const Sequence &s) {
     os << s.str();
     return os;
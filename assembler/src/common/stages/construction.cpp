@@ -14,14 +14,18 @@
 #include "pipeline/graph_pack.hpp"
 #include "pipeline/genomic_info.hpp"
 
+#include "io/binary/binary.hpp"
 #include "io/dataset_support/dataset_readers.hpp"
 #include "io/dataset_support/read_converter.hpp"
 #include "io/reads/coverage_filtering_read_wrapper.hpp"
 #include "io/reads/multifile_reader.hpp"
 
+#include "utils/filesystem/file_opener.hpp"
 #include "utils/filesystem/temporary.hpp"
 #include "utils/ph_map/coverage_hash_map_builder.hpp"
 
+#include <fstream>
+
 
 namespace debruijn_graph {
 
@@ -167,6 +171,67 @@ Construction::~Construction() {}
 
 namespace {
 
+// Replaces the input streams with the ones skipping the reads with low
+// multiplicity k+1-mers
+void FilterReadStreams(ConstructionStorage &storage) {
+    unsigned kplusone = storage.ext_index.k() + 1;
+    rolling_hash::SymmetricCyclicHash<rolling_hash::NDNASeqHash> hasher(kplusone);
+    storage.read_streams = io::CovFilteringWrap(std::move(storage.read_streams), kplusone, hasher,
+                                                *storage.cqf, storage.params.read_cov_threshold);
+}
+
+constexpr char STORAGE_NAME[] = "construction_storage";
+
+/**
+ * @brief  Saves the parts of the construction storage built so far: the CQF,
+ *         the k+1-mers and (optionally) the extension index. The directory
+ *         for the phase save should already exist.
+ */
+void SaveStorage(const ConstructionStorage &storage, const std::string &dir,
+                 bool save_ext_index) {
+    std::ofstream os(fs::append_path(dir, STORAGE_NAME), std::ios::binary);
+    io::binary::BinWrite<char>(os, bool(storage.cqf));
+    if (storage.cqf)
+        storage.cqf->serialize(os);
+
+    io::binary::BinWrite<char>(os, bool(storage.kmers));
+    if (storage.kmers)
+        storage.kmers->serialize(os);
+
+    io::binary::BinWrite<char>(os, save_ext_index);
+    if (save_ext_index)
+        storage.ext_index.BinWrite(os);
+}
+
+/// @throw std::ios_base::failure if the storage was not saved
+void LoadStorage(ConstructionStorage &storage, const std::string &dir) {
+    auto is = fs::open_file(fs::append_path(dir, STORAGE_NAME), std::ios::binary);
+    if (io::binary::BinRead<char>(is)) {
+        storage.cqf.reset(new qf::cqf(1));
+        storage.cqf->deserialize(is);
+        FilterReadStreams(storage);
+    }
+    // Otherwise the later phases would silently use the unfiltered reads
+    VERIFY_MSG(bool(storage.cqf) == bool(storage.params.read_cov_threshold),
+               "The saved CQF does not match read_cov_threshold " << storage.params.read_cov_threshold);
+
+    if (io::binary::BinRead<char>(is)) {
+        storage.kmers.reset(new kmers::KMerDiskStorage<RtSeq>());
+        storage.kmers->deserialize(is, storage.workdir);
+    }
+
+    if (io::binary::BinRead<char>(is))
+        storage.ext_index.BinRead(is, storage.workdir);
+}
+
+std::string MakePhaseDir(const std::string &save_to, const char *prefix) {
+    auto dir = fs::append_path(save_to, prefix);
+    INFO("Saving current state to " << dir);
+    fs::remove_if_exists(dir);
+    fs::make_dir(dir);
+    return dir;
+}
+
 class CoverageFilter: public Construction::Phase {
   public:
     CoverageFilter()
@@ -197,19 +262,19 @@ class CoverageFilter: public Construction::Phase {
         FillCoverageHistogram(*storage().cqf, kplusone, hasher, read_streams, rthr, KmerFilter());
 
         // Replace input streams with wrapper ones
-        storage().read_streams = io::CovFilteringWrap(std::move(read_streams), kplusone, hasher, *storage().cqf, rthr);
+        FilterReadStreams(storage());
     }
 
     void load(debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+              const std::string &load_from,
+              const char* prefix) override {
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
     void save(const debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+              const std::string &save_to,
+              const char* prefix) const override {
+        SaveStorage(storage(), MakePhaseDir(save_to, prefix), /* save_ext_index */ false);
     }
 
 };
@@ -228,17 +293,39 @@ public:
         auto &contigs_streams = storage().contigs_streams;
         const auto &index = storage().ext_index;
         size_t buffer_size = storage().params.read_buffer_size;
-        using storing_type = decltype(storage().ext_index)::storing_type;
 
         VERIFY_MSG(read_streams.size(), "No input streams specified");
 
+        // The k+1-mers are precounted only from the unfiltered reads
+        std::string precounted = PrecountedFile(index.k());
+        if (storage().params.use_precounted && !storage().cqf && fs::check_existence(precounted)) {
+            INFO("Using k+1-mers counted by the previous iteration");
+            kmers::KMerDiskStorage<RtSeq> kmers;
+            {
+                std::ifstream is(precounted, std::ios::binary);
+                kmers.deserialize(is, storage().workdir);
+            }
+            fs::remove_if_exists(precounted);
+            storage().kmers.reset(new kmers::KMerDiskStorage<RtSeq>(AddContigs(std::move(kmers))));
+            return;
+        }
+
+        if (!storage().params.precount_k.empty()) {
+            // The leftovers of the previous runs
+            for (unsigned next_k : storage().params.precount_k)
+                fs::remove_if_exists(PrecountedFile(next_k));
+
+            if (storage().cqf) {
+                WARN("Reads are filtered by k+1-mer coverage, k+1-mers of the next iterations are not counted");
+            } else {
+                storage().kmers.reset(new kmers::KMerDiskStorage<RtSeq>(AddContigs(CountAllK())));
+                return;
+            }
+        }
 
         io::ReadStreamList<io::SingleReadSeq> merge_streams = temp_merge_read_streams(read_streams, contigs_streams);
 
         unsigned nthreads = (unsigned)merge_streams.size();
-        using Splitter =  utils::DeBruijnReadKMerSplitter<io::SingleReadSeq,
-                                                          utils::StoringTypeFilter<storing_type>>;
-
         kmers::KMerDiskCounter<RtSeq>
                 counter(storage().workdir,
                         Splitter(storage().workdir, index.k() + 1, merge_streams, buffer_size));
@@ -247,15 +334,72 @@ public:
     }
 
     void load(debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+              const std::string &load_from,
+              const char* prefix) override {
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
     void save(const debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+              const std::string &save_to,
+              const char* prefix) const override {
+        SaveStorage(storage(), MakePhaseDir(save_to, prefix), /* save_ext_index */ false);
+    }
+
+private:
+    using storing_type = decltype(ConstructionStorage::ext_index)::storing_type;
+    using KmerFilter = utils::StoringTypeFilter<storing_type>;
+    using Splitter = utils::DeBruijnReadKMerSplitter<io::SingleReadSeq, KmerFilter>;
+
+    // The k+1-mers of the next iterations are kept in the common temporary directory
+    static std::string PrecountedFile(unsigned k) {
+        return fs::append_path(cfg::get().tmp_dir, "kpomers_K" + std::to_string(k));
+    }
+
+    /*
+     * Splits the k+1-mers of the reads for the current and the next iterations during the single pass over
+     * the reads, counts them and saves the ones of the next iterations. The contigs are different for the
+     * different iterations, so they are not taken here.
+     */
+    kmers::KMerDiskStorage<RtSeq> CountAllK() {
+        unsigned k = storage().ext_index.k();
+        std::vector<unsigned> Ks = { k + 1 };
+        for (unsigned next_k : storage().params.precount_k) {
+            if (next_k > k)
+                Ks.push_back(next_k + 1);
+        }
+        INFO("Counting k+1-mers for K = " << k << " and " << Ks.size() - 1 << " next iterations");
+
+        auto &read_streams = storage().read_streams;
+        unsigned nthreads = (unsigned)read_streams.size();
+        unsigned num_buckets = 10 * nthreads;
+        utils::DeBruijnReadMultiKMerSplitter<io::SingleReadSeq, KmerFilter>
+                splitter(storage().workdir, Ks, read_streams, storage().params.read_buffer_size);
+        splitter.Split(num_buckets, nthreads);
+
+        for (size_t i = 1; i < Ks.size(); ++i) {
+            kmers::KMerDiskCounter<RtSeq> counter(storage().workdir, std::move(splitter.splitter(i)));
+            auto kmers = counter.Count(num_buckets, nthreads);
+            std::ofstream os(PrecountedFile(Ks[i] - 1), std::ios::binary);
+            kmers.serialize(os);
+        }
+
+        kmers::KMerDiskCounter<RtSeq> counter(storage().workdir, std::move(splitter.splitter(0)));
+        return counter.Count(num_buckets, nthreads);
+    }
+
+    // Adds the k+1-mers of the contigs to the ones of the reads
+    kmers::KMerDiskStorage<RtSeq> AddContigs(kmers::KMerDiskStorage<RtSeq> kmers) {
+        auto &contigs_streams = storage().contigs_streams;
+        if (!contigs_streams.size())
+            return kmers;
+
+        unsigned num_buckets = unsigned(kmers.num_buckets()), k = kmers.k();
+        unsigned nthreads = unsigned(std::max(storage().read_streams.size(), contigs_streams.size()));
+        kmers::KMerPrecountedSplitter<RtSeq>
+                splitter(storage().workdir, std::move(kmers),
+                         Splitter(storage().workdir, k, contigs_streams, storage().params.read_buffer_size));
+        kmers::KMerDiskCounter<RtSeq> counter(storage().workdir, std::move(splitter));
+        return counter.Count(num_buckets, nthreads);
     }
 };
 
@@ -276,15 +420,15 @@ public:
     }
 
     void load(debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+              const std::string &load_from,
+              const char* prefix) override {
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
     void save(const debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+              const std::string &save_to,
+              const char* prefix) const override {
+        SaveStorage(storage(), MakePhaseDir(save_to, prefix), /* save_ext_index */ true);
     }
 };
 
@@ -305,15 +449,15 @@ public:
     }
 
     void load(debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+              const std::string &load_from,
+              const char* prefix) override {
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
     void save(const debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+              const std::string &save_to,
+              const char* prefix) const override {
+        SaveStorage(storage(), MakePhaseDir(save_to, prefix), /* save_ext_index */ true);
     }
 };
 
@@ -331,15 +475,15 @@ public:
     }
 
     void load(debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+              const std::string &load_from,
+              const char* prefix) override {
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
     void save(const debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+              const std::string &save_to,
+              const char* prefix) const override {
+        SaveStorage(storage(), MakePhaseDir(save_to, prefix), /* save_ext_index */ true);
     }
 };
 
@@ -357,17 +501,20 @@ public:
         DeBruijnGraphExtentionConstructor<Graph>(gp.get_mutable<Graph>(), storage().ext_index).ConstructGraph(storage().params.keep_perfect_loops);
     }
 
-    void load(debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) override {
-        VERIFY_MSG(false, "implement me");
+    // The extension index is not needed after the condensation, only the
+    // graph and the k+1-mers for the coverage filling are saved
+    void load(debruijn_graph::GraphPack &gp,
+              const std::string &load_from,
+              const char* prefix) override {
+        AssemblyStage::load(gp, load_from, prefix);
+        LoadStorage(storage(), fs::append_path(load_from, prefix));
     }
 
-    void save(const debruijn_graph::GraphPack&,
-              const std::string &,
-              const char*) const override {
-        //FIXME why commented here and others
-        // VERIFY_MSG(false, "implement me");
+    void save(const debruijn_graph::GraphPack &gp,
+              const std::string &save_to,
+              const char* prefix) const override {
+        AssemblyStage::save(gp, save_to, prefix);
+        SaveStorage(storage(), fs::append_path(save_to, prefix), /* save_ext_index */ false);
     }
 };
 
@@ -408,9 +555,11 @@ public:
         storage().coverage_map.reset(new ConstructionStorage::CoverageMap(storage().kmers->k()));
         auto &coverage_map = *storage().coverage_map;
 
-        utils::CoverageHashMapBuilder().BuildIndex(coverage_map,
-                                                   *storage().kmers,
-                                                   storage().read_streams);
+        const auto &params = storage().params;
+        utils::CoverageHashMapBuilder(params.coverage_cache_size,
+                                      params.coverage_replicas).BuildIndex(coverage_map,
+                                                                           *storage().kmers,
+                                                                           storage().read_streams);
         /*
         INFO("Checking the PHM");
 
@@ -453,13 +602,13 @@ public:
     void load(debruijn_graph::GraphPack&,
               const std::string &,
               const char*) override {
-        VERIFY_MSG(false, "implement me");
+        VERIFY_MSG(false, "The last phase is never loaded, the state of the whole stage is loaded instead");
     }
 
     void save(const debruijn_graph::GraphPack&,
               const std::string &,
               const char*) const override {
-        // VERIFY_MSG(false, "implement me");
+        // The whole stage is saved right after the last phase
     }
 
 };
@@ -84,6 +84,14 @@ public:
         return mask_;
     }
 
+    void BinWrite(std::ostream &os) const {
+        io::binary::BinWrite(os, mask_);
+    }
+
+    void BinRead(std::istream &is) {
+        io::binary::BinRead(is, mask_);
+    }
+
     template<class Key>
     InOutMask conjugate(const Key & /*k*/) const {
         return InOutMask(invert_byte(mask_));
@@ -17,6 +17,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <dirent.h>
 #include <unistd.h>
 #include <cstring>
@@ -140,6 +141,14 @@ size_t filesize(std::string const& filename) {
     return stat_buf.st_size;
 }
 
+size_t free_space(std::string const& path) {
+    struct statvfs stat_buf;
+    int rc = statvfs(path.c_str(), &stat_buf);
+    if (rc)
+        throw std::runtime_error("Cannot tell the free space of " + path + ": " + std::strerror(errno));
+    return size_t(stat_buf.f_bavail) * stat_buf.f_frsize;
+}
+
 bool check_existence(std::string const& path) {
     struct stat st_buf;
     return stat(path.c_str(), &st_buf) == 0
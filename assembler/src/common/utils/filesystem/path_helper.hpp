@@ -39,6 +39,9 @@ std::string parent_path(std::string const &path);
 
 size_t filesize(std::string const &path);
 
+// Bytes available to the user on the file system of the path
+size_t free_space(std::string const &path);
+
 bool check_existence(std::string const &path);
 
 void remove_if_exists(std::string const &path);
@@ -56,6 +56,12 @@ public:
 
 
 
+// Whether the processor asks to end the batch early, the processors do not by default
+template<class Processor>
+bool BatchStopped(const Processor &) {
+    return false;
+}
+
 template<class ReadStream, class SeqHasher, class Processor, class KmerFilter>
 size_t FillFromStream(ReadStream &stream, const SeqHasher &hasher,
                       Processor &processor, unsigned k,
@@ -76,7 +82,7 @@ size_t FillFromStream(ReadStream &stream, const SeqHasher &hasher,
             continue;
 
         kmer_hash_processor.ProcessSequence(seq, k);
-        if (reads >= max_read_cnt)
+        if (reads >= max_read_cnt || BatchStopped(processor))
             break;
     }
 
@@ -86,32 +92,46 @@ size_t FillFromStream(ReadStream &stream, const SeqHasher &hasher,
 class CQFProcessor {
     CQFKmerFilter &cqf_;
     CQFKmerFilter &local_cqf_;
+    const uint64_t max_local_slots_;
     const unsigned thr_;
 public:
     CQFProcessor(CQFKmerFilter &cqf,
                  CQFKmerFilter &local_cqf,
+                 uint64_t max_local_slots,
                  unsigned thr) :
-            cqf_(cqf), local_cqf_(local_cqf), thr_(thr) {
+            cqf_(cqf), local_cqf_(local_cqf), max_local_slots_(max_local_slots), thr_(thr) {
+    }
+
+    // The local QF has reached its size limit, so the batch ends and the local QF is
+    // merged into the main one. It still expands to take the rest of the current read
+    bool stopped() const {
+        return local_cqf_.slots() >= max_local_slots_ && local_cqf_.almost_full();
     }
 
     void ProcessKmer(const RtSeq &/*kmer*/, uint64_t hash) {
         // First try and insert in the main QF. If lock can't be
-        // acquired in the first attempt then insert the item in the
-        // local QF.
+        // acquired in the first attempt or the main QF is full then
+        // insert the item in the local QF.
         if (cqf_.lookup(hash, /* lock */ true) >= thr_)
             return;
 
-        if (!cqf_.add(hash, /* count */ 1,
-                /* lock */ true, /* spin */ false)) {
-            local_cqf_.add(hash, /* count */ 1,
-                    /* lock */ false, /* spin */ false);
-            if (local_cqf_.insertions() > local_cqf_.slots() / 2)
-                cqf_.merge(local_cqf_);
-        }
+        if (cqf_.add(hash, /* count */ 1,
+                     /* lock */ true, /* spin */ false))
+            return;
+
+        // The local QF is private to the thread, so it is expanded in place.
+        // It is merged into the main one only between the batches
+        while (!local_cqf_.add(hash, /* count */ 1,
+                               /* lock */ false, /* spin */ false))
+            local_cqf_.expand();
     }
 
 };
 
+inline bool BatchStopped(const CQFProcessor &processor) {
+    return processor.stopped();
+}
+
 template<class Hasher, class KMerFilter = utils::StoringTypeFilter<utils::SimpleStoring>>
 class HllFiller {
  private:
@@ -137,10 +157,10 @@ class HllFiller {
 
     //Return value: should we interrupt reads processing
     template <class Read>
-    bool operator()(std::unique_ptr<Read> r) {
+    bool operator()(const Read &r) {
         unsigned thread_id = (unsigned)omp_get_thread_num();
         reads[thread_id] += 1;
-        const Sequence &seq = r->sequence();
+        const Sequence &seq = r.sequence();
         if (seq.size() < k) {
             return false;
         }
@@ -187,10 +207,7 @@ size_t EstimateCardinalityForOneStream(unsigned k, ReadStream &streams, const Ha
     }
     INFO("Total " << reads << " reads processed");
 
-    for (size_t i = 1; i < hlls.size(); ++i) {
-        hlls[0].merge(hlls[i]);
-        hlls[i].clear();
-    }
+    hll::tree_merge(hlls, nthreads);
 
     double res = hlls[0].cardinality();
 
@@ -223,10 +240,7 @@ size_t EstimateCardinalityUpperBound(unsigned k, ReadStream &streams, const Hash
     }
     INFO("Total " << reads << " reads processed");
 
-    for (size_t i = 1; i < hlls.size(); ++i) {
-        hlls[0].merge(hlls[i]);
-        hlls[i].clear();
-    }
+    hll::tree_merge(hlls, stream_num);
 
     double res = hlls[0].upper_bound_cardinality();
 
@@ -249,9 +263,11 @@ void FillCoverageHistogram(qf::cqf &cqf, unsigned k, const Hasher &hasher, ReadS
     streams.reset();
     size_t reads = 0, n = 15;
     while (!streams.eof()) {
+        // All the local QF together take no more than the main one
+        uint64_t max_local_slots = std::max<uint64_t>(1 << 16, cqf.slots() / stream_num);
         #pragma omp parallel for reduction(+:reads)
         for (unsigned i = 0; i < stream_num; ++i) {
-            CQFProcessor processor(cqf, local_cqfs[i], thr);
+            CQFProcessor processor(cqf, local_cqfs[i], max_local_slots, thr);
             reads += FillFromStream(streams[i], hasher, processor, k, 1000000, filter);
         }
 
@@ -259,11 +275,14 @@ void FillCoverageHistogram(qf::cqf &cqf, unsigned k, const Hasher &hasher, ReadS
             INFO("Processed " << reads << " reads");
             n += 1;
         }
-    }
 
-    INFO("Merging local CQF");
-    for (unsigned i = 0; i < stream_num; ++i) {
-        cqf.merge(local_cqfs[i]);
+        // Nobody inserts now. The main QF is expanded if the local ones do not fit
+        for (unsigned i = 0; i < stream_num; ++i)
+            cqf.merge(local_cqfs[i], stream_num);
+
+        // The estimate was too low
+        if (cqf.expand_if_full(stream_num))
+            INFO("CQF is full, expanded to " << cqf.slots() << " slots");
     }
 
     INFO("Total " << reads << " reads processed");
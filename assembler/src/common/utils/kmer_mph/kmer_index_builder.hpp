@@ -146,6 +146,10 @@ class KMerDiskStorage {
     return all_kmers_;
   }
 
+  const std::string &bucket_file(size_t i) const {
+    return buckets_.at(i)->file();
+  }
+
   size_t bucket_size(size_t i) const {
     return fs::filesize(*buckets_.at(i)) / (Seq::GetDataSize(k_) * sizeof(typename Seq::DataType));
   }
@@ -165,6 +169,36 @@ class KMerDiskStorage {
   size_t num_buckets() const { return buckets_.size(); }
   KMerSegmentPolicy segment_policy() const { return segment_policy_; }
 
+  template<class Writer>
+  void serialize(Writer &os) const {
+    VERIFY_MSG(!all_kmers_, "Merged k-mers could not be serialized");
+    size_t num_segments = segment_policy_.num_segments(), num_buckets = buckets_.size();
+    os.write((char*)&k_, sizeof(k_));
+    os.write((char*)&num_segments, sizeof(num_segments));
+    os.write((char*)&num_buckets, sizeof(num_buckets));
+    for (const auto &file : buckets_)
+      traits::raw_file_serialize(os, *file);
+  }
+
+  // Restores the buckets as the files inside work_dir
+  template<class Reader>
+  void deserialize(Reader &is, fs::TmpDir work_dir) {
+    work_dir_ = work_dir;
+    kmer_prefix_ = work_dir_->tmp_file("kmers");
+    all_kmers_.reset();
+
+    size_t num_segments, num_buckets;
+    is.read((char*)&k_, sizeof(k_));
+    is.read((char*)&num_segments, sizeof(num_segments));
+    is.read((char*)&num_buckets, sizeof(num_buckets));
+    segment_policy_.reset(num_segments);
+
+    buckets_.clear();
+    resize(num_buckets);
+    for (size_t i = 0; i < num_buckets; ++i)
+      traits::raw_file_deserialize(is, *create(i));
+  }
+
   void merge() {
     INFO("Merging final buckets.");
     TIME_TRACE_SCOPE("KMerDiskStorage::MergeFinal");
@@ -191,6 +225,82 @@ class KMerDiskStorage {
 };
 
 
+/**
+ * Adds the k-mers counted in advance (e.g. by the multi-K splitting of the previous iteration) to the ones
+ * split by the other splitter. Every counted bucket is appended to the raw bucket as one more sorted run, so
+ * KMerDiskCounter merges them with the runs of the splitter. The number of buckets must be the same.
+ */
+template<class Seq>
+class KMerPrecountedSplitter : public KMerSplitter<Seq> {
+public:
+  using typename KMerSplitter<Seq>::RawKMers;
+
+  KMerPrecountedSplitter(fs::TmpDir work_dir, KMerDiskStorage<Seq> counted)
+      : KMerSplitter<Seq>(work_dir, counted.k()), counted_(std::move(counted)) {}
+
+  template<class Splitter>
+  KMerPrecountedSplitter(fs::TmpDir work_dir, KMerDiskStorage<Seq> counted, Splitter splitter)
+      : KMerSplitter<Seq>(work_dir, counted.k()), counted_(std::move(counted)),
+        splitter_(new Splitter{std::move(splitter)}) {
+    VERIFY(splitter_->K() == this->K_);
+  }
+
+  RawKMers Split(size_t num_files, unsigned nthreads) override {
+    VERIFY_MSG(num_files == counted_.num_buckets(),
+               "k-mers were counted in " << counted_.num_buckets() << " buckets, requested " << num_files);
+    RawKMers out;
+    if (splitter_) {
+      out = splitter_->Split(num_files, nthreads);
+    } else {
+      auto tmp_prefix = this->work_dir_->tmp_file("kmers_raw");
+      for (unsigned i = 0; i < num_files; ++i)
+        out.emplace_back(tmp_prefix->CreateDep(std::to_string(i)));
+    }
+    VERIFY(out.size() == num_files);
+    this->bucket_.reset(num_files);
+
+    INFO("Adding " << counted_.total_kmers() << " precounted k-mers");
+#   pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+    for (size_t i = 0; i < num_files; ++i)
+      AppendRun(*out[i], counted_.bucket_file(i), this->kmer_size());
+
+    return out;
+  }
+
+private:
+  KMerDiskStorage<Seq> counted_;
+  std::unique_ptr<KMerSplitter<Seq>> splitter_;
+
+  static void AppendRun(const std::string &file, const std::string &run, size_t kmer_size) {
+    size_t sz = fs::filesize(run);
+    FILE *in = fopen(run.c_str(), "rb");
+    if (!in)
+      FATAL_ERROR("Cannot open temporary file " << run << " for reading");
+    FILE *out = fopen(file.c_str(), "ab");
+    if (!out)
+      FATAL_ERROR("Cannot open temporary file " << file << " for writing");
+
+    std::vector<char> buf(1 << 20);
+    for (size_t left = sz; left; ) {
+      size_t n = std::min(left, buf.size());
+      if (fread(buf.data(), 1, n, in) != n || fwrite(buf.data(), 1, n, out) != n)
+        FATAL_ERROR("I/O error! Incomplete copy of " << run << ". Reason: " << strerror(errno));
+      left -= n;
+    }
+    fclose(in);
+    fclose(out);
+
+    // Write index
+    size_t cnt = sz / kmer_size;
+    out = fopen((file + ".idx").c_str(), "ab");
+    if (!out)
+      FATAL_ERROR("Cannot open temporary file " << file << " for writing");
+    if (fwrite(&cnt, sizeof(cnt), 1, out) != 1)
+      FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
+    fclose(out);
+  }
+};
+
 template<class S, class traits = kmer_index_traits<S> >
 class KMerCounter {
 public:
@@ -6,8 +6,13 @@
 //***************************************************************************
 
 #include "io/kmers/mmapped_reader.hpp"
+#include "utils/filesystem/path_helper.hpp"
 #include "utils/filesystem/temporary.hpp"
 
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
 namespace kmers {
 
 template<class Seq>
@@ -77,5 +82,36 @@ struct kmer_index_traits {
     return std::unique_ptr<RawKMerStorage>(new RawKMerStorage(FileName, elcnt, false, off, sz));
   }
 
+  // Copies the whole raw k-mer file (e.g. a bucket) into the stream
+  template<class Writer>
+  static void raw_file_serialize(Writer &writer, const std::string &FileName) {
+    size_t sz = fs::filesize(FileName);
+    writer.write((char*)&sz, sizeof(sz));
+
+    std::ifstream ifs(FileName, std::ios::in | std::ios::binary);
+    std::vector<char> buf(1 << 20);
+    for (size_t left = sz; left; ) {
+      size_t n = std::min(left, buf.size());
+      ifs.read(buf.data(), n);
+      writer.write(buf.data(), n);
+      left -= n;
+    }
+  }
+
+  template<class Reader>
+  static void raw_file_deserialize(Reader &reader, const std::string &FileName) {
+    size_t sz;
+    reader.read((char*)&sz, sizeof(sz));
+
+    std::ofstream ofs(FileName, std::ios::out | std::ios::binary);
+    std::vector<char> buf(1 << 20);
+    for (size_t left = sz; left; ) {
+      size_t n = std::min(left, buf.size());
+      reader.read(buf.data(), n);
+      ofs.write(buf.data(), n);
+      left -= n;
+    }
+  }
+
 };
 }
@@ -15,6 +15,10 @@
 #include "utils/logger/logger.hpp"
 
 #include <libcxx/sort.hpp>
+#include "threadpool/threadpool.hpp"
+
+#include <future>
+#include <memory>
 #include <string>
 #include <cstdio>
 
@@ -57,18 +61,45 @@ public:
     using typename KMerSplitter<Seq>::RawKMers;
 
     KMerSortingSplitter(const std::string &work_dir, unsigned K)
-            : KMerSplitter<Seq>(work_dir, K), cell_size_(0), num_files_(0) {}
+            : KMerSplitter<Seq>(work_dir, K), cell_size_(0), num_files_(0), async_dump_(true) {}
 
     KMerSortingSplitter(fs::TmpDir work_dir, unsigned K)
-            : KMerSplitter<Seq>(work_dir, K), cell_size_(0), num_files_(0) {}
+            : KMerSplitter<Seq>(work_dir, K), cell_size_(0), num_files_(0), async_dump_(true) {}
+
+    // Splitters are moved into the k-mer counters before any dump is started
+    KMerSortingSplitter(KMerSortingSplitter &&) = default;
+
+    ~KMerSortingSplitter() {
+        WaitDump();
+    }
+
+    // When enabled (default), DumpBuffers() hands the filled buffers over to
+    // the writer pool and returns immediately, so the caller could continue
+    // filling the second set of buffers while the first one is being sorted
+    // and written. Must be set before PrepareBuffers().
+    void set_async_dump(bool async) { async_dump_ = async; }
+    bool async_dump() const { return async_dump_; }
 
 protected:
     using SeqKMerVector = adt::KMerVector<Seq>;
     using KMerBuffer = std::vector<SeqKMerVector>;
 
     std::vector<KMerBuffer> kmer_buffers_;
+    std::vector<KMerBuffer> dump_buffers_;
     size_t cell_size_;
     size_t num_files_;
+    bool async_dump_;
+    std::unique_ptr<ThreadPool::ThreadPool> writer_pool_;
+    std::vector<std::future<void>> dump_tasks_;
+
+    // Buffer size per thread when it is not set explicitly
+    size_t DefaultReadsBufferSize(unsigned nthreads) const {
+        size_t reads_buffer_size = 536870912ull;
+        // Double buffering requires two sets of buffers to be alive at the same time
+        size_t mem_limit =  (size_t)((double)(utils::get_free_memory()) / (nthreads * (async_dump_ ? 6 : 3)));
+        INFO("Memory available for splitting buffers: " << (double)mem_limit / 1024.0 / 1024.0 / 1024.0 << " Gb");
+        return std::min(reads_buffer_size, mem_limit);
+    }
 
     RawKMers PrepareBuffers(size_t num_files, unsigned nthreads, size_t reads_buffer_size) {
         num_files_ = num_files;
@@ -87,12 +118,8 @@ protected:
             WARN("Do 'ulimit -n " << file_limit << "' in the console to overcome the limit");
         }
 
-        if (reads_buffer_size == 0) {
-            reads_buffer_size = 536870912ull;
-            size_t mem_limit =  (size_t)((double)(utils::get_free_memory()) / (nthreads * 3));
-            INFO("Memory available for splitting buffers: " << (double)mem_limit / 1024.0 / 1024.0 / 1024.0 << " Gb");
-            reads_buffer_size = std::min(reads_buffer_size, mem_limit);
-        }
+        if (reads_buffer_size == 0)
+            reads_buffer_size = DefaultReadsBufferSize(nthreads);
         cell_size_ = reads_buffer_size / (num_files_ * this->kmer_size());
         // Set sane minimum cell size
         if (cell_size_ < 16384)
@@ -105,6 +132,11 @@ protected:
             entry.resize(num_files_, adt::KMerVector<Seq>(this->K_, (size_t) (1.1 * (double) cell_size_)));
         }
 
+        if (async_dump_) {
+            dump_buffers_ = kmer_buffers_;
+            writer_pool_ = std::make_unique<ThreadPool::ThreadPool>(nthreads);
+        }
+
         return out;
     }
 
@@ -120,58 +152,98 @@ protected:
     void DumpBuffers(const RawKMers &ostreams) {
         VERIFY(ostreams.size() == num_files_ && kmer_buffers_[0].size() == num_files_);
 
-#   pragma omp parallel for
-        for (size_t k = 0; k < num_files_; ++k) {
-            // Below k is thread id!
+        if (!async_dump_) {
+#           pragma omp parallel for
+            for (size_t k = 0; k < num_files_; ++k) {
+                // Below k is thread id!
+                SeqKMerVector SortBuffer = SortBucket(kmer_buffers_, k);
+#               pragma omp critical
+                {
+                    WriteBucket(ostreams[k]->file(), SortBuffer);
+                }
+            }
 
-            size_t sz = 0;
-            for (size_t i = 0; i < kmer_buffers_.size(); ++i)
-                sz += kmer_buffers_[i][k].size();
+            for (auto & entry : kmer_buffers_)
+                for (auto & eentry : entry)
+                    eentry.clear();
 
-            adt::KMerVector<Seq> SortBuffer(this->K_, sz);
-            for (auto & entry : kmer_buffers_) {
-                const auto &buffer = entry[k];
-                for (size_t j = 0; j < buffer.size(); ++j)
-                    SortBuffer.push_back(buffer[j]);
-            }
-            libcxx::sort(SortBuffer.begin(), SortBuffer.end(), typename adt::KMerVector<Seq>::less2_fast());
-            auto it = std::unique(SortBuffer.begin(), SortBuffer.end(), typename adt::KMerVector<Seq>::equal_to());
-
-#     pragma omp critical
-            {
-                size_t cnt =  it - SortBuffer.begin();
-
-                // Write k-mers
-                FILE *f = fopen(ostreams[k]->file().c_str(), "ab");
-                if (!f)
-                    FATAL_ERROR("Cannot open temporary file " << ostreams[k]->file() << " for writing");
-                size_t res = fwrite(SortBuffer.data(), SortBuffer.el_data_size(), cnt, f);
-                if (res != cnt)
-                    FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-                fclose(f);
-
-                // Write index
-                f = fopen((ostreams[k]->file() + ".idx").c_str(), "ab");
-                if (!f)
-                    FATAL_ERROR("Cannot open temporary file " << ostreams[k]->file() << " for writing");
-                res = fwrite(&cnt, sizeof(cnt), 1, f);
-                if (res != 1)
-                    FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-                fclose(f);
-            }
+            return;
         }
 
-        for (auto & entry : kmer_buffers_)
-            for (auto & eentry : entry)
-                eentry.clear();
+        // Wait for the previous dump to finish (it owns the spare set of
+        // buffers) and hand the filled buffers over to the writers. Every
+        // bucket is sorted and appended to its own file by a single task, so
+        // no global lock is required and the order of chunks in each bucket
+        // file is the same as in synchronous mode.
+        WaitDump();
+        std::swap(kmer_buffers_, dump_buffers_);
+        for (size_t k = 0; k < num_files_; ++k) {
+            dump_tasks_.emplace_back(
+                writer_pool_->run([this, k, file = ostreams[k]->file()] {
+                        WriteBucket(file, SortBucket(dump_buffers_, k));
+                        for (auto & entry : dump_buffers_)
+                            entry[k].clear();
+                    }));
+        }
+    }
+
+    void WaitDump() {
+        for (auto &task : dump_tasks_)
+            task.get();
+        dump_tasks_.clear();
     }
 
     void ClearBuffers() {
+        WaitDump();
+        writer_pool_.reset();
+
         for (auto & entry : kmer_buffers_)
             for (auto & eentry : entry) {
                 eentry.clear();
                 eentry.shrink_to_fit();
             }
+        dump_buffers_.clear();
+    }
+
+private:
+    SeqKMerVector SortBucket(const std::vector<KMerBuffer> &buffers, size_t k) const {
+        size_t sz = 0;
+        for (const auto &entry : buffers)
+            sz += entry[k].size();
+
+        SeqKMerVector SortBuffer(this->K_, sz);
+        for (const auto &entry : buffers) {
+            const auto &buffer = entry[k];
+            for (size_t j = 0; j < buffer.size(); ++j)
+                SortBuffer.push_back(buffer[j]);
+        }
+        libcxx::sort(SortBuffer.begin(), SortBuffer.end(), typename SeqKMerVector::less2_fast());
+        auto it = std::unique(SortBuffer.begin(), SortBuffer.end(), typename SeqKMerVector::equal_to());
+        SortBuffer.shrink(it - SortBuffer.begin());
+
+        return SortBuffer;
+    }
+
+    static void WriteBucket(const std::string &file, const SeqKMerVector &SortBuffer) {
+        size_t cnt = SortBuffer.size();
+
+        // Write k-mers
+        FILE *f = fopen(file.c_str(), "ab");
+        if (!f)
+            FATAL_ERROR("Cannot open temporary file " << file << " for writing");
+        size_t res = fwrite(SortBuffer.data(), SortBuffer.el_data_size(), cnt, f);
+        if (res != cnt)
+            FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
+        fclose(f);
+
+        // Write index
+        f = fopen((file + ".idx").c_str(), "ab");
+        if (!f)
+            FATAL_ERROR("Cannot open temporary file " << file << " for writing");
+        res = fwrite(&cnt, sizeof(cnt), 1, f);
+        if (res != 1)
+            FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
+        fclose(f);
     }
 };
 
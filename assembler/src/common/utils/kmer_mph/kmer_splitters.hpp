@@ -10,6 +10,7 @@
 #include "kmer_splitter.hpp"
 #include "io/reads/io_helper.hpp"
 #include "adt/iterator_range.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
 namespace utils {
 
@@ -132,6 +133,116 @@ DeBruijnReadKMerSplitter<Read, KmerFilter>::Split(size_t num_files, unsigned nth
   return out;
 }
 
+/**
+ * Splits the k-mers of several sizes during the single pass over the reads: every read is read and parsed
+ * once and its k-mers of all the sizes go to the separate sets of buckets. After Split() the splitter of
+ * each size returns its raw k-mers, so it could be given to KMerDiskCounter in place of
+ * DeBruijnReadKMerSplitter.
+ */
+template<class Read, class KmerFilter>
+class DeBruijnReadMultiKMerSplitter {
+ public:
+  class KSplitter : public DeBruijnKMerSplitter<KmerFilter> {
+    friend class DeBruijnReadMultiKMerSplitter;
+   public:
+    using typename DeBruijnKMerSplitter<KmerFilter>::RawKMers;
+
+    KSplitter(fs::TmpDir work_dir, unsigned K, KmerFilter filter)
+        : DeBruijnKMerSplitter<KmerFilter>(work_dir, K, filter) {}
+
+    RawKMers Split(size_t num_files, unsigned) override {
+      VERIFY_MSG(raw_kmers_.size() == num_files, "k-mers were split into " << raw_kmers_.size() << " files");
+      return std::move(raw_kmers_);
+    }
+
+   private:
+    RawKMers raw_kmers_;
+  };
+
+  DeBruijnReadMultiKMerSplitter(fs::TmpDir work_dir,
+                                const std::vector<unsigned> &Ks,
+                                io::ReadStreamList<Read>& streams,
+                                size_t read_buffer_size = 0,
+                                KmerFilter filter = KmerFilter())
+      : streams_(streams), read_buffer_size_(read_buffer_size) {
+    splitters_.reserve(Ks.size());
+    for (unsigned K : Ks)
+      splitters_.emplace_back(work_dir, K, filter);
+  }
+
+  void Split(size_t num_files, unsigned nthreads);
+
+  size_t size() const { return splitters_.size(); }
+  KSplitter &splitter(size_t i) { return splitters_[i]; }
+
+ private:
+  io::ReadStreamList<Read>& streams_;
+  size_t read_buffer_size_;
+  std::vector<KSplitter> splitters_;
+
+  template<class ReadStream>
+  size_t FillBufferFromStream(ReadStream& stream, unsigned thread_id);
+
+  DECL_LOGGER("DeBruijnReadMultiKMerSplitter");
+};
+
+template<class Read, class KmerFilter> template<class ReadStream>
+size_t
+DeBruijnReadMultiKMerSplitter<Read, KmerFilter>::FillBufferFromStream(ReadStream &stream,
+                                                                      unsigned thread_id) {
+  typename ReadStream::ReadT r;
+  size_t reads = 0;
+
+  while (!stream.eof()) {
+    stream >> r;
+    reads += 1;
+
+    const Sequence &seq = r.sequence();
+    bool stop = false;
+    for (auto &splitter : splitters_)
+      stop |= splitter.FillBufferFromSequence(seq, thread_id);
+    if (stop)
+      break;
+  }
+
+  return reads;
+}
+
+template<class Read, class KmerFilter>
+void DeBruijnReadMultiKMerSplitter<Read, KmerFilter>::Split(size_t num_files, unsigned nthreads) {
+  VERIFY(!splitters_.empty());
+  // The buffers of all the sizes share the memory
+  size_t buffer_size = read_buffer_size_ ? read_buffer_size_ : splitters_.front().DefaultReadsBufferSize(nthreads);
+  buffer_size /= splitters_.size();
+
+  std::vector<typename KSplitter::RawKMers> out;
+  for (auto &splitter : splitters_)
+    out.push_back(splitter.PrepareBuffers(num_files, nthreads, buffer_size));
+
+  size_t counter = 0, n = 15;
+  streams_.reset();
+  while (!streams_.eof()) {
+#   pragma omp parallel for num_threads(nthreads) reduction(+ : counter)
+    for (unsigned i = 0; i < (unsigned)streams_.size(); ++i) {
+      counter += FillBufferFromStream(streams_[i], omp_get_thread_num());
+    }
+
+    for (size_t i = 0; i < splitters_.size(); ++i)
+      splitters_[i].DumpBuffers(out[i]);
+
+    if (counter >> n) {
+      INFO("Processed " << counter << " reads");
+      n += 1;
+    }
+  }
+
+  for (size_t i = 0; i < splitters_.size(); ++i) {
+    splitters_[i].ClearBuffers();
+    splitters_[i].raw_kmers_ = std::move(out[i]);
+  }
+  INFO("Used " << counter << " reads");
+}
+
 template<class KmerFilter, class KMerIterator>
 class DeBruijnKMerKMerSplitter : public DeBruijnKMerSplitter<KmerFilter> {
   using kmer_range = adt::iterator_range<KMerIterator>;
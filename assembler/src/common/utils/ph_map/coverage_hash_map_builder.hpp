@@ -7,13 +7,88 @@
 
 #include "perfect_hash_map_builder.hpp"
 #include "utils/parallel/openmp_wrapper.h"
+#include "utils/verify.hpp"
+
 #include <cstdlib>
+#include <limits>
+#include <vector>
 
 namespace utils {
 
+/*
+ * Direct-mapped cache of the (k-mer index, count) pairs of a thread. The hot
+ * k-mers (adapters, rRNA, organelles) are counted here and go to the shared
+ * counters by a single atomic add on eviction, so their cache lines are not
+ * bounced between the cores on every occurrence.
+ */
+template<class V>
+class CoverageCache {
+    struct Entry {
+        size_t idx;
+        V count;
+    };
+
+  public:
+    // size must be a power of two, zero disables the caching
+    CoverageCache(V *counters, size_t size)
+            : counters_(counters), entries_(size, Entry{EMPTY, 0}), mask_(size - 1) {}
+
+    ~CoverageCache() {
+        flush();
+    }
+
+    void add(size_t idx) {
+        if (entries_.empty()) {
+#           pragma omp atomic
+            counters_[idx] += 1;
+            return;
+        }
+
+        Entry &entry = entries_[idx & mask_];
+        if (entry.idx != idx) {
+            Flush(entry);
+            entry.idx = idx;
+        }
+        entry.count += 1;
+    }
+
+    void flush() {
+        for (auto &entry : entries_)
+            Flush(entry);
+    }
+
+  private:
+    static constexpr size_t EMPTY = std::numeric_limits<size_t>::max();
+
+    V *counters_;
+    std::vector<Entry> entries_;
+    size_t mask_;
+
+    void Flush(Entry &entry) {
+        if (entry.count) {
+#           pragma omp atomic
+            counters_[entry.idx] += entry.count;
+        }
+        entry.idx = EMPTY;
+        entry.count = 0;
+    }
+};
+
 struct CoverageHashMapBuilder : public utils::PerfectHashMapBuilder {
-    template<class ReadStream, class Index>
-    void FillCoverageFromStream(ReadStream &stream, Index &index) const {
+    /*
+     * cache_size is the number of the entries of the per-thread cache of the
+     * counts (a power of two, zero disables it). The threads are split into
+     * the replicas groups, every group adds to its own copy of the counters
+     * (e.g. one per NUMA node), the copies are summed in the end.
+     */
+    explicit CoverageHashMapBuilder(size_t cache_size = 0, unsigned replicas = 1)
+            : cache_size_(cache_size), replicas_(replicas) {
+        VERIFY_MSG(!(cache_size & (cache_size - 1)), "Cache size must be a power of two");
+        VERIFY(replicas > 0);
+    }
+
+    template<class ReadStream, class Index, class Cache>
+    void FillCoverageFromStream(ReadStream &stream, const Index &index, Cache &cache) const {
         typedef typename Index::KeyType Kmer;
         unsigned k = index.k();
 
@@ -31,12 +106,49 @@ struct CoverageHashMapBuilder : public utils::PerfectHashMapBuilder {
                 if (!kwh.is_minimal() || !index.valid(kwh))
                     continue;
 
-#                   pragma omp atomic
-                index.get_raw_value_reference(kwh) += 1;
+                cache.add(kwh.idx());
             }
         }
     }
 
+    // Adds the coverage of the reads to the built index
+    template<class Index, class Streams>
+    void FillCoverage(Index &index, Streams &streams) const {
+        auto &values = this->values(index);
+        typedef typename std::decay<decltype(values)>::type::value_type V;
+        unsigned nthreads = (unsigned)streams.size();
+        unsigned replicas = std::min(replicas_, nthreads);
+
+        // The first group adds to the index itself
+        std::vector<std::vector<V>> copies(replicas - 1);
+
+        streams.reset();
+#       pragma omp parallel num_threads(nthreads)
+        {
+            unsigned thread = omp_get_thread_num(), threads = omp_get_num_threads();
+            unsigned group = thread * replicas / threads;
+            // The copy is allocated by a thread of its group, so its pages are placed close to the group
+            if (group && (thread - 1) * replicas / threads != group)
+                copies[group - 1].resize(values.size());
+#           pragma omp barrier
+
+            CoverageCache<V> cache(group ? copies[group - 1].data() : values.data(), cache_size_);
+#           pragma omp for
+            for (size_t i = 0; i < streams.size(); ++i) {
+                FillCoverageFromStream(streams[i], index, cache);
+            }
+        }
+
+        if (copies.empty())
+            return;
+
+#       pragma omp parallel for num_threads(nthreads)
+        for (size_t i = 0; i < values.size(); ++i) {
+            for (const auto &copy : copies)
+                values[i] += copy[i];
+        }
+    }
+
     template<class Index, class KMerStorage, class Streams>
     void BuildIndex(Index &index,
                     const KMerStorage& storage,
@@ -45,12 +157,11 @@ struct CoverageHashMapBuilder : public utils::PerfectHashMapBuilder {
 
         utils::PerfectHashMapBuilder::BuildIndex(index, storage, nthreads);
         INFO("Collecting k-mer coverage information from reads, this takes a while.");
-
-        streams.reset();
-#       pragma omp parallel for num_threads(nthreads)
-        for (size_t i = 0; i < streams.size(); ++i) {
-            FillCoverageFromStream(streams[i], index);
-        }
+        FillCoverage(index, streams);
     }
+
+  private:
+    size_t cache_size_;
+    unsigned replicas_;
 };
 }
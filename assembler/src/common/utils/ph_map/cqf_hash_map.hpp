@@ -44,8 +44,9 @@ public:
         return values_->lookup(kwh);
     }
 
-    void add_value(const KeyWithHash &kwh, uint64_t value) {
-        values_->add(kwh, value);
+    // false if the CQF is full and the value is not added
+    bool add_value(const KeyWithHash &kwh, uint64_t value) {
+        return values_->add(kwh, value);
     }
 
     template<class Writer>
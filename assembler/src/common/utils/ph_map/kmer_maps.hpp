@@ -6,10 +6,19 @@
 //***************************************************************************
 
 #include "perfect_hash_map.hpp"
+#include "permutation.hpp"
 #include "io/kmers/kmer_iterator.hpp"
+#include "io/kmers/mmapped_writer.hpp"
 #include "utils/filesystem/path_helper.hpp"
 #include "utils/logger/logger.hpp"
 
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 namespace utils {
 
 template<class K, class V, class traits = kmers::kmer_index_traits<K>, class StoringType = SimpleStoring>
@@ -33,24 +42,44 @@ private:
     typename traits::ResultFile kmers_file_;
     mutable std::unique_ptr<KMerStorage> kmers_;
 
-    void SortUniqueKMers() const {
-        if (!kmers_)
-            kmers_.reset(new KMerStorage(*kmers_file_, KMer::GetDataSize(base::k())));
+    // Puts the k-mers into the order of their hash. The k-mers are scattered into the copy of the file when the
+    // disk has room for it, otherwise they are permuted in place.
+    void SortUniqueKMers(unsigned nthreads) const {
+        VERIFY(!kmers_);
+        typedef typename KMer::DataType DataType;
+        const std::string &file = kmers_file_->file();
+        size_t elcnt = KMer::GetDataSize(base::k()), size = fs::filesize(file);
+        size_t n = size / (elcnt * sizeof(DataType));
+        auto idx = [this](typename traits::KMerRawReference s) { return this->raw_seq_idx(s); };
 
-        size_t swaps = 0;
         INFO("Arranging kmers in hash map order");
-        for (auto I = kmers_->begin(), E = kmers_->end(); I != E; ++I) {
-            size_t cidx = I - kmers_->begin();
-            size_t kidx = this->raw_seq_idx(*I);
-            while (cidx != kidx) {
-                auto J = kmers_->begin() + kidx;
-                using std::swap;
-                swap(*I, *J);
-                swaps += 1;
-                kidx = this->raw_seq_idx(*I);
+        if (fs::free_space(fs::parent_path(file)) > size) {
+            auto sorted = kmers_file_->CreateDep("sorted");
+            {
+                KMerStorage ins(file, elcnt, /* unlink */ false);
+                MMappedRecordArrayWriter<DataType> os(sorted->file(), elcnt);
+                os.resize(n);
+                ScatterPermute(ins.begin(), n, os.begin(), idx, nthreads);
             }
+            CHECK_FATAL_ERROR(!std::rename(sorted->file().c_str(), file.c_str()),
+                              "rename(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno);
+            sorted->release();
+        } else if (n) {
+            INFO("Not enough disk space for the copy of " << n << " kmers, arranging in place");
+            // The readers map the files read-only, so the file is mapped here for writing
+            int fd = ::open(file.c_str(), O_RDWR);
+            CHECK_FATAL_ERROR(fd != -1, "open(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno);
+            void *region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_FILE | MAP_SHARED, fd, 0);
+            ::close(fd);
+            CHECK_FATAL_ERROR(region != MAP_FAILED,
+                              "mmap(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno);
+            adt::array_vector<DataType> data((DataType*)region, n, elcnt);
+            InplacePermute(data.begin(), n, idx, nthreads);
+            munmap(region, size);
         }
-        INFO("Done. Total swaps: " << swaps);
+        INFO("Done");
+
+        kmers_.reset(new KMerStorage(file, elcnt));
     }
 
 protected:
@@ -192,6 +221,21 @@ public:
         return io::make_raw_kmer_iterator<KMer>(*this->kmers_, base::k(), parts);
     }
 
+    template<class Writer>
+    void BinWrite(Writer &writer) const {
+        VERIFY(kmers_ && "Index should be built");
+        base::BinWrite(writer);
+        traits::raw_file_serialize(writer, *kmers_);
+    }
+
+    // The k-mers are restored as a temporary file inside workdir
+    template<class Reader>
+    void BinRead(Reader &reader, fs::TmpDir workdir) {
+        base::BinRead(reader);
+        kmers_ = workdir->tmp_file("kmers");
+        traits::raw_file_deserialize(reader, *kmers_);
+    }
+
     friend struct KeyIteratingIndexBuilder;
 };
 
@@ -42,6 +42,13 @@ struct PerfectHashMapBuilder {
         builder.BuildIndex(*index.index_ptr_, storage);
         index.resize(storage.total_kmers());
     }
+
+  protected:
+    // Raw values for the derived builders filling them in bulk
+    template<class K, class V, class traits, class StoringType>
+    static std::vector<V> &values(PerfectHashMap<K, V, traits, StoringType> &index) {
+        return index.data_;
+    }
 };
 
 struct CQFHashMapBuilder {
@@ -97,7 +104,7 @@ struct KeyStoringIndexBuilder {
         auto res = phm_builder_.BuildIndex(index, counter, bucket_num, thread_num, true);
         VERIFY(!index.kmers_.get());
         index.kmers_file_ = res.final_kmers();
-        index.SortUniqueKMers();
+        index.SortUniqueKMers(unsigned(thread_num));
     }
 
   private:
@@ -0,0 +1,109 @@
+#pragma once
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "utils/parallel/openmp_wrapper.h"
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+/*
+ * Writes every element of in[0, n) to out[idx(element)]. idx must be a
+ * bijection onto [0, n), e.g. the perfect hash of the elements. Every thread
+ * reads its own contiguous part of the input and collects the elements in the
+ * buffers of the destination ranges, so the writes of one flush stay within a
+ * single range instead of being spread over the whole output.
+ */
+template<class InIt, class OutIt, class Idx>
+void ScatterPermute(InIt in, size_t n, OutIt out, const Idx &idx, unsigned nthreads) {
+    const size_t buffer_size = 256;
+    const size_t num_ranges = std::min<size_t>(1024, n / 4096 + 1);
+    const size_t range_size = (n + num_ranges - 1) / num_ranges;
+
+#   pragma omp parallel num_threads(nthreads)
+    {
+        // (destination, source) pairs
+        std::vector<std::vector<std::pair<size_t, size_t>>> buffers(num_ranges);
+        auto flush = [&](std::vector<std::pair<size_t, size_t>> &buffer) {
+            for (const auto &entry : buffer)
+                *(out + entry.first) = *(in + entry.second);
+            buffer.clear();
+        };
+
+#       pragma omp for schedule(static)
+        for (size_t i = 0; i < n; ++i) {
+            size_t dst = idx(*(in + i));
+            auto &buffer = buffers[dst / range_size];
+            buffer.emplace_back(dst, i);
+            if (buffer.size() == buffer_size)
+                flush(buffer);
+        }
+
+        for (auto &buffer : buffers)
+            flush(buffer);
+    }
+}
+
+/*
+ * The same permutation in place, for the case there is no room for the second
+ * copy. Every thread rotates the cycles starting at its positions. A position
+ * is claimed by the first thread reaching it and then taken out, so the thread
+ * carrying the element of a position claimed by somebody else just puts it
+ * there and finishes: the other thread rotates the rest of the cycle. Needs two
+ * bits per element.
+ */
+template<class It, class Idx>
+void InplacePermute(It data, size_t n, const Idx &idx, unsigned nthreads) {
+    if (!n)
+        return;
+
+    const size_t num_words = n / 32 + 1;
+    std::unique_ptr<std::atomic<uint64_t>[]> state(new std::atomic<uint64_t>[num_words]);
+    for (size_t i = 0; i < num_words; ++i)
+        state[i].store(0, std::memory_order_relaxed);
+
+    auto claimed_bit = [](size_t pos) { return uint64_t(1) << (2 * (pos % 32)); };
+    auto taken_bit = [](size_t pos) { return uint64_t(2) << (2 * (pos % 32)); };
+    auto claim = [&](size_t pos) {
+        return !(state[pos / 32].fetch_or(claimed_bit(pos), std::memory_order_acq_rel) & claimed_bit(pos));
+    };
+
+#   pragma omp parallel num_threads(nthreads)
+    {
+        typename std::iterator_traits<It>::value_type carried = *data;
+
+#       pragma omp for schedule(dynamic, 1 << 14)
+        for (size_t i = 0; i < n; ++i) {
+            if (!claim(i))
+                continue;
+
+            size_t dst = idx(*(data + i));
+            if (dst == i)
+                continue;
+
+            carried = *(data + i);
+            state[i / 32].fetch_or(taken_bit(i), std::memory_order_release);
+            while (claim(dst)) {
+                size_t next = idx(*(data + dst));
+                using std::swap;
+                swap(carried, *(data + dst));
+                dst = next;
+            }
+
+            // The owner of dst takes its element out right after the claim
+            while (!(state[dst / 32].load(std::memory_order_acquire) & taken_bit(dst)))
+                std::this_thread::yield();
+            *(data + dst) = carried;
+        }
+    }
+}
+
+}
@@ -19,6 +19,9 @@
 #include "utils/kmer_mph/kmer_index_builder.hpp"
 #include "utils/logger/logger.hpp"
 
+#include <mutex>
+#include <vector>
+
 using namespace hammer;
 
 class BufferFiller;
@@ -61,10 +64,10 @@ class BufferFiller {
   BufferFiller(HammerFilteringKMerSplitter &splitter)
       : splitter_(splitter) {}
 
-  bool operator()(std::unique_ptr<Read> r) {
+  bool operator()(const Read &r) {
     int trim_quality = cfg::get().input_trim_quality;
 
-    Read cr = *r;
+    Read cr = r;
     size_t sz = cr.trimNsAndBadQuality(trim_quality);
   
     if (sz < hammer::K)
@@ -160,11 +163,11 @@ class KMerDataFiller {
   KMerDataFiller(KMerData &data)
       : data_(data) {}
 
-  bool operator()(std::unique_ptr<Read> r) {
+  bool operator()(const Read &r) {
     uint8_t trim_quality = (uint8_t)cfg::get().input_trim_quality;
 
     // FIXME: Get rid of this
-    Read cr = *r;
+    Read cr = r;
     size_t sz = cr.trimNsAndBadQuality(trim_quality);
 
     if (sz < hammer::K)
@@ -187,22 +190,36 @@ class KMerDataFiller {
 };
 
 class KMerMultiplicityCounter {
-  qf::cqf_with_hasher<KMer> cqf_;
+  struct KMerHasher {
+      uint64_t operator()(const KMer &k) const {
+          return k.GetHash();
+      }
+  };
+
+  qf::cqf_with_hasher<KMer, KMerHasher> cqf_;
+  // The k-mers refused by the full filter, inserted after the expansion
+  std::vector<KMer> spilled_;
+  std::mutex spill_mutex_;
+
+  void add(const KMer &kmer) {
+      if (cqf_.add(kmer))
+          return;
+
+      std::lock_guard<std::mutex> lock(spill_mutex_);
+      spilled_.push_back(kmer);
+  }
 
   public:
   KMerMultiplicityCounter(size_t size)
-      : cqf_(size, [](const KMer &k) {
-        auto h = k.GetHash();
-        return h;
-      }) {}
+      : cqf_(size) {}
 
   ~KMerMultiplicityCounter() {}
 
-    bool operator()(std::unique_ptr<Read> r) {
+    bool operator()(const Read &r) {
       uint8_t trim_quality = (uint8_t)cfg::get().input_trim_quality;
 
       // FIXME: Get rid of this
-      Read cr = *r;
+      Read cr = r;
       size_t sz = cr.trimNsAndBadQuality(trim_quality);
 
       if (sz < hammer::K)
@@ -212,16 +229,29 @@ class KMerMultiplicityCounter {
       for (; gen.HasMore(); gen.Next()) {
           KMer kmer = gen.kmer();
 
-          cqf_.add(kmer);
-          cqf_.add(!kmer);
+          add(kmer);
+          add(!kmer);
       }
 
-      return false;
+      // Stop the processing, so the filter is expanded before it is full
+      return cqf_.almost_full();
   }
 
   size_t count(const KMer &k) const {
       return cqf_.lookup(k);
   }
+
+  // The estimate was too low, must not run concurrently with the counting
+  void expand_if_full(unsigned nthreads) {
+      if (cqf_.expand_if_full(nthreads))
+          INFO("CQF is full, expanded to " << cqf_.slots() << " slots");
+
+      for (const KMer &kmer : spilled_) {
+          while (!cqf_.add(kmer))
+              cqf_.expand(nthreads);
+      }
+      spilled_.clear();
+  }
 };
 
 class KMerCountEstimator {
@@ -236,11 +266,11 @@ class KMerCountEstimator {
 
   ~KMerCountEstimator() {}
 
-    bool operator()(std::unique_ptr<Read> r) {
+    bool operator()(const Read &r) {
       uint8_t trim_quality = (uint8_t)cfg::get().input_trim_quality;
 
       // FIXME: Get rid of this
-      Read cr = *r;
+      Read cr = r;
       size_t sz = cr.trimNsAndBadQuality(trim_quality);
 
       if (sz < hammer::K)
@@ -263,10 +293,7 @@ class KMerCountEstimator {
   }
 
   void merge() {
-      for (size_t i = 1; i < hll_.size(); ++i) {
-          hll_[0].merge(hll_[i]);
-          hll_[i].clear();
-      }
+      hll::tree_merge(hll_, unsigned(hll_.size()));
   }
 };
 
@@ -319,6 +346,7 @@ void KMerDataCounter::BuildKMerIndex(KMerData &data) {
               rp.Run(irs, mcounter);
               VERIFY_MSG(rp.read() == rp.processed(), "Queue unbalanced");
               processed += rp.processed();
+              mcounter.expand_if_full(omp_get_max_threads());
 
               if (processed >> n) {
                   INFO("Processed " << processed << " reads");
@@ -8,11 +8,13 @@
 #include "pair_info_count.hpp"
 
 #include "assembly_graph/core/basic_graph_stats.hpp"
+#include "paired_info/edge_pair_filter.hpp"
 #include "paired_info/is_counter.hpp"
 #include "paired_info/pair_info_filler.hpp"
 
 #include "modules/alignment/long_read_mapper.hpp"
 #include "modules/alignment/bwa_sequence_mapper.hpp"
+#include "modules/alignment/mapping_cache.hpp"
 #include "modules/alignment/rna/ss_coverage_filler.hpp"
 
 #include "io/dataset_support/read_converter.hpp"
@@ -28,21 +30,23 @@ namespace debruijn_graph {
 namespace {
 
 using SequencingLib = io::SequencingLibrary<config::LibraryData>;
-using PairedInfoFilter = bf::counting_bloom_filter<std::pair<EdgeId, EdgeId>, 2>;
+
+using PairedInfoFilter = omnigraph::de::EdgePairFilter<EdgeId>;
 using EdgePairCounter = hll::hll_with_hasher<std::pair<EdgeId, EdgeId>>;
 
-std::shared_ptr<SequenceMapper<Graph>> ChooseProperMapper(const GraphPack& gp,
+std::shared_ptr<SequenceMapper<Graph>> ChooseProperMapper(GraphPack& gp,
                                                           const SequencingLib& library) {
-    const auto &graph = gp.get<Graph>();
+    // BWA index is owned by graph pack and is reused until the graph is changed
+    auto &bwa_index = gp.get_mutable<alignment::BWAIndexHolder>();
 
     if (library.type() == io::LibraryType::MatePairs) {
         INFO("Mapping mate-pairs using BWA-mem mapper");
-        return std::make_shared<alignment::BWAReadMapper<Graph>>(graph);
+        return std::make_shared<alignment::BWAReadMapper<Graph>>(bwa_index.index());
     }
 
     if (library.data().unmerged_read_length < gp.k() && library.type() == io::LibraryType::PairedEnd) {
         INFO("Mapping PE reads shorter than K with BWA-mem mapper");
-        return std::make_shared<alignment::BWAReadMapper<Graph>>(graph);
+        return std::make_shared<alignment::BWAReadMapper<Graph>>(bwa_index.index());
     }
 
     INFO("Selecting usual mapper");
@@ -103,6 +107,13 @@ class EdgePairCounterFiller : public SequenceMapperListener {
         buf_[i].clear();
     }
 
+    bool HasMergeableBuffers() const override { return true; }
+
+    void MergeBuffers(size_t dst, size_t src) override {
+        buf_[dst].merge(buf_[src]);
+        buf_[src].clear();
+    }
+
     void ProcessPairedRead(size_t idx,
                            const io::PairedRead&,
                            const MappingPath<EdgeId>& read1,
@@ -196,9 +207,10 @@ bool ShouldObtainSingleReadsPaths(size_t ilib) {
     return false;
 }
 
-bool CollectLibInformation(const GraphPack &gp,
+bool CollectLibInformation(GraphPack &gp,
                            size_t &edgepairs,
-                           size_t ilib, size_t edge_length_threshold) {
+                           size_t ilib, size_t edge_length_threshold,
+                           MappingCache &mapping_cache) {
     INFO("Estimating insert size (takes a while)");
     InsertSizeCounter hist_counter(gp.get<Graph>(), edge_length_threshold);
     EdgePairCounterFiller pcounter(cfg::get().max_threads);
@@ -212,7 +224,7 @@ bool CollectLibInformation(const GraphPack &gp,
     auto paired_streams = paired_binary_readers(reads, /*followed by rc*/false, /*insert_size*/0,
                                                 /*include_merged*/true);
 
-    notifier.ProcessLibrary(paired_streams, ilib, *ChooseProperMapper(gp, reads));
+    notifier.ProcessLibrary(paired_streams, ilib, *ChooseProperMapper(gp, reads), 0, &mapping_cache);
     //Check read length after lib processing since mate pairs a not used until this step
     VERIFY(reads.data().unmerged_read_length != 0);
 
@@ -285,7 +297,8 @@ size_t ProcessSingleReads(GraphPack &gp, size_t ilib,
 void ProcessPairedReads(GraphPack &gp,
                                std::unique_ptr<PairedInfoFilter> filter,
                                unsigned filter_threshold,
-                               size_t ilib) {
+                               size_t ilib,
+                               MappingCache &mapping_cache) {
     SequencingLib &reads = cfg::get_writable().ds.reads[ilib];
     const auto &data = reads.data();
 
@@ -320,7 +333,7 @@ void ProcessPairedReads(GraphPack &gp,
 
     auto paired_streams = paired_binary_readers(reads, /*followed by rc*/false, (size_t) data.mean_insert_size,
                                                 /*include merged*/true);
-    notifier.ProcessLibrary(paired_streams, ilib, *ChooseProperMapper(gp, reads));
+    notifier.ProcessLibrary(paired_streams, ilib, *ChooseProperMapper(gp, reads), 0, &mapping_cache);
 }
 
 } // namespace
@@ -352,8 +365,12 @@ void PairInfoCount::run(GraphPack &gp, const char *) {
                 size_t rl = lib_data.unmerged_read_length;
                 size_t k = cfg::get().K;
 
+                // All the passes over paired reads below use the same set of
+                // streams, so map the reads once and replay the mappings afterwards
+                MappingCache mapping_cache(fs::tmp::make_temp_dir(gp.workdir(), "mapping_cache"));
+
                 size_t edgepairs = 0;
-                if (!CollectLibInformation(gp, edgepairs, i, edge_length_threshold)) {
+                if (!CollectLibInformation(gp, edgepairs, i, edge_length_threshold, mapping_cache)) {
                     cfg::get_writable().ds.reads[i].data().mean_insert_size = 0.0;
                     WARN("Unable to estimate insert size for paired library #" << i);
                     if (rl > 0 && rl <= k) {
@@ -381,11 +398,7 @@ void PairInfoCount::run(GraphPack &gp, const char *) {
 
                 // Only filter paired-end libraries
                 if (filter_threshold && lib.type() == io::LibraryType::PairedEnd) {
-                    filter.reset(new PairedInfoFilter([](const std::pair<EdgeId, EdgeId> &e, uint64_t seed) {
-                                uint64_t h1 = e.first.hash();
-                                return XXH3_64bits_withSeed(&h1, sizeof(h1), (e.second.hash() * seed) ^ seed);
-                            },
-                            12 * edgepairs));
+                    filter.reset(new PairedInfoFilter(omnigraph::de::EdgePairFilterHasher<EdgeId>(), 12 * edgepairs));
 
                     INFO("Filtering data for library #" << i);
                     {
@@ -395,14 +408,14 @@ void PairInfoCount::run(GraphPack &gp, const char *) {
 
                         VERIFY(lib.data().unmerged_read_length != 0);
                         auto reads = paired_binary_readers(lib, /*followed by rc*/false, 0, /*include merged*/true);
-                        notifier.ProcessLibrary(reads, i, *ChooseProperMapper(gp, lib));
+                        notifier.ProcessLibrary(reads, i, *ChooseProperMapper(gp, lib), 0, &mapping_cache);
                     }
                 }
 
                 INFO("Mapping library #" << i);
                 if (lib.data().mean_insert_size != 0.0) {
                     INFO("Mapping paired reads (takes a while) ");
-                    ProcessPairedReads(gp, std::move(filter), filter_threshold, i);
+                    ProcessPairedReads(gp, std::move(filter), filter_threshold, i, mapping_cache);
                 }
             }
 
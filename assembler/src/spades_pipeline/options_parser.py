@@ -733,6 +733,12 @@ def add_hidden_args(pgroup_hidden):
                                help="sets size of read buffer for graph construction"
                                if show_help_hidden else argparse.SUPPRESS,
                                action="store")
+    pgroup_hidden.add_argument("--precount-kmers",
+                               dest="precount_kmers",
+                               default=False,
+                               help="counts k+1-mers for all K during the first iteration in a single pass over the reads"
+                               if show_help_hidden else argparse.SUPPRESS,
+                               action="store_true")
     pgroup_hidden.add_argument("--large-genome",
                                dest="large_genome",
                                default=False,
@@ -970,6 +976,7 @@ def add_to_cfg(cfg, log, bin_home, spades_home, args):
         cfg["assembly"].__dict__["save_gp"] = args.save_gp
         if args.read_buffer_size:
             cfg["assembly"].__dict__["read_buffer_size"] = args.read_buffer_size
+        cfg["assembly"].__dict__["precount_kmers"] = args.precount_kmers
         cfg["assembly"].__dict__["correct_scaffolds"] = options_storage.correct_scaffolds
 
     # corrector can work only if contigs exist (not only error correction)
@@ -82,17 +82,26 @@ def vars_from_lines(lines):
     return vars
 
 
-def substitute_params(filename, var_dict, log):
+# the vars missing in the file are added next to the anchor var (if given)
+def substitute_params(filename, var_dict, log, anchor=None):
     lines = file_lines(filename)
     vars_in_file = vars_from_lines(lines)
+    added = []
 
     for var, value in var_dict.items():
         if var not in vars_in_file:
-            support.error("Couldn't find %s in %s" % (var, filename), log)
+            if anchor is None or anchor not in vars_in_file:
+                support.error("Couldn't find %s in %s" % (var, filename), log)
+            added.append(vars_in_file[anchor].indent + str(var) + " " + str(value) + "\n")
+            continue
 
         meta = vars_in_file[var]
         lines[meta.line_num] = meta.indent + str(var) + " " + str(value) + "\n"
 
+    if added:
+        pos = vars_in_file[anchor].line_num + 1
+        lines[pos:pos] = added
+
     f = open(filename, "w")
     f.writelines(lines)
     f.close()
@@ -113,12 +113,19 @@ def prepare_config_bgcspades(filename, cfg, log):
         subst_dict["start_only_from_tips"] = bool_to_str(True)
     process_cfg.substitute_params(filename, subst_dict, log)
 
-def prepare_config_construction(filename, log):
-    if options_storage.args.read_cov_threshold is None:
-        return
+def prepare_config_construction(filename, cfg, K, prev_K, log):
     subst_dict = dict()
-    subst_dict["read_cov_threshold"] = options_storage.args.read_cov_threshold
-    process_cfg.substitute_params(filename, subst_dict, log)
+    if options_storage.args.read_cov_threshold is not None:
+        subst_dict["read_cov_threshold"] = options_storage.args.read_cov_threshold
+    # k+1-mers of all the iterations are counted by the first one
+    if "precount_kmers" in cfg.__dict__ and cfg.precount_kmers:
+        if prev_K is None:
+            subst_dict["precount_k"] = ",".join(str(k) for k in cfg.iterative_K if k > K)
+        else:
+            subst_dict["use_precounted"] = bool_to_str(True)
+    if subst_dict:
+        # precount_k and use_precounted are missing in the configs of the older installations
+        process_cfg.substitute_params(filename, subst_dict, log, anchor="read_buffer_size")
 
 
 class IterationStage(stage.Stage):
@@ -159,7 +166,7 @@ class IterationStage(stage.Stage):
 
         prepare_config_rnaspades(os.path.join(dst_configs, "rna_mode.info"), self.log)
         prepare_config_bgcspades(os.path.join(dst_configs, "hmm_mode.info"), cfg, self.log)
-        prepare_config_construction(os.path.join(dst_configs, "construction.info"), self.log)
+        prepare_config_construction(os.path.join(dst_configs, "construction.info"), cfg, self.K, self.prev_K, self.log)
         cfg_fn = os.path.join(dst_configs, "config.info")
         prepare_config_spades(cfg_fn, cfg, self.log, additional_contigs_dname, self.K, self.get_stage(self.short_name),
                               saves_dir, self.last_one, self.bin_home)
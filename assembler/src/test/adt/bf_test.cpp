@@ -0,0 +1,125 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "adt/bf.hpp"
+
+#define XXH_INLINE_ALL
+#include "xxh/xxhash.h"
+
+#include <cmath>
+#include <gtest/gtest.h>
+
+namespace {
+
+struct Hasher {
+    uint64_t operator()(uint64_t x, uint64_t seed) const {
+        return XXH3_64bits_withSeed(&x, sizeof(x), seed);
+    }
+};
+
+const size_t CELLS = 1 << 22;
+const size_t QUERIES = 1 << 20;
+
+// (1 - e^{-kn/m})^k
+double ClassicFPRate(size_t cells, size_t n, size_t k) {
+    return std::pow(1 - std::exp(-double(k * n) / double(cells)), double(k));
+}
+
+// The blocks get Poisson(n / blocks) elements, a block with i elements gives
+// the classic rate of its own
+double BlockedFPRate(size_t cells, size_t n, size_t k, size_t block_cells) {
+    double load = double(n * block_cells) / double(cells);
+    double res = 0, poisson = std::exp(-load);
+    for (size_t i = 0; i < 10 * size_t(load) + 100; ++i) {
+        res += poisson * std::pow(1 - std::pow(1 - 1.0 / double(block_cells), double(k * i)), double(k));
+        poisson *= load / double(i + 1);
+    }
+    return res;
+}
+
+template<class Filter>
+double FPRate(Filter &filter, size_t n) {
+    for (uint64_t i = 0; i < n; ++i)
+        filter.add(i);
+
+    // No false negatives
+    for (uint64_t i = 0; i < n; ++i)
+        EXPECT_GT(filter.lookup(i), 0u);
+
+    size_t fp = 0;
+    for (uint64_t i = n; i < n + QUERIES; ++i)
+        fp += filter.lookup(i) > 0;
+    return double(fp) / double(QUERIES);
+}
+
+}
+
+TEST(CountingBloomFilter, Counts) {
+    bf::counting_bloom_filter<uint64_t, 4, Hasher> filter(Hasher(), 1 << 16);
+    for (uint64_t i = 0; i < 100; ++i)
+        for (uint64_t j = 0; j < i % 20; ++j)
+            filter.add(i);
+
+    // Saturates at 15
+    for (uint64_t i = 0; i < 100; ++i)
+        EXPECT_EQ(std::min<size_t>(i % 20, 15), filter.lookup(i));
+
+    filter.clear();
+    EXPECT_EQ(0u, filter.lookup(5));
+}
+
+TEST(CountingBloomFilter, StdFunctionHasher) {
+    bf::counting_bloom_filter<uint64_t, 2> filter(Hasher(), 1 << 10);
+    filter.add(1);
+    filter.add(1);
+    EXPECT_EQ(2u, filter.lookup(1));
+}
+
+TEST(CountingBloomFilter, FPRate) {
+    for (size_t k : { 2, 3, 5 }) {
+        for (size_t cells_per_element : { 8, 12, 20 }) {
+            bf::counting_bloom_filter<uint64_t, 2, Hasher> filter(Hasher(), CELLS, k);
+            size_t n = CELLS / cells_per_element;
+            double expected = ClassicFPRate(CELLS, n, k);
+            EXPECT_NEAR(expected, FPRate(filter, n), 0.1 * expected + 1e-4)
+                    << "k = " << k << ", cells per element = " << cells_per_element;
+        }
+    }
+}
+
+TEST(BlockedCountingBloomFilter, Counts) {
+    bf::blocked_counting_bloom_filter<uint64_t, 4, Hasher> filter(Hasher(), 1 << 16);
+    for (uint64_t i = 0; i < 100; ++i)
+        for (uint64_t j = 0; j < i % 20; ++j)
+            filter.add(i);
+
+    for (uint64_t i = 0; i < 100; ++i)
+        EXPECT_EQ(std::min<size_t>(i % 20, 15), filter.lookup(i));
+
+    filter.clear();
+    EXPECT_EQ(0u, filter.lookup(5));
+}
+
+TEST(BlockedCountingBloomFilter, FPRate) {
+    // Up to 9 counters need the second digest for the width 2
+    for (size_t k : { 2, 3, 5, 9 }) {
+        for (size_t cells_per_element : { 8, 12, 20 }) {
+            bf::blocked_counting_bloom_filter<uint64_t, 2, Hasher> filter(Hasher(), CELLS, k);
+            ASSERT_EQ(CELLS, filter.cells());
+            size_t n = CELLS / cells_per_element;
+            double expected = BlockedFPRate(CELLS, n, k, 256);
+            EXPECT_NEAR(expected, FPRate(filter, n), 0.1 * expected + 1e-4)
+                    << "k = " << k << ", cells per element = " << cells_per_element;
+            // Not much worse than the classic filter
+            EXPECT_LT(expected, 1.5 * ClassicFPRate(CELLS, n, k) + 1e-3);
+        }
+    }
+}
+
+GTEST_API_ int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
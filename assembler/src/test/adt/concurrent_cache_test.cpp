@@ -0,0 +1,68 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "adt/concurrent_cache.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+
+#include <gtest/gtest.h>
+
+TEST(ConcurrentCache, FindInsert) {
+    adt::concurrent_cache<uint64_t, uint64_t> cache(1000, 4);
+    uint64_t value = 0;
+    EXPECT_FALSE(cache.find(1, value));
+    cache.insert(1, 42);
+    ASSERT_TRUE(cache.find(1, value));
+    EXPECT_EQ(42u, value);
+    cache.insert(1, 43);
+    ASSERT_TRUE(cache.find(1, value));
+    EXPECT_EQ(43u, value);
+    EXPECT_EQ(1u, cache.size());
+    cache.clear();
+    EXPECT_FALSE(cache.find(1, value));
+}
+
+TEST(ConcurrentCache, Bounded) {
+    const size_t capacity = 1024;
+    adt::concurrent_cache<uint64_t, uint64_t> cache(capacity, 8);
+    for (uint64_t i = 0; i < 100 * capacity; ++i) {
+        cache.insert(i, i * i);
+        EXPECT_LE(cache.size(), capacity);
+    }
+}
+
+TEST(ConcurrentCache, KeepsUsedEntries) {
+    const size_t capacity = 1024;
+    adt::concurrent_cache<uint64_t, uint64_t> cache(capacity, 1);
+    uint64_t value;
+    for (uint64_t i = 0; i < capacity; ++i)
+        cache.insert(i, i);
+    // The hot entry survives the evictions as long as it is used between them
+    for (uint64_t i = capacity; i < 10 * capacity; ++i) {
+        ASSERT_TRUE(cache.find(0, value));
+        cache.insert(i, i);
+    }
+    EXPECT_TRUE(cache.find(0, value));
+}
+
+TEST(ConcurrentCache, Parallel) {
+    adt::concurrent_cache<uint64_t, uint64_t> cache(1 << 12);
+    size_t wrong = 0;
+#   pragma omp parallel for num_threads(8) reduction(+:wrong)
+    for (uint64_t i = 0; i < (1 << 18); ++i) {
+        uint64_t key = i % 10000, value;
+        if (cache.find(key, value))
+            wrong += value != key * 3;
+        else
+            cache.insert(key, key * 3);
+    }
+    EXPECT_EQ(0u, wrong);
+    EXPECT_LE(cache.size(), size_t(1 << 12));
+}
+
+GTEST_API_ int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
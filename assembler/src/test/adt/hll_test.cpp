@@ -0,0 +1,103 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "adt/hll.hpp"
+
+#include <random>
+#include <gtest/gtest.h>
+
+namespace {
+
+uint64_t Mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+}
+
+TEST(HLL, SparseUpgradesToDense) {
+    hll::hll<16> sketch;
+    for (uint64_t i = 0; i < 1000; ++i)
+        sketch.add(Mix(i));
+    EXPECT_FALSE(sketch.dense());
+    // The same elements once again
+    for (uint64_t i = 0; i < 1000; ++i)
+        sketch.add(Mix(i));
+    EXPECT_FALSE(sketch.dense());
+    EXPECT_NEAR(1000, sketch.cardinality(), 10);
+
+    for (uint64_t i = 1000; i < 100000; ++i)
+        sketch.add(Mix(i));
+    EXPECT_TRUE(sketch.dense());
+    EXPECT_NEAR(100000, sketch.cardinality(), 2000);
+
+    sketch.clear();
+    EXPECT_FALSE(sketch.dense());
+    EXPECT_EQ(0, sketch.cardinality());
+}
+
+TEST(HLL, Accuracy) {
+    // The standard error is 1.04 / sqrt(2^precision)
+    for (size_t n : { 10, 1000, 30000, 1000000 }) {
+        hll::hll<14> sketch;
+        for (uint64_t i = 0; i < n; ++i)
+            sketch.add(Mix(i + 12345));
+        EXPECT_NEAR(double(n), sketch.cardinality(), 0.03 * double(n) + 1) << "n = " << n;
+    }
+}
+
+// The merge of any representations gives the same registers as a single sketch
+TEST(HLL, TreeMergeEqualsSingleSketch) {
+    std::mt19937_64 rng(42);
+    for (size_t sketches : { 1, 2, 5, 8 }) {
+        hll::hll<16> single;
+        std::vector<hll::hll<16>> parts(sketches);
+        for (size_t j = 0; j < sketches; ++j) {
+            // Both sparse and dense ones
+            size_t n = j % 2 ? 100000 : 300;
+            for (size_t i = 0; i < n; ++i) {
+                uint64_t d = rng();
+                single.add(d);
+                parts[j].add(d);
+            }
+        }
+
+        hll::tree_merge(parts, 4);
+        EXPECT_EQ(single.cardinality(), parts[0].cardinality());
+        for (size_t j = 1; j < sketches; ++j)
+            EXPECT_EQ(0, parts[j].cardinality());
+    }
+}
+
+TEST(HLL, KernelsAgree) {
+    if (!hll::impl::HasAVX2())
+        GTEST_SKIP() << "AVX2 is not supported";
+
+    std::mt19937_64 rng(42);
+    std::vector<uint8_t> a(1 << 12), b(1 << 12);
+    for (size_t i = 0; i < a.size(); ++i) {
+        a[i] = uint8_t(rng() % 3 ? rng() % 20 : 0);
+        b[i] = uint8_t(rng() % 3 ? rng() % 20 : 0);
+    }
+
+    size_t zeros_scalar, zeros_avx2;
+    double sum_scalar = hll::impl::HarmonicSumScalar(a.data(), a.size(), zeros_scalar);
+    double sum_avx2 = hll::impl::HarmonicSumAVX2(a.data(), a.size(), zeros_avx2);
+    EXPECT_EQ(sum_scalar, sum_avx2);
+    EXPECT_EQ(zeros_scalar, zeros_avx2);
+    EXPECT_EQ(size_t(std::count(a.begin(), a.end(), 0)), zeros_scalar);
+
+    auto merged_scalar = a, merged_avx2 = a;
+    hll::impl::MergeScalar(merged_scalar.data(), b.data(), b.size() - 5);
+    hll::impl::MergeAVX2(merged_avx2.data(), b.data(), b.size() - 5);
+    EXPECT_EQ(merged_scalar, merged_avx2);
+}
+
+GTEST_API_ int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,197 @@
+//***************************************************************************
+//* Copyright (c) 2020 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "utils/logger/logger.hpp"
+#include "utils/logger/log_writers.hpp"
+
+#include "utils/kmer_mph/kmer_splitter.hpp"
+#include "utils/kmer_mph/kmer_splitters.hpp"
+#include "utils/kmer_mph/kmer_index_builder.hpp"
+#include "io/reads/single_read.hpp"
+#include "io/reads/vector_reader.hpp"
+#include "sequence/rtseq.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// Fills the per-thread buffers in a round-robin way from a single thread, so
+// the set of k-mers in every dump does not depend on the scheduling.
+class TestKMerSplitter : public kmers::KMerSortingSplitter<RtSeq> {
+  public:
+    using typename kmers::KMerSortingSplitter<RtSeq>::RawKMers;
+
+    TestKMerSplitter(fs::TmpDir work_dir, unsigned K,
+                     const std::vector<RtSeq> &kmers, bool async)
+            : kmers::KMerSortingSplitter<RtSeq>(work_dir, K), kmers_(kmers) {
+        set_async_dump(async);
+    }
+
+    RawKMers Split(size_t num_files, unsigned nthreads) override {
+        auto out = this->PrepareBuffers(num_files, nthreads, 1);
+
+        size_t dumps = 0;
+        for (size_t i = 0; i < kmers_.size(); ++i) {
+            if (this->push_back_internal(kmers_[i], unsigned(i % nthreads))) {
+                this->DumpBuffers(out);
+                dumps += 1;
+            }
+        }
+        this->DumpBuffers(out);
+        this->ClearBuffers();
+
+        EXPECT_GT(dumps, 1);
+
+        return out;
+    }
+
+  private:
+    const std::vector<RtSeq> &kmers_;
+};
+
+std::vector<char> ReadFile(const std::string &filename) {
+    std::ifstream is(filename, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+std::vector<RtSeq> RandomKMers(unsigned K, size_t n, size_t distinct) {
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> nucl(0, 3);
+
+    std::vector<RtSeq> pool;
+    for (size_t i = 0; i < distinct; ++i) {
+        RtSeq kmer(K);
+        for (unsigned j = 0; j < K; ++j)
+            kmer = kmer << char(nucl(rng));
+        pool.push_back(kmer);
+    }
+
+    std::uniform_int_distribution<size_t> pick(0, distinct - 1);
+    std::vector<RtSeq> res;
+    for (size_t i = 0; i < n; ++i)
+        res.push_back(pool[pick(rng)]);
+
+    return res;
+}
+
+struct AllKMers {
+    bool filter(const RtSeq &) const { return true; }
+};
+
+using ReadStreams = io::ReadStreamList<io::SingleReadSeq>;
+
+ReadStreams RandomReads(size_t n, size_t length, size_t nstreams, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<std::vector<io::SingleReadSeq>> reads(nstreams);
+    for (size_t i = 0; i < n; ++i) {
+        std::string s;
+        for (size_t j = 0; j < length; ++j)
+            s += "ACGT"[rng() & 3];
+        reads[i % nstreams].emplace_back(Sequence(s));
+    }
+
+    ReadStreams streams;
+    for (const auto &chunk : reads)
+        streams.push_back(io::VectorReadStream<io::SingleReadSeq>(chunk));
+    return streams;
+}
+
+std::set<std::string> CountedKMers(const kmers::KMerDiskStorage<RtSeq> &storage) {
+    std::set<std::string> res;
+    for (size_t i = 0; i < storage.num_buckets(); ++i) {
+        for (auto it = storage.bucket_begin(i); it != storage.bucket_end(i); ++it)
+            EXPECT_TRUE(res.insert(RtSeq(storage.k(), it->first).str()).second);
+    }
+    return res;
+}
+
+std::set<std::string> CountKMers(fs::TmpDir tmp, unsigned K, ReadStreams &streams, unsigned num_buckets) {
+    kmers::KMerDiskCounter<RtSeq>
+            counter(tmp, utils::DeBruijnReadKMerSplitter<io::SingleReadSeq, AllKMers>(tmp, K, streams, 1 << 20));
+    return CountedKMers(counter.Count(num_buckets, unsigned(streams.size())));
+}
+
+}
+
+TEST(KMerSplitter, MultiK) {
+    const std::vector<unsigned> Ks = { 22, 34, 56 };
+    const unsigned num_buckets = 8;
+    auto tmp = fs::tmp::make_temp_dir(".", "kmer_splitter_test");
+    auto streams = RandomReads(2000, 150, 2, 42);
+
+    utils::DeBruijnReadMultiKMerSplitter<io::SingleReadSeq, AllKMers> splitter(tmp, Ks, streams, 1 << 20);
+    splitter.Split(num_buckets, 2);
+    ASSERT_EQ(Ks.size(), splitter.size());
+    for (size_t i = 0; i < Ks.size(); ++i) {
+        kmers::KMerDiskCounter<RtSeq> counter(tmp, std::move(splitter.splitter(i)));
+        auto counted = CountedKMers(counter.Count(num_buckets, 2));
+        EXPECT_FALSE(counted.empty());
+        EXPECT_EQ(CountKMers(tmp, Ks[i], streams, num_buckets), counted);
+    }
+}
+
+TEST(KMerSplitter, Precounted) {
+    const unsigned K = 34, num_buckets = 8;
+    auto tmp = fs::tmp::make_temp_dir(".", "kmer_splitter_test");
+    auto reads = RandomReads(2000, 150, 2, 42), contigs = RandomReads(50, 1000, 2, 43);
+
+    kmers::KMerDiskCounter<RtSeq>
+            counter(tmp, utils::DeBruijnReadKMerSplitter<io::SingleReadSeq, AllKMers>(tmp, K, reads, 1 << 20));
+    auto precounted = counter.Count(num_buckets, 2);
+    std::set<std::string> expected = CountedKMers(precounted);
+    auto contig_kmers = CountKMers(tmp, K, contigs, num_buckets);
+    expected.insert(contig_kmers.begin(), contig_kmers.end());
+
+    kmers::KMerPrecountedSplitter<RtSeq>
+            splitter(tmp, std::move(precounted),
+                     utils::DeBruijnReadKMerSplitter<io::SingleReadSeq, AllKMers>(tmp, K, contigs, 1 << 20));
+    kmers::KMerDiskCounter<RtSeq> precounted_counter(tmp, std::move(splitter));
+    EXPECT_EQ(expected, CountedKMers(precounted_counter.Count(num_buckets, 2)));
+}
+
+TEST(KMerSplitter, AsyncDumpMatchesSync) {
+    const unsigned K = 31, nthreads = 2;
+    const size_t num_files = 4;
+    auto kmers = RandomKMers(K, 1000000, 300000);
+
+    auto tmp = fs::tmp::make_temp_dir(".", "kmer_splitter_test");
+
+    TestKMerSplitter sync_splitter(tmp, K, kmers, false);
+    auto sync_out = sync_splitter.Split(num_files, nthreads);
+
+    TestKMerSplitter async_splitter(tmp, K, kmers, true);
+    auto async_out = async_splitter.Split(num_files, nthreads);
+
+    ASSERT_EQ(sync_out.size(), num_files);
+    ASSERT_EQ(async_out.size(), num_files);
+    for (size_t i = 0; i < num_files; ++i) {
+        auto sync_data = ReadFile(sync_out[i]->file());
+        EXPECT_FALSE(sync_data.empty());
+        EXPECT_EQ(sync_data, ReadFile(async_out[i]->file()));
+        EXPECT_EQ(ReadFile(sync_out[i]->file() + ".idx"), ReadFile(async_out[i]->file() + ".idx"));
+    }
+}
+
+void create_console_logger() {
+    using namespace logging;
+
+    logger *lg = create_logger("");
+    lg->add_writer(std::make_shared<console_writer>());
+    attach_logger(lg);
+}
+
+GTEST_API_ int main(int argc, char **argv) {
+  create_console_logger();
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,6 +1,8 @@
 #include "utils/logger/logger.hpp"
 #include "utils/logger/log_writers.hpp"
 #include "utils/stl_utils.hpp"
+#include "utils/ph_map/permutation.hpp"
+#include "adt/array_vector.hpp"
 #include "boomphf/BooPHF.h"
 
 #include <iostream>
@@ -71,6 +73,43 @@ TEST_F(PHMTest, collision_test) {
     }
 }
 
+TEST_F(PHMTest, scatter_test) {
+    std::vector<uint64_t> sorted(vals_.size());
+    utils::ScatterPermute(vals_.begin(), vals_.size(), sorted.begin(),
+                          [&](uint64_t key) { return phm_.lookup(key); }, 4);
+    for (size_t i = 0; i < sorted.size(); ++i)
+        ASSERT_EQ(i, phm_.lookup(sorted[i]));
+}
+
+TEST_F(PHMTest, inplace_test) {
+    std::vector<uint64_t> data(vals_);
+    utils::InplacePermute(data.begin(), data.size(),
+                          [&](uint64_t key) { return phm_.lookup(key); }, 4);
+    for (size_t i = 0; i < data.size(); ++i)
+        ASSERT_EQ(i, phm_.lookup(data[i]));
+}
+
+// Records of several words, as the raw k-mers
+TEST_F(PHMTest, inplace_array_test) {
+    const size_t n = 100000;
+    std::vector<uint64_t> storage;
+    for (size_t i = 0; i < n; ++i) {
+        storage.push_back(vals_[i]);
+        storage.push_back(~vals_[i]);
+    }
+
+    phm small;
+    small.init(n, phm::ConflictPolicy::Warning, 1, 0.03f, 10);
+    small.build(boomphf::range(vals_.begin(), vals_.begin() + n));
+    adt::array_vector<uint64_t> data(storage.data(), n, 2);
+    auto idx = [&](adt::array_vector<uint64_t>::reference r) { return small.lookup(r.data()[0]); };
+    utils::InplacePermute(data.begin(), n, idx, 4);
+    for (size_t i = 0; i < n; ++i) {
+        ASSERT_EQ(i, idx(data[i]));
+        ASSERT_EQ(~data[i].data()[0], data[i].data()[1]);
+    }
+}
+
 void create_console_logger() {
     using namespace logging;
 
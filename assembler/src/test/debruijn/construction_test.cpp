@@ -13,13 +13,19 @@
 #include "pipeline/graph_pack.hpp" // FIXME: get rid of it
 #include "modules/graph_construction.hpp"
 #include "modules/alignment/edge_index.hpp"
+#include "utils/kmer_counting.hpp"
+#include "adt/cqf.hpp"
 
 #include "test_utils.hpp"
 #include "tmp_folder_fixture.hpp"
 
 #include <vector>
 #include <set>
+#include <sstream>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <random>
 
 #include <gtest/gtest.h>
 
@@ -96,6 +102,196 @@ TEST_F( GraphConstruction, TestKmerFreeIndex ) {
     CheckIndex(reads, tmp_folder(), 5);
 }
 
+TEST_F( GraphConstruction, ConstructionStorageSaveLoad ) {
+    typedef io::VectorReadStream<io::SingleRead> RawStream;
+    std::vector<std::string> reads = { "CGAAACCAC", "CGAAAACAC", "AACCACACC", "AAACACACC" };
+    std::vector<std::string> edges = { "CGAAAACACAC", "CACACC", "CGAAACCACAC" };
+    unsigned k = 5;
+
+    auto workdir = fs::tmp::make_temp_dir(tmp_folder(), "tests");
+    io::ReadStreamList<io::SingleRead> streams(io::RCWrap<io::SingleRead>(RawStream(MakeReads(reads))));
+    utils::DeBruijnExtensionIndex<> ext(k);
+    auto kmers = utils::DeBruijnExtensionIndexBuilder().BuildExtensionIndexFromStream(workdir, ext, streams);
+
+    qf::cqf cqf(100);
+    for (uint64_t d = 1; d < 100; ++d)
+        cqf.add(d * 0x9E3779B97F4A7C15ull, d % 7 + 1);
+    // The loaded filter takes the geometry of the saved one
+    cqf.expand();
+
+    std::stringstream ss;
+    ext.BinWrite(ss);
+    kmers.serialize(ss);
+    cqf.serialize(ss);
+
+    auto loaddir = fs::tmp::make_temp_dir(tmp_folder(), "tests");
+    utils::DeBruijnExtensionIndex<> loaded_ext(k);
+    loaded_ext.BinRead(ss, loaddir);
+    kmers::KMerDiskStorage<RtSeq> loaded_kmers;
+    loaded_kmers.deserialize(ss, loaddir);
+    qf::cqf loaded_cqf(1);
+    loaded_cqf.deserialize(ss);
+
+    EXPECT_EQ(kmers.total_kmers(), loaded_kmers.total_kmers());
+    EXPECT_EQ(kmers.num_buckets(), loaded_kmers.num_buckets());
+    EXPECT_EQ(k + 1, loaded_kmers.k());
+
+    EXPECT_EQ(cqf.slots(), loaded_cqf.slots());
+    EXPECT_EQ(cqf.distinct(), loaded_cqf.distinct());
+    for (uint64_t d = 1; d < 100; ++d)
+        EXPECT_EQ(cqf.lookup(d * 0x9E3779B97F4A7C15ull), loaded_cqf.lookup(d * 0x9E3779B97F4A7C15ull));
+
+    Graph g(k);
+    DeBruijnGraphExtentionConstructor<Graph>(g, loaded_ext).ConstructGraph(false);
+    AssertEdges(g, AddComplement(Edges(edges.begin(), edges.end())));
+}
+
+// The expanded filter keeps the same hash bits, so every lookup gives the same count
+TEST( CQF, ExpandKeepsCounts ) {
+    for (unsigned nthreads : { 1, 4 }) {
+        qf::cqf cqf(1 << 12);
+        std::vector<uint64_t> queries;
+        std::unordered_set<uint64_t> keys;
+        for (uint64_t d = 1; !cqf.full(); ++d) {
+            uint64_t key = d * 0x9E3779B97F4A7C15ull;
+            // Zero remainders and large counts have special encodings
+            if (d % 5 == 0)
+                key &= ~0xFFFFull;
+            ASSERT_TRUE(cqf.add(key, d % 13 ? d % 4 + 1 : 1000 + d));
+            keys.insert(key & cqf.range_mask());
+            queries.push_back(key);
+            queries.push_back(key ^ 1);
+        }
+
+        std::vector<size_t> counts;
+        for (uint64_t key : queries)
+            counts.push_back(cqf.lookup(key));
+
+        for (size_t round = 0; round < 2; ++round) {
+            uint64_t slots = cqf.slots();
+            cqf.expand(nthreads);
+            EXPECT_EQ(2 * slots, cqf.slots());
+            // Counted exactly by the expansion, unlike the insertions
+            EXPECT_EQ(keys.size(), cqf.distinct());
+            EXPECT_FALSE(cqf.full());
+            for (size_t i = 0; i < queries.size(); ++i)
+                ASSERT_EQ(counts[i], cqf.lookup(queries[i])) << "round " << round << ", key #" << i;
+        }
+
+        // Still could be updated
+        cqf.add(queries[0], 5);
+        EXPECT_EQ(counts[0] + 5, cqf.lookup(queries[0]));
+    }
+}
+
+// The insertions into the full filter would overrun it
+TEST( CQF, RefusesWhenFull ) {
+    qf::cqf cqf(1 << 8, 32);
+    uint64_t d = 1;
+    for (; cqf.add(d * 0x9E3779B97F4A7C15ull); ++d)
+        ASSERT_LT(cqf.occupied_slots(), cqf.slots());
+    EXPECT_TRUE(cqf.full());
+    EXPECT_EQ(0u, cqf.lookup(d * 0x9E3779B97F4A7C15ull));
+
+    cqf.expand();
+    EXPECT_TRUE(cqf.add(d * 0x9E3779B97F4A7C15ull));
+    EXPECT_EQ(1u, cqf.lookup(d * 0x9E3779B97F4A7C15ull));
+}
+
+TEST( CQF, MergeExpandsIfDoesNotFit ) {
+    qf::cqf cqf(1 << 8, 32), other(1 << 8, 32);
+    std::vector<uint64_t> keys;
+    for (uint64_t d = 1; !other.almost_full(); ++d) {
+        keys.push_back(d * 0x9E3779B97F4A7C15ull);
+        ASSERT_TRUE(cqf.add(keys.back()));
+        ASSERT_TRUE(other.add(keys.back() ^ 0xFF00));
+    }
+    EXPECT_FALSE(cqf.fits(other));
+
+    cqf.merge(other);
+    EXPECT_LT(256u, cqf.slots());
+    EXPECT_EQ(0u, other.occupied_slots());
+    for (uint64_t key : keys) {
+        ASSERT_EQ(1u, cqf.lookup(key));
+        ASSERT_EQ(1u, cqf.lookup(key ^ 0xFF00));
+    }
+}
+
+struct HashCollector {
+    std::vector<uint64_t> hashes;
+
+    void ProcessKmer(const RtSeq &/*kmer*/, uint64_t hash) {
+        hashes.push_back(hash);
+    }
+};
+
+// The filter is far too small for the reads, so it is full in the middle of the batch
+TEST( CQF, FillCoverageHistogramBeyondCapacity ) {
+    typedef io::VectorReadStream<io::SingleRead> RawStream;
+    unsigned k = 21;
+    rolling_hash::SymmetricCyclicHash<rolling_hash::NDNASeqHash> hasher(k);
+
+    std::mt19937 rng(239);
+    io::ReadStreamList<io::SingleRead> streams;
+    for (size_t i = 0; i < 4; ++i) {
+        std::vector<std::string> reads;
+        for (size_t j = 0; j < 500; ++j) {
+            std::string read(100, 'A');
+            for (char &c : read)
+                c = "ACGT"[rng() % 4];
+            reads.push_back(read);
+        }
+        streams.push_back(io::RCWrap<io::SingleRead>(RawStream(MakeReads(reads))));
+    }
+
+    qf::cqf cqf(1 << 8, 32);
+    unsigned thr = std::numeric_limits<unsigned>::max();
+    utils::FillCoverageHistogram(cqf, k, hasher, streams, thr);
+    EXPECT_FALSE(cqf.full());
+
+    streams.reset();
+    HashCollector collector;
+    for (size_t i = 0; i < streams.size(); ++i)
+        utils::FillFromStream(streams[i], hasher, collector, k, std::numeric_limits<size_t>::max(),
+                              utils::StoringTypeFilter<utils::SimpleStoring>());
+    std::unordered_map<uint64_t, size_t> counts;
+    for (uint64_t hash : collector.hashes)
+        counts[hash & cqf.range_mask()] += 1;
+
+    EXPECT_EQ(counts.size(), cqf.distinct());
+    for (uint64_t hash : collector.hashes)
+        ASSERT_EQ(counts[hash & cqf.range_mask()], cqf.lookup(hash));
+}
+
+TEST_F( GraphConstruction, CoverageCacheAndReplicas ) {
+    typedef io::VectorReadStream<io::SingleRead> RawStream;
+    typedef utils::PerfectHashMap<RtSeq, uint32_t, utils::slim_kmer_index_traits<RtSeq>, utils::DefaultStoring> CoverageMap;
+    std::vector<std::string> reads = { "CGAAACCAC", "CGAAAACAC", "AACCACACC", "AAACACACC" };
+    // The k-mers of the first read are hot
+    reads.insert(reads.end(), 100, reads.front());
+    unsigned k = 5;
+
+    auto workdir = fs::tmp::make_temp_dir(tmp_folder(), "tests");
+    io::ReadStreamList<io::SingleRead> streams;
+    for (size_t i = 0; i < 4; ++i)
+        streams.push_back(io::RCWrap<io::SingleRead>(RawStream(MakeReads(reads))));
+    utils::DeBruijnExtensionIndex<> ext(k);
+    auto kmers = utils::DeBruijnExtensionIndexBuilder().BuildExtensionIndexFromStream(workdir, ext, streams);
+
+    CoverageMap expected(k + 1);
+    utils::CoverageHashMapBuilder(/* cache_size */ 0).BuildIndex(expected, kmers, streams);
+    EXPECT_LE(4u * 101, *std::max_element(expected.value_begin(), expected.value_end()));
+
+    for (const auto &builder : { utils::CoverageHashMapBuilder(4),
+                                 utils::CoverageHashMapBuilder(1 << 10, /* replicas */ 2),
+                                 utils::CoverageHashMapBuilder(0, 4) }) {
+        CoverageMap coverage(k + 1);
+        builder.BuildIndex(coverage, kmers, streams);
+        ASSERT_EQ(expected.size(), coverage.size());
+        EXPECT_TRUE(std::equal(expected.value_begin(), expected.value_end(), coverage.value_begin()));
+    }
+}
+
 TEST_F( GraphConstruction, SimpleTestEarlyPairedInfo ) {
     std::vector<MyPairedRead> paired_reads = {{"CCCAC", "CCACG"}, {"ACCAC", "CCACA"}};
     std::vector<MyEdge> edges = {"CCCA", "ACCA", "CCAC", "CACG", "CACA"};
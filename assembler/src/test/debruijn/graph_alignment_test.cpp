@@ -9,13 +9,20 @@
 
 #include "modules/alignment/sequence_mapper.hpp"
 #include "modules/alignment/pacbio/g_aligner.hpp"
+#include "modules/alignment/mapping_cache.hpp"
+#include "modules/alignment/sequence_mapper_notifier.hpp"
+#include "modules/alignment/kmer_map.hpp"
 
 #include "io/reads/io_helper.hpp"
+#include "io/reads/vector_reader.hpp"
 #include "edlib/edlib.h"
 
 #include "graphio.hpp"
+#include "tmp_folder_fixture.hpp"
 
 #include <gtest/gtest.h>
+#include <random>
+#include <sstream>
 
 
 using namespace debruijn_graph;
@@ -196,3 +203,265 @@ TEST(GraphAligner, DijkstraGrowEndsTest ) {
     int score = ends_filler.edit_distance();
     EXPECT_EQ(ideal_score, score);
 }
+
+class MappingCacheTest : public ::testing::Test, public TmpFolderFixture {};
+
+TEST_F(MappingCacheTest, RoundTrip) {
+    std::vector<MappingPath<EdgeId>> paths;
+    paths.emplace_back();
+    paths.emplace_back(EdgeId(42), MappingRange(0, 100, 5, 105));
+    paths.emplace_back(std::vector<EdgeId>{ EdgeId(1), EdgeId(100500), EdgeId(7) },
+                       std::vector<MappingRange>{ MappingRange(10, 20, 1000, 1010),
+                                                  MappingRange(3, 50, 0, 47, 0.5),
+                                                  MappingRange(60, 61, 0, 1) });
+
+    MappingCache cache(fs::tmp::make_temp_dir(tmp_folder(), "mapping_cache"));
+    EXPECT_FALSE(cache.ready());
+
+    cache.StartRecord(2);
+    for (const auto &path : paths) {
+        cache.writer(0).Write(path);
+        cache.writer(1).Write(path);
+    }
+    cache.Finish();
+    ASSERT_TRUE(cache.ready());
+
+    // Replay twice to make sure the cache could be reused
+    for (size_t pass = 0; pass < 2; ++pass) {
+        cache.StartReplay(2);
+        for (size_t stream = 0; stream < 2; ++stream) {
+            for (const auto &path : paths) {
+                auto replayed = cache.reader(stream).Read();
+                ASSERT_EQ(path.size(), replayed.size());
+                for (size_t i = 0; i < path.size(); ++i) {
+                    EXPECT_EQ(path.edge_at(i), replayed.edge_at(i));
+                    EXPECT_EQ(path.mapping_at(i).initial_range, replayed.mapping_at(i).initial_range);
+                    EXPECT_EQ(path.mapping_at(i).mapped_range, replayed.mapping_at(i).mapped_range);
+                    EXPECT_EQ(path.mapping_at(i).quality, replayed.mapping_at(i).quality);
+                }
+            }
+        }
+        cache.Finish();
+    }
+}
+
+static void CheckKMerMap(const std::map<RtSeq, RtSeq> &expected, const KMerMap &map) {
+    ASSERT_EQ(expected.size(), map.size());
+    for (const auto &entry : expected) {
+        const auto *value = map.find(entry.first);
+        ASSERT_NE(nullptr, value);
+        EXPECT_EQ(entry.second, RtSeq(entry.first.size(), value));
+    }
+    size_t visited = 0;
+    for (auto it = map.begin(); it != map.end(); ++it, ++visited)
+        EXPECT_EQ(expected.at(it->first), it->second);
+    EXPECT_EQ(expected.size(), visited);
+}
+
+TEST(KMerMap, ArenaAndSerialization) {
+    const unsigned k = 56;
+    std::mt19937 rng(42);
+    auto random_kmer = [&]() {
+        std::string s(k, 'A');
+        for (auto &c : s)
+            c = nucl(char(rng() & 3));
+        return RtSeq(k, s.c_str());
+    };
+
+    KMerMap map(k);
+    std::map<RtSeq, RtSeq> expected;
+    for (size_t i = 0; i < 10000; ++i) {
+        RtSeq key = random_kmer(), value = random_kmer();
+        map.set(key, value);
+        expected[key] = value;
+    }
+    CheckKMerMap(expected, map);
+
+    // Erased keys become roots, updates relink the keys
+    size_t i = 0;
+    for (auto it = expected.begin(); it != expected.end(); ++i) {
+        if (i % 3 == 0) {
+            map.erase(it->first);
+            it = expected.erase(it);
+        } else {
+            if (i % 3 == 1) {
+                it->second = random_kmer();
+                map.set(it->first, it->second);
+            }
+            ++it;
+        }
+    }
+    for (size_t j = 0; j < 1000; ++j) {
+        RtSeq key = random_kmer(), value = random_kmer();
+        map.set(key, value);
+        expected[key] = value;
+    }
+    CheckKMerMap(expected, map);
+
+    // The map with the holes, then the compacted one
+    for (size_t pass = 0; pass < 2; ++pass) {
+        std::stringstream ss;
+        map.BinWrite(ss);
+        KMerMap loaded(k);
+        loaded.set(random_kmer(), random_kmer());
+        loaded.BinRead(ss);
+        CheckKMerMap(expected, loaded);
+
+        map.compact();
+        CheckKMerMap(expected, map);
+    }
+}
+
+TEST(KMerMap, PathCompression) {
+    const unsigned k = 56;
+    std::vector<RtSeq> chain;
+    for (size_t i = 0; i < 1000; ++i) {
+        std::string s(k, 'A');
+        for (size_t j = 0; j < 10; ++j)
+            s[j] = nucl(char((i >> (2 * j)) & 3));
+        chain.emplace_back(k, s.c_str());
+    }
+
+    // Every new key is linked to the root of its value, the longest chain is made by
+    // substituting the roots one by one
+    KMerMap map(k);
+    map.collect_stats(true);
+    for (size_t i = 0; i + 1 < chain.size(); ++i)
+        map.set(chain[i], chain[i + 1]);
+    ASSERT_EQ(chain.size() - 1, map.size());
+
+    EXPECT_EQ(chain.back(), RtSeq(k, map.find(chain.front())));
+    EXPECT_EQ(double(chain.size() - 1), map.average_chain_length());
+
+    // The path of the first lookup is compressed, so all the chains have length one now
+    map.reset_stats();
+    size_t found = 0;
+#   pragma omp parallel for reduction(+:found)
+    for (size_t i = 0; i < chain.size(); ++i) {
+        if (const auto *root = map.find(chain[i]))
+            found += RtSeq(k, root) == chain.back();
+    }
+    EXPECT_EQ(chain.size() - 1, found);
+    EXPECT_EQ(1., map.average_chain_length());
+
+    // Substituting the root relinks the whole tree
+    RtSeq last(k, std::string(k, 'C').c_str());
+    map.set(chain.back(), last);
+    map.reset_stats();
+    EXPECT_EQ(last, RtSeq(k, map.find(chain[10])));
+    EXPECT_EQ(2., map.average_chain_length());
+
+    // Remapping back, as KmerMapper does
+    map.erase(chain.back());
+    map.set(last, chain.back());
+    EXPECT_EQ(chain.back(), RtSeq(k, map.find(chain[10])));
+    EXPECT_FALSE(map.count(chain.back()));
+    EXPECT_EQ(chain.back(), RtSeq(k, map.find(last)));
+
+    // Roots nothing points to are dropped
+    RtSeq unused(k, std::string(k, 'G').c_str());
+    map.set(unused, chain.front());
+    map.erase(unused);
+    map.compact();
+    EXPECT_EQ(chain.size(), map.size());
+    EXPECT_EQ(nullptr, map.find(unused));
+    for (size_t i = 0; i + 1 < chain.size(); ++i)
+        EXPECT_EQ(chain.back(), RtSeq(k, map.find(chain[i])));
+
+    std::stringstream ss;
+    map.BinWrite(ss);
+    KMerMap loaded(k);
+    loaded.BinRead(ss);
+    EXPECT_EQ(chain.size(), loaded.size());
+    EXPECT_EQ(chain.back(), RtSeq(k, loaded.find(last)));
+}
+
+namespace {
+
+// Maps every read to the edge with id equal to its length
+class FakeMapper : public SequenceMapper<Graph> {
+  public:
+    MappingPath<EdgeId> MapSequence(const Sequence &sequence, bool = false) const override {
+        return MappingPath<EdgeId>(EdgeId(sequence.size()), MappingRange(0, 1, 0, 1));
+    }
+
+    MappingPath<EdgeId> MapRead(const io::SingleRead &read, bool = false) const override {
+        return MapSequence(read.sequence());
+    }
+};
+
+// Counts the reads by their mapped edge
+class ReadCounter : public SequenceMapperListener {
+  public:
+    explicit ReadCounter(bool mergeable)
+            : mergeable_(mergeable) {}
+
+    void StartProcessLibrary(size_t threads_count) override {
+        buffers_.assign(threads_count, {});
+        total_.clear();
+    }
+
+    void ProcessSingleRead(size_t thread_index, const io::SingleRead&, const MappingPath<EdgeId>& read) override {
+        buffers_[thread_index][read.edge_at(0).int_id()] += 1;
+    }
+
+    void MergeBuffer(size_t thread_index) override {
+        if (mergeable_) {
+            EXPECT_EQ(0, thread_index);
+        }
+        Merge(total_, buffers_[thread_index]);
+    }
+
+    bool HasMergeableBuffers() const override { return mergeable_; }
+
+    void MergeBuffers(size_t dst_thread, size_t src_thread) override {
+        EXPECT_TRUE(mergeable_);
+        Merge(buffers_[dst_thread], buffers_[src_thread]);
+    }
+
+    const std::map<uint64_t, size_t> &total() const { return total_; }
+
+  private:
+    static void Merge(std::map<uint64_t, size_t> &dst, std::map<uint64_t, size_t> &src) {
+        for (const auto &entry : src)
+            dst[entry.first] += entry.second;
+        src.clear();
+    }
+
+    bool mergeable_;
+    std::vector<std::map<uint64_t, size_t>> buffers_;
+    std::map<uint64_t, size_t> total_;
+};
+
+}
+
+class SequenceMapperNotifierTest : public ::testing::Test, public TmpFolderFixture {};
+
+TEST_F(SequenceMapperNotifierTest, ReduceBuffers) {
+    GraphPack gp(/* k */ 55, tmp_folder(), 1);
+
+    std::map<uint64_t, size_t> expected;
+    io::ReadStreamList<io::SingleRead> streams;
+    // Odd number of streams to get unpaired buffers in the reduction
+    for (size_t i = 0; i < 5; ++i) {
+        std::vector<io::SingleRead> reads;
+        for (size_t j = 0; j < 1000 * (i + 1); ++j) {
+            size_t len = 1 + (i * 7 + j) % 13;
+            reads.emplace_back("read", std::string(len, 'A'));
+            expected[len] += 1;
+        }
+        streams.push_back(io::VectorReadStream<io::SingleRead>(reads));
+    }
+
+    SequenceMapperNotifier notifier(gp, 1);
+    ReadCounter mergeable(true), serial(false);
+    notifier.Subscribe(0, &mergeable);
+    notifier.Subscribe(0, &serial);
+    FakeMapper mapper;
+    // There could be more threads than streams
+    for (size_t threads : { 5, 6, 8 }) {
+        notifier.ProcessLibrary(streams, 0, mapper, threads);
+        EXPECT_EQ(expected, mergeable.total());
+        EXPECT_EQ(expected, serial.total());
+    }
+}
@@ -106,3 +106,87 @@ TEST( GraphCore, SelfRCEdgeMerge ) {
     EXPECT_EQ(1u, g.OutgoingEdgeCount(v1));
     EXPECT_EQ(Sequence("AACGCTATTCACGTGAATAGCGTT"), g.EdgeNucls(g.GetUniqueOutgoingEdge(v1)));
 }
+
+class EventRecorder : public omnigraph::GraphActionHandler<Graph> {
+    bool deferrable_;
+
+    std::string str(EdgeId e) const {
+        return std::to_string(e.int_id()) + ":" + std::to_string(g().length(e));
+    }
+
+public:
+    std::vector<std::string> events;
+    size_t batches = 0;
+
+    EventRecorder(const Graph &g, bool deferrable)
+            : omnigraph::GraphActionHandler<Graph>(g, "EventRecorder"), deferrable_(deferrable) {}
+
+    void HandleAdd(VertexId v) override { events.push_back("+v" + std::to_string(v.int_id())); }
+    void HandleAdd(EdgeId e) override { events.push_back("+e" + str(e)); }
+    void HandleDelete(VertexId v) override { events.push_back("-v" + std::to_string(v.int_id())); }
+    void HandleDelete(EdgeId e) override { events.push_back("-e" + str(e)); }
+
+    void HandleMerge(const std::vector<EdgeId> &old_edges, EdgeId new_edge) override {
+        std::string event = "m" + str(new_edge);
+        for (EdgeId e : old_edges)
+            event += " " + str(e);
+        events.push_back(event);
+    }
+
+    void HandleGlue(EdgeId new_edge, EdgeId edge1, EdgeId edge2) override {
+        events.push_back("g" + str(new_edge) + " " + str(edge1) + " " + str(edge2));
+    }
+
+    void HandleSplit(EdgeId old_edge, EdgeId new_edge_1, EdgeId new_edge_2) override {
+        events.push_back("s" + str(old_edge) + " " + str(new_edge_1) + " " + str(new_edge_2));
+    }
+
+    void HandleBatch(const omnigraph::ActionLog<VertexId, EdgeId> &log) override {
+        batches += 1;
+        omnigraph::GraphActionHandler<Graph>::HandleBatch(log);
+    }
+
+    bool IsDeferrable() const override { return deferrable_; }
+};
+
+TEST( GraphCore, BatchScope ) {
+    Graph g(5);
+    EventRecorder immediate(g, false), deferred(g, true);
+    VertexId v1 = g.AddVertex();
+    EXPECT_EQ(2u, deferred.events.size());
+    deferred.events.clear();
+    immediate.events.clear();
+
+    {
+        Graph::BatchScope batch(g);
+        EXPECT_TRUE(g.InBatch());
+        VertexId v2 = g.AddVertex(), v3 = g.AddVertex(), v4 = g.AddVertex();
+        g.AddEdge(v1, v2, Sequence("AACGCTATT"));
+        g.AddEdge(v2, v3, Sequence("CTATTCAGGA"));
+        EdgeId e3 = g.AddEdge(v2, v4, Sequence("CTATTGGCA"));
+        g.DeleteEdge(e3);
+        g.DeleteVertex(v4);
+        EdgeId merged = g.UnsafeCompressVertex(v2);
+        EXPECT_EQ(9u, g.length(merged));
+        auto parts = g.SplitEdge(merged, 3);
+        EdgeId e4 = g.AddEdge(g.EdgeStart(parts.first), g.EdgeEnd(parts.first), g.EdgeNucls(parts.first));
+        g.GlueEdges(parts.first, e4);
+        EXPECT_TRUE(deferred.events.empty());
+    }
+    EXPECT_FALSE(g.InBatch());
+    EXPECT_EQ(1u, deferred.batches);
+    EXPECT_EQ(immediate.events, deferred.events);
+    EXPECT_EQ(6u, g.size());
+    EXPECT_EQ(4u, g.e_size());
+
+    deferred.events.clear();
+    immediate.events.clear();
+    {
+        Graph::BatchScope batch(g);
+        Graph::BatchScope nested(g);
+    }
+    EXPECT_EQ(1u, deferred.batches);
+    g.DeleteAllOutgoing(v1);
+    EXPECT_EQ(1u, deferred.batches);
+    EXPECT_EQ(immediate.events, deferred.events);
+}
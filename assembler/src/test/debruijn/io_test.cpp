@@ -10,8 +10,13 @@
 #include "io/binary/graph.hpp"
 #include "io/binary/kmer_mapper.hpp"
 #include "io/binary/paired_index.hpp"
+#include "io/reads/fasta_fastq_gz_parser.hpp"
+#include "io/reads/parallel_fasta_fastq_gz_parser.hpp"
 
 #include <gtest/gtest.h>
+#include <zlib.h>
+#include <fstream>
+#include <sstream>
 
 using namespace debruijn_graph;
 
@@ -63,6 +68,59 @@ TEST(Io, Order) {
     CompareGraphIterators(graph.SmartEdgeBegin(), new_graph.SmartEdgeBegin());
 }
 
+void CompareGraphs(const Graph &graph, const Graph &new_graph) {
+    EXPECT_EQ(graph.size(), new_graph.size());
+    for (VertexId v : graph) {
+        ASSERT_TRUE(new_graph.contains(v));
+        EXPECT_EQ(graph.conjugate(v), new_graph.conjugate(v));
+        std::vector<EdgeId> out(graph.out_begin(v), graph.out_end(v));
+        std::vector<EdgeId> new_out(new_graph.out_begin(v), new_graph.out_end(v));
+        EXPECT_EQ(out, new_out);
+    }
+    for (EdgeId e : graph.edges()) {
+        ASSERT_TRUE(new_graph.contains(e));
+        EXPECT_EQ(graph.conjugate(e), new_graph.conjugate(e));
+        EXPECT_EQ(graph.EdgeStart(e), new_graph.EdgeStart(e));
+        EXPECT_EQ(graph.EdgeEnd(e), new_graph.EdgeEnd(e));
+        EXPECT_EQ(graph.EdgeNucls(e), new_graph.EdgeNucls(e));
+    }
+}
+
+TEST(Io, GraphRoundTrip) {
+    const auto &graph = CommonGraph();
+
+    Save(file_name, graph);
+    Graph loaded(graph.k());
+    ASSERT_TRUE(Load(file_name, loaded));
+    CompareGraphs(graph, loaded);
+
+    std::stringstream ss;
+    Write(ss, graph);
+    Graph read(graph.k());
+    ASSERT_TRUE(Read(ss, read));
+    CompareGraphs(graph, read);
+
+    // Sequences of the loaded graph are stored differently
+    Save(file_name, loaded);
+    Graph reloaded(graph.k());
+    ASSERT_TRUE(Load(file_name, reloaded));
+    CompareGraphs(graph, reloaded);
+}
+
+// A palindromic edge between the non-conjugate vertices is not self-conjugate
+TEST(Io, PalindromicEdgeRoundTrip) {
+    Graph graph(5);
+    VertexId v1 = graph.AddVertex(), v2 = graph.AddVertex();
+    EdgeId e = graph.AddEdge(v1, v2, Sequence("AACGCGTT"));
+    ASSERT_NE(e, graph.conjugate(e));
+
+    std::stringstream ss;
+    Write(ss, graph);
+    Graph read(graph.k());
+    ASSERT_TRUE(Read(ss, read));
+    CompareGraphs(graph, read);
+}
+
 TEST(Io, PairedInfo) {
     using namespace omnigraph::de;
     using Index = UnclusteredPairedInfoIndexT<Graph>;
@@ -109,3 +167,124 @@ TEST(Io, KmerMapper) {
 
     CompareContainers(kmer_mapper, new_mapper);
 }
+
+std::vector<io::SingleRead> ParseAll(io::Parser &parser) {
+    std::vector<io::SingleRead> reads;
+    io::SingleRead read;
+    while (!parser.eof()) {
+        parser >> read;
+        reads.push_back(read);
+    }
+    return reads;
+}
+
+void CompareParsers(const std::string &filename, const std::string &reference) {
+    io::FileReadFlags flags;
+    io::FastaFastqGzParser serial(reference, flags);
+    auto expected = ParseAll(serial);
+    ASSERT_FALSE(expected.empty());
+
+    flags.threads = 3;
+    // Small chunks to get records split between the inflated blocks
+    io::ParallelFastaFastqGzParser parallel(filename, flags, /* chunk_size */ 1000);
+    for (unsigned pass = 0; pass < 2; ++pass) {
+        auto reads = ParseAll(parallel);
+        ASSERT_EQ(expected.size(), reads.size());
+        for (size_t i = 0; i < reads.size(); ++i) {
+            EXPECT_EQ(expected[i].name(), reads[i].name());
+            EXPECT_EQ(expected[i].GetSequenceString(), reads[i].GetSequenceString());
+            EXPECT_EQ(expected[i].GetQualityString(), reads[i].GetQualityString());
+        }
+        parallel.reset();
+    }
+}
+
+// Recompresses the file into BGZF blocks having at most block_size bytes of data
+void WriteBGZF(const std::string &from, const std::string &to, size_t block_size) {
+    std::string text;
+    gzFile in = gzopen(from.c_str(), "r");
+    ASSERT_TRUE(in);
+    char buf[4096];
+    int len;
+    while ((len = gzread(in, buf, sizeof(buf))) > 0)
+        text.append(buf, len);
+    gzclose(in);
+
+    std::ofstream out(to, std::ios::binary);
+    for (size_t pos = 0; pos <= text.size(); pos += block_size) {
+        // The last block is empty, as the BGZF EOF marker
+        size_t size = std::min(block_size, text.size() - pos);
+        std::vector<unsigned char> block(deflateBound(nullptr, size) + 26);
+
+        z_stream strm = {};
+        ASSERT_EQ(Z_OK, deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY));
+        strm.next_in = reinterpret_cast<unsigned char*>(&text[0] + pos);
+        strm.avail_in = unsigned(size);
+        strm.next_out = block.data() + 18;
+        strm.avail_out = unsigned(block.size() - 26);
+        ASSERT_EQ(Z_STREAM_END, deflate(&strm, Z_FINISH));
+        size_t total = 18 + strm.total_out + 8;
+        deflateEnd(&strm);
+
+        const unsigned char header[] = { 31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0,
+                                         (unsigned char)((total - 1) & 0xFF), (unsigned char)((total - 1) >> 8) };
+        std::copy(header, header + 18, block.begin());
+        uint32_t crc = uint32_t(crc32(0L, reinterpret_cast<unsigned char*>(&text[0] + pos), unsigned(size)));
+        uint32_t isize = uint32_t(size);
+        for (size_t i = 0; i < 4; ++i) {
+            block[total - 8 + i] = (unsigned char)(crc >> (8 * i));
+            block[total - 4 + i] = (unsigned char)(isize >> (8 * i));
+        }
+        out.write(reinterpret_cast<const char*>(block.data()), total);
+    }
+}
+
+TEST(Io, ParallelParser) {
+    CompareParsers("./src/test/data/s_6_1.fastq.gz", "./src/test/data/s_6_1.fastq.gz");
+    CompareParsers("./test_dataset/reference_1K.fa.gz", "./test_dataset/reference_1K.fa.gz");
+}
+
+TEST(Io, ParallelParserBGZF) {
+    const std::string bgzf = "src/test/debruijn/graph_fragments/saves/test_save.bgzf.gz";
+    WriteBGZF("./src/test/data/s_6_1.fastq.gz", bgzf, 3000);
+    CompareParsers(bgzf, "./src/test/data/s_6_1.fastq.gz");
+    WriteBGZF("./test_dataset/reference_1K.fa.gz", bgzf, 3000);
+    CompareParsers(bgzf, "./test_dataset/reference_1K.fa.gz");
+}
+
+TEST(Io, ParallelParserComments) {
+    // The headers with comments give the same names as the serial parser gives
+    const std::string filename = "src/test/debruijn/graph_fragments/saves/test_save.comments.gz";
+    for (bool fastq : { true, false }) {
+        gzFile out = gzopen(filename.c_str(), "w");
+        ASSERT_TRUE(out);
+        for (unsigned i = 0; i < 200; ++i) {
+            std::string header = (fastq ? "@read" : ">read") + std::to_string(i) +
+                                 (i % 3 == 0 ? " 1:N:0:ACGT" : i % 3 == 1 ? "\tcomment here" : "");
+            gzprintf(out, fastq ? "%s\nACGTACGTAC\n+\nIIIIIIIIII\n" : "%s\nACGTACGTAC\n", header.c_str());
+        }
+        gzclose(out);
+        CompareParsers(filename, filename);
+    }
+}
+
+TEST(Io, ParallelParserThreadBudget) {
+    // The parsers take the threads from the budget only while reading
+    const std::string filename = "./src/test/data/s_6_1.fastq.gz";
+    io::FastaFastqGzParser serial(filename, io::FileReadFlags());
+    size_t expected = ParseAll(serial).size();
+
+    io::ThreadBudget budget(4);
+    io::FileReadFlags flags;
+    flags.threads = 3;
+    flags.budget = &budget;
+    io::ParallelFastaFastqGzParser first(filename, flags, /* chunk_size */ 1000);
+    io::ParallelFastaFastqGzParser second(filename, flags, /* chunk_size */ 1000);
+    EXPECT_EQ(4u, budget.Acquire(4));
+    budget.Release(4);
+
+    EXPECT_EQ(expected, ParseAll(first).size());
+    EXPECT_EQ(expected, ParseAll(second).size());
+    EXPECT_EQ(4u, budget.Acquire(4));
+    budget.Release(4);
+}
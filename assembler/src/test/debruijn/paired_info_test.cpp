@@ -6,12 +6,16 @@
 
 #include "random_graph.hpp"
 
+#include "paired_info/edge_pair_filter.hpp"
 #include "paired_info/index_point.hpp"
 #include "paired_info/paired_info_helpers.hpp"
+#include "paired_info/sharded_pair_info_buffer.hpp"
 //#include "io/binary/paired_index.hpp"
 
 #include <gtest/gtest.h>
 #include <map>
+#include <random>
+#include <tuple>
 #include <vector>
 
 using namespace omnigraph::de;
@@ -334,6 +338,36 @@ TEST(PairedInfo, DoubledInfo) {
     EXPECT_EQ(GetNeighbourInfo(pi, 1), testF1);
 }
 
+TEST(PairedInfo, ShardedBuffer) {
+    MockGraph graph;
+    MockIndex expected(graph), pi(graph);
+    const size_t nthreads = 4;
+    ShardedPairedInfoBuffer<MockGraph> buffer(graph, nthreads);
+
+    std::vector<MockGraph::EdgeId> edges = {1, 2, 3, 4, 5, 7, 8, 9, 13, 14};
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < 10000; ++i) {
+        MockGraph::EdgeId e1 = edges[rng() % edges.size()], e2 = edges[rng() % edges.size()];
+        RawPoint p(float(rng() % 20) - 10, float(1 + rng() % 3));
+        expected.Add(e1, e2, p);
+        buffer.Add(i % nthreads, e1, e2, p);
+    }
+    buffer.Reduce();
+    pi.MoveAssign(buffer);
+
+    EXPECT_EQ(pi.size(), expected.size());
+    EXPECT_EQ(GetEdgePairInfo(pi), GetEdgePairInfo(expected));
+    //Check that the weights are the same as well
+    auto weights = [](const MockIndex &index) {
+        std::map<std::tuple<MockGraph::EdgeId, MockGraph::EdgeId, float>, float> res;
+        for (auto i = pair_begin(index); i != pair_end(index); ++i)
+            for (auto p : *i)
+                res[std::make_tuple(i.first(), i.second(), float(p.d))] = p.weight;
+        return res;
+    };
+    EXPECT_EQ(weights(pi), weights(expected));
+}
+
 /*TEST(PairedInfo, PairedInfoRawData) {
     MockGraph graph;
     MockIndex pi(graph);
@@ -458,3 +492,23 @@ TEST(PairedInfo, RandomSymmetry) {
         }
     }
 }
+
+TEST(PairedInfo, EdgePairFilterSharedFirstEdge) {
+    using debruijn_graph::EdgeId;
+    // An edge is paired with many others, the pairs must still spread over the blocks
+    const uint64_t n = 100000;
+    EdgePairFilter<EdgeId> filter(EdgePairFilterHasher<EdgeId>(), 12 * n);
+    for (uint64_t i = 0; i < n; ++i)
+        filter.add({EdgeId(1), EdgeId(2 + i)});
+
+    for (uint64_t i = 0; i < n; ++i)
+        ASSERT_GT(filter.lookup({EdgeId(1), EdgeId(2 + i)}), 0u);
+
+    size_t fp = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        fp += filter.lookup({EdgeId(1), EdgeId(2 + n + i)}) > 0;
+        fp += filter.lookup({EdgeId(2 + i), EdgeId(1)}) > 0;
+    }
+    // About 1.2% for 12 cells and 3 counters per pair
+    EXPECT_LT(double(fp) / double(2 * n), 0.02);
+}
@@ -5,12 +5,16 @@
 //***************************************************************************
 
 
+#include "modules/path_extend/path_extender.hpp"
 #include "modules/path_extend/path_visualizer.hpp"
+#include "modules/path_extend/pe_resolver.hpp"
 #include "modules/path_extend/pe_utils.hpp"
+#include "assembly_graph/graph_support/detail_coverage.hpp"
 
 #include "graphio.hpp"
 
 #include <gtest/gtest.h>
+#include <random>
 
 using namespace path_extend;
 using namespace debruijn_graph;
@@ -581,6 +585,67 @@ TEST( PathExtend, BidirectionalPathAddRemoveConjugate ) {
 }
 
 
+// Suffix lengths as they were kept before: L(e_i + gap_(i+1) + e_(i+1) + ... + gap_N + e_N)
+static std::vector<size_t> SuffixLengths(const BidirectionalPath &path) {
+    std::vector<size_t> res(path.Size());
+    size_t len = 0;
+    for (size_t i = path.Size(); i > 0; --i) {
+        len += path.graph().length(path.At(i - 1));
+        res[i - 1] = len;
+        len += (size_t) path.GapAt(i - 1).gap;
+    }
+    return res;
+}
+
+static void CheckLengths(const BidirectionalPath &path) {
+    auto expected = SuffixLengths(path);
+    for (size_t i = 0; i < path.Size(); ++i)
+        ASSERT_EQ(expected[i], path.LengthAt(i)) << "position " << i << " of " << path.Size();
+    ASSERT_EQ(path.Empty() ? 0 : expected[0], path.Length());
+}
+
+TEST( PathExtend, BidirectionalPathLengthsRandomized ) {
+    Graph g(13);
+    ASSERT_TRUE(graphio::ScanBasicGraph("./src/test/debruijn/graph_fragments/path_extend/distance_estimation", g));
+    std::vector<EdgeId> edges;
+    for (auto it = g.ConstEdgeBegin(); !it.IsEnd(); ++it)
+        edges.push_back(*it);
+
+    std::mt19937 rng(42);
+    auto p = BidirectionalPath::create(g);
+    auto cp = BidirectionalPath::create(g);
+    cp->Subscribe(*p);
+    p->Subscribe(*cp);
+    for (size_t iter = 0; iter < 20000; ++iter) {
+        // Both ends of the path are changed through the conjugate
+        BidirectionalPath &path = rng() % 2 ? *p : *cp;
+        switch (rng() % 5) {
+            case 0:
+                path.PopBack();
+                break;
+            case 1:
+                if (rng() % 50 == 0)
+                    path.Clear();
+                break;
+            default: {
+                EdgeId e = edges[rng() % edges.size()];
+                path.PushBack(e, path.Empty() ? Gap() : Gap(int(rng() % 300) - 100));
+            }
+        }
+        ASSERT_EQ(cp->Conjugate(), *p);
+        CheckLengths(*p);
+        CheckLengths(*cp);
+
+        if (iter % 100 == 0) {
+            CheckLengths(*BidirectionalPath::clone(*p));
+            CheckLengths(*BidirectionalPath::clone_conjugate(*p));
+            size_t from = p->Empty() ? 0 : rng() % p->Size();
+            CheckLengths(p->SubPath(from));
+        }
+    }
+}
+
+
 TEST( PathExtend, BidirectionalPathSearch ) {
     Graph g(13);
     ASSERT_TRUE(graphio::ScanBasicGraph("./src/test/debruijn/graph_fragments/path_extend/distance_estimation", g));
@@ -755,3 +820,103 @@ TEST( PathExtend, BidirectionalPathLoopDetector ) {
     EXPECT_EQ(path1->Size(), 12);
     EXPECT_EQ(path1->Back(), e7);
 }
+
+namespace {
+
+// Goes to the most covered edge unless it is already in the path (or always, so the
+// extenders have to detect the cycles)
+class GreedyCoverageChooser : public ExtensionChooser {
+    bool allow_repeats_;
+
+public:
+    GreedyCoverageChooser(const Graph &g, bool allow_repeats = false)
+            : ExtensionChooser(g), allow_repeats_(allow_repeats) {}
+
+    EdgeContainer Filter(const BidirectionalPath &path, const EdgeContainer &edges) const override {
+        if (edges.empty())
+            return edges;
+
+        auto best = std::max_element(edges.begin(), edges.end(),
+                                     [&](const EdgeWithDistance &a, const EdgeWithDistance &b) {
+                                         return std::make_pair(g_.coverage(a.e_), g_.int_id(a.e_)) <
+                                                std::make_pair(g_.coverage(b.e_), g_.int_id(b.e_));
+                                     });
+        if (!allow_repeats_ && path.FindFirst(best->e_) != -1)
+            return EdgeContainer();
+        return { *best };
+    }
+};
+
+struct ExtenderSetup {
+    bool multi;
+    bool allow_repeats;
+    bool short_loops;
+    // Edges at least this long are unique, 0 for none
+    size_t unique_length;
+};
+
+std::vector<std::vector<size_t>> ExtendSeeds(const Graph &g, unsigned nthreads,
+                                             const ExtenderSetup &setup = { false, false, false, 0 }) {
+    omnigraph::FlankingCoverage<Graph> flanking_cov(const_cast<Graph&>(g), 50);
+    ScaffoldingUniqueEdgeStorage unique;
+    if (setup.unique_length) {
+        for (EdgeId e : g.edges()) {
+            if (g.length(e) >= setup.unique_length)
+                unique.insert(e);
+        }
+    }
+    UsedUniqueStorage used_storage(unique, g);
+    GraphCoverageMap cover_map(g);
+
+    auto make_extenders = [&](const GraphCoverageMap &cm, UsedUniqueStorage &us) {
+        std::vector<std::shared_ptr<PathExtender>> res;
+        auto chooser = std::make_shared<GreedyCoverageChooser>(g, setup.allow_repeats);
+        if (setup.multi)
+            res.push_back(std::make_shared<MultiExtender>(g, flanking_cov, cm, us, chooser,
+                                                          setup.short_loops, setup.short_loops, 300));
+        else
+            res.push_back(std::make_shared<SimpleExtender>(g, flanking_cov, cm, us, chooser,
+                                                           setup.short_loops, setup.short_loops, 300));
+        return res;
+    };
+    CompositeExtender extender(g, cover_map, used_storage,
+                               make_extenders(cover_map, used_storage), make_extenders);
+
+    PathExtendResolver resolver(g);
+    auto seeds = resolver.MakeSimpleSeeds();
+    seeds.SortByLength();
+    auto paths = resolver.ExtendSeeds(seeds, extender, nthreads);
+
+    std::vector<std::vector<size_t>> res;
+    for (auto it = paths.begin(); it != paths.end(); ++it) {
+        for (const BidirectionalPath *path : { &it.get(), &it.getConjugate() }) {
+            res.emplace_back();
+            for (size_t i = 0; i < path->Size(); ++i)
+                res.back().push_back(g.int_id(path->At(i)));
+        }
+    }
+    return res;
+}
+
+}
+
+TEST( PathExtend, ParallelSeedExtensionIsDeterministic ) {
+    Graph g(55);
+    ASSERT_TRUE(graphio::ScanBasicGraph("./src/test/debruijn/graph_fragments/ecoli_400k/distance_estimation", g));
+
+    auto expected = ExtendSeeds(g, 1);
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(expected, ExtendSeeds(g, 4));
+
+    // The unique edges, the cycle detection and the short loop resolution read the
+    // shared state from the speculative extension as well
+    for (ExtenderSetup setup : { ExtenderSetup{ false, false, false, 500 },
+                                 ExtenderSetup{ false, true, true, 500 },
+                                 ExtenderSetup{ true, true, true, 500 } }) {
+        auto expected = ExtendSeeds(g, 1, setup);
+        EXPECT_FALSE(expected.empty());
+        EXPECT_EQ(expected, ExtendSeeds(g, 4, setup))
+                << "multi " << setup.multi << ", repeats " << setup.allow_repeats
+                << ", short loops " << setup.short_loops << ", unique length " << setup.unique_length;
+    }
+}
@@ -0,0 +1,144 @@
+//***************************************************************************
+//* Copyright (c) 2021 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "sequence/nucl_pack.hpp"
+#include "sequence/sequence.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using nucl_pack::Isa;
+using nucl_pack::ST;
+
+static const char *ALPHABETS[] = { "ACGT", "acgt", "AcGt", "\0\1\2\3" };
+
+static std::string RandomNucls(std::mt19937 &rng, size_t n, const char *alphabet) {
+    std::string s(n, ' ');
+    for (auto &c : s)
+        c = alphabet[rng() & 3];
+    return s;
+}
+
+static std::vector<ST> PackWith(Isa isa, const char *s, size_t n, bool digits, bool rc) {
+    std::vector<ST> res(Sequence::DataSize(n) + 1, ST(-1));
+    nucl_pack::GetPacker(isa)(s, n, digits, rc, res.data());
+    // Must not write past the data
+    EXPECT_EQ(ST(-1), res.back());
+    res.pop_back();
+    return res;
+}
+
+static std::vector<Isa> Isas() {
+    std::vector<Isa> res;
+    for (Isa isa : { Isa::SSE41, Isa::AVX2 }) {
+        if (nucl_pack::Supported(isa))
+            res.push_back(isa);
+    }
+    return res;
+}
+
+TEST( NuclPack, ScalarReference ) {
+    std::string s = "ACGTTGCA";
+    auto data = PackWith(Isa::Scalar, s.data(), s.size(), false, false);
+    ASSERT_EQ(1u, data.size());
+    EXPECT_EQ(ST(0x1BE4), data[0]);
+    // TGCAACGT
+    data = PackWith(Isa::Scalar, s.data(), s.size(), false, true);
+    EXPECT_EQ(ST(0xE41B), data[0]);
+}
+
+// Every symbol of every alphabet at every position of a word
+TEST( NuclPack, AllSymbolsAllPositions ) {
+    for (Isa isa : Isas()) {
+        for (const char *alphabet : ALPHABETS) {
+            bool digits = alphabet[0] == 0;
+            for (size_t pos = 0; pos < 64; ++pos) {
+                for (size_t c = 0; c < 4; ++c) {
+                    for (size_t fill = 0; fill < 4; ++fill) {
+                        std::string s(64, alphabet[fill]);
+                        s[pos] = alphabet[c];
+                        for (bool rc : { false, true }) {
+                            EXPECT_EQ(PackWith(Isa::Scalar, s.data(), s.size(), digits, rc),
+                                      PackWith(isa, s.data(), s.size(), digits, rc))
+                                    << "isa " << int(isa) << ", pos " << pos << ", rc " << rc;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// All lengths up to several words, all the alignments of the input
+TEST( NuclPack, AllLengthsAndOffsets ) {
+    std::mt19937 rng(42);
+    for (Isa isa : Isas()) {
+        for (const char *alphabet : ALPHABETS) {
+            bool digits = alphabet[0] == 0;
+            std::string s = RandomNucls(rng, 300, alphabet);
+            for (size_t offset = 0; offset < 32; ++offset) {
+                for (size_t n = 0; n + offset <= 260; ++n) {
+                    for (bool rc : { false, true }) {
+                        EXPECT_EQ(PackWith(Isa::Scalar, s.data() + offset, n, digits, rc),
+                                  PackWith(isa, s.data() + offset, n, digits, rc))
+                                << "isa " << int(isa) << ", offset " << offset << ", n " << n << ", rc " << rc;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// String constructors use the vectorized path, the generic one is scalar
+TEST( NuclPack, SequenceConstruction ) {
+    std::mt19937 rng(42);
+    for (const char *alphabet : ALPHABETS) {
+        for (size_t n = 1; n < 200; ++n) {
+            std::string s = RandomNucls(rng, n, alphabet);
+            std::vector<char> v(s.begin(), s.end());
+            for (bool rc : { false, true }) {
+                Sequence vectorized(s, rc), generic(v, rc);
+                EXPECT_EQ(generic.str(), vectorized.str());
+                if (alphabet[0]) {
+                    EXPECT_EQ(generic, Sequence(s.c_str(), rc));
+                }
+            }
+        }
+    }
+}
+
+TEST( NuclPack, ReverseComplementWord ) {
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < 1000; ++i) {
+        std::string s = RandomNucls(rng, 32, "ACGT");
+        ST word = PackWith(Isa::Scalar, s.data(), 32, false, false)[0];
+        EXPECT_EQ(PackWith(Isa::Scalar, s.data(), 32, false, true)[0],
+                  nucl_pack::ReverseComplementWord(word));
+    }
+}
+
+// Packed data of every subsequence and its reverse-complement view
+TEST( NuclPack, CopyData ) {
+    std::mt19937 rng(42);
+    std::string s = RandomNucls(rng, 150, "ACGT");
+    Sequence seq(s);
+    for (size_t from = 0; from < s.size(); ++from) {
+        for (size_t to = from; to <= s.size(); ++to) {
+            for (bool rc : { false, true }) {
+                Sequence sub = seq.Subseq(from, to);
+                if (rc)
+                    sub = !sub;
+                std::vector<ST> data(Sequence::DataSize(sub.size()));
+                sub.copy_data(data.data());
+                std::string expected = s.substr(from, to - from);
+                EXPECT_EQ(PackWith(Isa::Scalar, expected.data(), expected.size(), false, rc), data)
+                        << "from " << from << ", to " << to << ", rc " << rc;
+            }
+        }
+    }
+}